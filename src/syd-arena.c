@@ -0,0 +1,124 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "syd-arena.h"
+
+/* Upper limit for the size the arena grows to on reset */
+#define ARENA_MAX_SIZE      (1024 * 1024)
+
+#define ARENA_ALIGNMENT     (2 * sizeof(gpointer))
+#define ARENA_ALIGN(n)      (((n) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+struct arena_block
+{
+    struct arena_block *next;
+    gsize size;
+    gsize used;
+};
+
+#define ARENA_BLOCK_DATA(block) ((gchar *)(block) + ARENA_ALIGN(sizeof(struct arena_block)))
+
+static struct arena_block *arena_block_new(struct arena *arena, gsize size)
+{
+    struct arena_block *block;
+
+    block = g_malloc(ARENA_ALIGN(sizeof(struct arena_block)) + size);
+    block->next = arena->head;
+    block->size = size;
+    block->used = 0;
+    arena->head = block;
+    ++arena->blocks;
+    return block;
+}
+
+void arena_init(struct arena *arena, gsize size)
+{
+    arena->head = NULL;
+    arena->size = ARENA_ALIGN(size);
+    arena->blocks = 0;
+}
+
+void arena_free(struct arena *arena)
+{
+    struct arena_block *block, *next;
+
+    for (block = arena->head; NULL != block; block = next) {
+        next = block->next;
+        g_free(block);
+    }
+    arena->head = NULL;
+}
+
+void arena_reset(struct arena *arena)
+{
+    gsize total;
+    struct arena_block *block;
+
+    if (NULL == arena->head)
+        return;
+    if (NULL == arena->head->next) {
+        arena->head->used = 0;
+        return;
+    }
+
+    /* The last check didn't fit, the next block takes all of it */
+    total = 0;
+    for (block = arena->head; NULL != block; block = block->next)
+        total += block->size;
+    arena_free(arena);
+    arena->size = MIN(total, ARENA_MAX_SIZE);
+}
+
+gpointer arena_alloc(struct arena *arena, gsize size)
+{
+    gpointer mem;
+    struct arena_block *block;
+
+    size = ARENA_ALIGN(size);
+    block = arena->head;
+    if (NULL == block || block->size - block->used < size)
+        block = arena_block_new(arena, MAX(arena->size, size));
+
+    mem = ARENA_BLOCK_DATA(block) + block->used;
+    block->used += size;
+    return mem;
+}
+
+gchar *arena_strdup(struct arena *arena, const gchar *str)
+{
+    return arena_strndup(arena, str, strlen(str));
+}
+
+gchar *arena_strndup(struct arena *arena, const gchar *str, gsize n)
+{
+    gchar *copy;
+
+    copy = arena_alloc(arena, n + 1);
+    memcpy(copy, str, n);
+    copy[n] = '\0';
+    return copy;
+}
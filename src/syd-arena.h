@@ -0,0 +1,52 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SYDBOX_GUARD_ARENA_H
+#define SYDBOX_GUARD_ARENA_H 1
+
+#include <glib.h>
+
+/* A bump allocator for memory which lives as long as one system call check.
+ * Nothing is freed on its own, arena_reset() releases everything at once.
+ * When a check needs more than the arena has, more blocks are chained and the
+ * next reset replaces them with a single block big enough for all of them, so
+ * the arena stops allocating once it has seen the largest check.
+ */
+struct arena_block;
+
+struct arena
+{
+    struct arena_block *head;   // Block allocations are made from, chained to the older ones
+    gsize size;                 // Size of the block allocated after a reset
+    guint64 blocks;             // Number of blocks allocated from the heap so far
+};
+
+void arena_init(struct arena *arena, gsize size);
+
+void arena_free(struct arena *arena);
+
+void arena_reset(struct arena *arena);
+
+gpointer arena_alloc(struct arena *arena, gsize size);
+
+gchar *arena_strdup(struct arena *arena, const gchar *str);
+
+gchar *arena_strndup(struct arena *arena, const gchar *str, gsize n);
+
+#endif // SYDBOX_GUARD_ARENA_H
@@ -24,8 +24,8 @@
 #endif // HAVE_CONFIG_H
 
 #include <errno.h>
+#include <sched.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -33,109 +33,493 @@
 #include <pinktrace/pink.h>
 
 #include "syd-children.h"
-#include "syd-config.h"
 #include "syd-log.h"
 #include "syd-path.h"
 #include "syd-pink.h"
+#include "syd-proc.h"
 #include "syd-net.h"
 
-struct tchild *tchild_new(GHashTable *children, pid_t pid, bool eldest)
+/* Size of the child table when it's created, it never shrinks below this */
+#define CHILDTAB_BITS_MIN 6
+
+struct tdata *tdata_new(void)
+{
+    struct tdata *sandbox;
+
+    sandbox = g_slice_new(struct tdata);
+    sandbox->refcount = 1;
+    sandbox->path = true;
+    sandbox->exec = false;
+    sandbox->network = false;
+    sandbox->lock = LOCK_UNSET;
+    sandbox->write_prefixes.paths = NULL;
+    sandbox->write_prefixes.trie = NULL;
+    sandbox->exec_prefixes.paths = NULL;
+    sandbox->exec_prefixes.trie = NULL;
+    return sandbox;
+}
+
+struct tdata *tdata_ref(struct tdata *sandbox)
+{
+    g_atomic_int_inc(&sandbox->refcount);
+    return sandbox;
+}
+
+void tdata_unref(struct tdata *sandbox)
+{
+    if (g_atomic_int_dec_and_test(&sandbox->refcount)) {
+        pathnode_free(&(sandbox->write_prefixes));
+        pathnode_free(&(sandbox->exec_prefixes));
+        g_slice_free(struct tdata, sandbox);
+    }
+}
+
+struct tgroup *tgroup_new(void)
+{
+    struct tgroup *group;
+
+    group = g_slice_new(struct tgroup);
+    group->refcount = 1;
+    group->lastexec = NULL;
+    group->sandbox = tdata_new();
+    return group;
+}
+
+struct tgroup *tgroup_ref(struct tgroup *group)
+{
+    g_atomic_int_inc(&group->refcount);
+    return group;
+}
+
+void tgroup_unref(struct tgroup *group)
+{
+    if (g_atomic_int_dec_and_test(&group->refcount)) {
+        tdata_unref(group->sandbox);
+        if (NULL != group->lastexec)
+            g_string_free(group->lastexec, TRUE);
+        g_slice_free(struct tgroup, group);
+    }
+}
+
+static struct tfs *tfs_new(const char *cwd)
+{
+    struct tfs *fs;
+
+    fs = g_slice_new(struct tfs);
+    fs->refcount = 1;
+    fs->cwd = g_strdup(cwd);
+    return fs;
+}
+
+static struct tfs *tfs_ref(struct tfs *fs)
+{
+    g_atomic_int_inc(&fs->refcount);
+    return fs;
+}
+
+static void tfs_unref(struct tfs *fs)
+{
+    if (g_atomic_int_dec_and_test(&fs->refcount)) {
+        g_free(fs->cwd);
+        g_slice_free(struct tfs, fs);
+    }
+}
+
+static struct tfiles *tfiles_new(void)
+{
+    struct tfiles *files;
+
+    files = g_slice_new(struct tfiles);
+    files->refcount = 1;
+    files->bindzero = NULL;
+    return files;
+}
+
+static struct tfiles *tfiles_ref(struct tfiles *files)
+{
+    g_atomic_int_inc(&files->refcount);
+    return files;
+}
+
+static void tfiles_unref(struct tfiles *files)
+{
+    if (g_atomic_int_dec_and_test(&files->refcount)) {
+        if (NULL != files->bindzero)
+            g_hash_table_destroy(files->bindzero);
+        g_slice_free(struct tfiles, files);
+    }
+}
+
+/* Fibonacci hashing, pids handed out in sequence are spread over the table */
+static inline guint childtab_home(const struct childtab *children, pid_t pid)
+{
+    return ((guint32)pid * 2654435769U) >> (32 - children->bits);
+}
+
+static inline guint childtab_mask(const struct childtab *children)
+{
+    return (1U << children->bits) - 1;
+}
+
+/* Returns the slot of the pid, or the empty slot where it'd be inserted */
+static guint childtab_lookup(const struct childtab *children, pid_t pid)
+{
+    guint i, mask;
+
+    mask = childtab_mask(children);
+    for (i = childtab_home(children, pid); 0 != children->slots[i].pid; i = (i + 1) & mask) {
+        if (pid == children->slots[i].pid)
+            break;
+    }
+    return i;
+}
+
+static void childtab_resize(struct childtab *children, guint bits)
+{
+    guint i, n;
+    struct childslot *old;
+
+    old = children->slots;
+    n = 1U << children->bits;
+    children->bits = bits;
+    children->slots = g_new0(struct childslot, 1U << bits);
+    for (i = 0; i < n; i++) {
+        if (0 != old[i].pid)
+            children->slots[childtab_lookup(children, old[i].pid)] = old[i];
+    }
+    g_free(old);
+}
+
+struct childtab *childtab_new(void)
+{
+    struct childtab *children;
+
+    children = g_new(struct childtab, 1);
+    children->size = 0;
+    children->bits = CHILDTAB_BITS_MIN;
+    children->slots = g_new0(struct childslot, 1U << CHILDTAB_BITS_MIN);
+    return children;
+}
+
+void childtab_free(struct childtab *children)
+{
+    guint i, n;
+
+    n = 1U << children->bits;
+    for (i = 0; i < n; i++) {
+        if (0 != children->slots[i].pid)
+            tchild_free_one(children->slots[i].child);
+    }
+    g_free(children->slots);
+    g_free(children);
+}
+
+guint childtab_size(const struct childtab *children)
+{
+    return children->size;
+}
+
+void childtab_foreach(struct childtab *children, childtab_func func, void *userdata)
+{
+    guint i, n;
+
+    n = 1U << children->bits;
+    for (i = 0; i < n; i++) {
+        if (0 != children->slots[i].pid)
+            func(children->slots[i].child, userdata);
+    }
+}
+
+/* Removes the children func returns true for.
+ * Returns the number of children removed.
+ */
+guint childtab_foreach_remove(struct childtab *children, childtab_remove_func func, void *userdata)
+{
+    guint i, n, removed;
+    GArray *pids;
+
+    /* Removing shifts the slots around, so the pids are collected first */
+    n = 1U << children->bits;
+    pids = g_array_new(FALSE, FALSE, sizeof(pid_t));
+    for (i = 0; i < n; i++) {
+        if (0 != children->slots[i].pid && func(children->slots[i].child, userdata))
+            g_array_append_val(pids, children->slots[i].pid);
+    }
+    removed = pids->len;
+    for (i = 0; i < pids->len; i++)
+        tchild_delete(children, g_array_index(pids, pid_t, i));
+    g_array_free(pids, TRUE);
+    return removed;
+}
+
+struct tchild *tchild_new(struct childtab *children, pid_t pid, bool eldest)
 {
-    char proc_pid[32];
+    guint i;
     struct tchild *child;
 
+    g_assert(0 < pid);
+
     g_debug("new child %i", pid);
-    child = g_new(struct tchild, 1);
+    child = g_slice_new(struct tchild);
     child->flags = eldest ? TCHILD_NEEDSETUP : TCHILD_NEEDSETUP | TCHILD_NEEDINHERIT;
     child->pid = pid;
     child->sno = 0xbadca11;
+    child->sflags = 0;
+    child->sexit = 0;
     child->retval = -1;
-    child->cwd = NULL;
-    child->lastexec = g_string_new("");
-    child->bindzero = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
     child->bindlast = NULL;
-    child->sandbox = g_new(struct tdata, 1);
-    child->sandbox->path = true;
-    child->sandbox->exec = false;
-    child->sandbox->network = false;
-    child->sandbox->lock = LOCK_UNSET;
-    child->sandbox->write_prefixes = NULL;
-    child->sandbox->exec_prefixes = NULL;
+    child->args = NULL;
+    child->starttime = 0;
+    child->regs.valid = 0;
+    child->regs.subcall = -1;
+    child->group = tgroup_new();
+    child->fs = tfs_new(NULL);
+    child->files = tfiles_new();
 
-    if (!eldest && sydbox_config_get_allow_proc_pid()) {
-        /* Allow /proc/%i which is needed for processes to work reliably. */
-        snprintf(proc_pid, 32, "/proc/%i", pid);
-        pathnode_new(&(child->sandbox->write_prefixes), proc_pid, false);
-    }
+    /* Kept at most half full so the probes stay short */
+    if (2 * (children->size + 1) > (1U << children->bits))
+        childtab_resize(children, children->bits + 1);
 
-    g_hash_table_insert(children, GINT_TO_POINTER(pid), child);
+    i = childtab_lookup(children, pid);
+    if (0 != children->slots[i].pid)
+        tchild_free_one(children->slots[i].child);
+    else
+        ++children->size;
+    children->slots[i].pid = pid;
+    children->slots[i].child = child;
     return child;
 }
 
-void tchild_inherit(struct tchild *child, struct tchild *parent)
+/* Shares the state of parent the clone flags tell the kernel to share.
+ * Threads join the thread group of their parent. Processes get a group of
+ * their own and share its sandbox data until one of them changes it.
+ * CLONE_FS shares the current working directory, otherwise the child gets a
+ * copy. CLONE_FILES shares the file descriptor table, otherwise the child
+ * starts with a table of her own.
+ * An untraced child is added long after the fork, her parent may have changed
+ * directory since and its worker may be changing the group, so she looks up
+ * her own.
+ */
+void tchild_inherit(struct tchild *child, struct tchild *parent, unsigned long flags)
 {
-    GSList *walk;
-
     g_assert(NULL != child && NULL != parent);
     if (!(child->flags & TCHILD_NEEDINHERIT))
         return;
 
-    if (G_LIKELY(NULL != parent->cwd)) {
-        g_debug("child %i inherits parent %i's current working directory `%s'", child->pid, parent->pid, parent->cwd);
-        child->cwd = g_strdup(parent->cwd);
-    }
-
-    child->lastexec = g_string_assign(child->lastexec, parent->lastexec->str);
     child->bitness = parent->bitness;
-    child->sandbox->path = parent->sandbox->path;
-    child->sandbox->exec = parent->sandbox->exec;
-    child->sandbox->network = parent->sandbox->network;
-    child->sandbox->lock = parent->sandbox->lock;
-    // Copy path lists
-    for (walk = parent->sandbox->write_prefixes; walk != NULL; walk = g_slist_next(walk))
-        pathnode_new(&(child->sandbox->write_prefixes), walk->data, false);
-    for (walk = parent->sandbox->exec_prefixes; walk != NULL; walk = g_slist_next(walk))
-        pathnode_new(&(child->sandbox->exec_prefixes), walk->data, false);
     child->flags &= ~TCHILD_NEEDINHERIT;
+
+    if (flags & CLONE_FS) {
+        tfs_unref(child->fs);
+        child->fs = tfs_ref(parent->fs);
+    }
+    else if (!(child->flags & TCHILD_UNTRACED) && G_LIKELY(NULL != parent->fs->cwd)) {
+        g_debug("child %i inherits parent %i's current working directory `%s'",
+                child->pid, parent->pid, parent->fs->cwd);
+        g_free(child->fs->cwd);
+        child->fs->cwd = g_strdup(parent->fs->cwd);
+    }
+
+    if (flags & CLONE_FILES) {
+        tfiles_unref(child->files);
+        child->files = tfiles_ref(parent->files);
+    }
+
+    if (flags & CLONE_THREAD) {
+        g_debug("thread %i joins the thread group of %i", child->pid, parent->pid);
+        tgroup_unref(child->group);
+        child->group = tgroup_ref(parent->group);
+        return;
+    }
+
+    if (!(child->flags & TCHILD_UNTRACED) && NULL != parent->group->lastexec)
+        g_string_assign(tchild_lastexec(child), parent->group->lastexec->str);
+
+    // Share sandbox data
+    tdata_unref(child->group->sandbox);
+    child->group->sandbox = tdata_ref(parent->group->sandbox);
+}
+
+/* A child is quiescent if none of its system calls is checked and it can't
+ * turn sandboxing back on, the same holds for all of its descendants.
+ */
+bool tchild_quiescent(const struct tchild *child)
+{
+    const struct tdata *sandbox;
+
+    if (child->flags & TCHILD_NEEDINHERIT)
+        return false;
+    sandbox = child->group->sandbox;
+    return !sandbox->path && !sandbox->exec && !sandbox->network && LOCK_SET == sandbox->lock;
+}
+
+/* Returns the last execve() string of the child, allocating it on first use.
+ */
+GString *tchild_lastexec(struct tchild *child)
+{
+    if (NULL == child->group->lastexec)
+        child->group->lastexec = g_string_new("");
+    return child->group->lastexec;
+}
+
+/* Returns the sockets of the child bound to port zero, allocating the table on
+ * first use. Children which don't bind() to port zero never need one.
+ */
+GHashTable *tchild_bindzero(struct tchild *child)
+{
+    if (NULL == child->files->bindzero)
+        child->files->bindzero = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, tbind_free);
+    return child->files->bindzero;
+}
+
+/* Returns the current working directory of the child, looking it up if a
+ * chdir() left it unknown. Nothing stops an untraced child from changing
+ * directory, hers is looked up every time.
+ * Returns NULL and sets errno on failure.
+ */
+const char *tchild_getcwd(struct tchild *child)
+{
+    if (child->flags & TCHILD_UNTRACED) {
+        g_free(child->fs->cwd);
+        child->fs->cwd = proc_getcwd(child->pid);
+    }
+    else if (NULL == child->fs->cwd) {
+        child->fs->cwd = proc_getcwd(child->pid);
+        if (NULL != child->fs->cwd)
+            g_info("child %i has changed directory to '%s'", child->pid, child->fs->cwd);
+    }
+    return child->fs->cwd;
+}
+
+/* Gives the thread group of the child its own copy of the sandbox data
+ * before it's changed.
+ */
+void tchild_unshare(struct tchild *child)
+{
+    struct tdata *sandbox;
+
+    if (1 == g_atomic_int_get(&child->group->sandbox->refcount))
+        return;
+
+    g_debug("child %i unshares sandbox data", child->pid);
+    sandbox = tdata_new();
+    sandbox->path = child->group->sandbox->path;
+    sandbox->exec = child->group->sandbox->exec;
+    sandbox->network = child->group->sandbox->network;
+    sandbox->lock = child->group->sandbox->lock;
+    pathlist_copy(&(sandbox->write_prefixes), &(child->group->sandbox->write_prefixes));
+    pathlist_copy(&(sandbox->exec_prefixes), &(child->group->sandbox->exec_prefixes));
+    tdata_unref(child->group->sandbox);
+    child->group->sandbox = sandbox;
+}
+
+struct tbind *tbind_new(unsigned long inode, const struct sydbox_addr *addr)
+{
+    struct tbind *bind;
+
+    bind = g_new(struct tbind, 1);
+    bind->inode = inode;
+    bind->addr = address_dup(addr);
+    return bind;
+}
+
+void tbind_free(gpointer bind_ptr)
+{
+    struct tbind *bind = (struct tbind *) bind_ptr;
+
+    address_free(bind->addr);
+    g_free(bind);
+}
+
+static void tbind_copy_one(gpointer fd, gpointer bind_ptr, gpointer bindzero)
+{
+    struct tbind *bind = (struct tbind *) bind_ptr;
+
+    g_hash_table_insert((GHashTable *) bindzero, fd, tbind_new(bind->inode, bind->addr));
+}
+
+/* Gives the child her own copy of the state unshare(2) separates her from,
+ * the current working directory with CLONE_FS and the file descriptor table
+ * with CLONE_FILES.
+ */
+void tchild_split(struct tchild *child, unsigned long flags)
+{
+    struct tfs *fs;
+    struct tfiles *files;
+
+    if (flags & CLONE_FS && 1 != g_atomic_int_get(&child->fs->refcount)) {
+        g_debug("child %i unshares her current working directory", child->pid);
+        fs = tfs_new(child->fs->cwd);
+        tfs_unref(child->fs);
+        child->fs = fs;
+    }
+    if (flags & CLONE_FILES && 1 != g_atomic_int_get(&child->files->refcount)) {
+        g_debug("child %i unshares her file descriptor table", child->pid);
+        files = tfiles_new();
+        if (NULL != child->files->bindzero) {
+            files->bindzero = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, tbind_free);
+            g_hash_table_foreach(child->files->bindzero, tbind_copy_one, files->bindzero);
+        }
+        tfiles_unref(child->files);
+        child->files = files;
+    }
 }
 
 void tchild_free_one(gpointer child_ptr)
 {
     struct tchild *child = (struct tchild *) child_ptr;
 
-    if (G_LIKELY(NULL != child->sandbox)) {
-        if (G_LIKELY(NULL != child->sandbox->write_prefixes))
-            pathnode_free(&(child->sandbox->write_prefixes));
-        if (G_LIKELY(NULL != child->sandbox->exec_prefixes))
-            pathnode_free(&(child->sandbox->exec_prefixes));
-        g_free(child->sandbox);
-    }
-    if (G_LIKELY(NULL != child->lastexec))
-        g_string_free(child->lastexec, TRUE);
-    if (G_LIKELY(NULL != child->bindzero))
-        g_hash_table_destroy(child->bindzero);
+    if (G_LIKELY(NULL != child->group))
+        tgroup_unref(child->group);
+    if (G_LIKELY(NULL != child->fs))
+        tfs_unref(child->fs);
+    if (G_LIKELY(NULL != child->files))
+        tfiles_unref(child->files);
     address_free(child->bindlast);
-    g_free(child->cwd);
-    g_free(child);
+    g_slice_free(struct tchild, child);
 }
 
-void tchild_kill_one(gpointer pid_ptr, G_GNUC_UNUSED gpointer child_ptr, G_GNUC_UNUSED void *userdata)
+void tchild_kill_one(struct tchild *child, G_GNUC_UNUSED void *userdata)
 {
-    pink_trace_kill(GPOINTER_TO_INT(pid_ptr));
+    pink_trace_kill(child->pid);
 }
 
-void tchild_resume_one(gpointer pid_ptr, G_GNUC_UNUSED gpointer child_ptr, G_GNUC_UNUSED void *userdata)
+void tchild_delete(struct childtab *children, pid_t pid)
 {
-    pink_trace_resume(GPOINTER_TO_INT(pid_ptr), 0);
-}
+    guint i, j, k, mask;
+    struct tchild *child;
 
-void tchild_delete(GHashTable *children, pid_t pid)
-{
-    g_hash_table_remove(children, GINT_TO_POINTER(pid));
+    i = childtab_lookup(children, pid);
+    if (0 == children->slots[i].pid)
+        return;
+    child = children->slots[i].child;
+
+    /* Shift the following entries of the probe sequence back so there are
+     * no holes in it, an entry moves unless its home slot lies in (i, j].
+     */
+    mask = childtab_mask(children);
+    for (j = (i + 1) & mask; 0 != children->slots[j].pid; j = (j + 1) & mask) {
+        k = childtab_home(children, children->slots[j].pid);
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        children->slots[i] = children->slots[j];
+        i = j;
+    }
+    children->slots[i].pid = 0;
+    children->slots[i].child = NULL;
+    --children->size;
+
+    if (children->bits > CHILDTAB_BITS_MIN && 8 * children->size < (1U << children->bits))
+        childtab_resize(children, children->bits - 1);
+
+    tchild_free_one(child);
 }
 
-struct tchild *tchild_find(GHashTable *children, pid_t pid)
+struct tchild *tchild_find(const struct childtab *children, pid_t pid)
 {
-    return g_hash_table_lookup(children, GINT_TO_POINTER(pid));
+    guint i;
+
+    i = childtab_lookup(children, pid);
+    return (0 != children->slots[i].pid) ? children->slots[i].child : NULL;
 }
 
@@ -28,12 +28,18 @@
 #include <pinktrace/pink.h>
 
 #include "syd-net.h"
+#include "syd-path.h"
 
 /* TCHILD flags */
 #define TCHILD_NEEDSETUP   (1 << 0)    /* child needs setup. */
 #define TCHILD_NEEDINHERIT (1 << 1)    /* child needs to inherit sandbox data from her parent. */
 #define TCHILD_INSYSCALL   (1 << 2)    /* child is in syscall. */
 #define TCHILD_DENYSYSCALL (1 << 3)    /* child has been denied access to the syscall. */
+#define TCHILD_UNTRACED    (1 << 4)    /* child isn't stopped while she's checked (seccomp-notify backend). */
+
+/* TREGS flags */
+#define TREGS_ARGS         (1 << 0)    /* system call number and arguments are valid. */
+#define TREGS_RETVAL       (1 << 1)    /* return value is valid. */
 
 /* per process tracking data */
 enum lock_status
@@ -43,14 +49,67 @@ enum lock_status
     LOCK_PENDING,    // Magic commands will be locked when an execve() is encountered.
 };
 
+/* Sandbox data is shared between a parent and its children until one of them
+ * changes it, see tchild_unshare().
+ */
 struct tdata
 {
+    volatile gint refcount; // Number of children sharing the data.
     bool path;              // Whether path sandboxing is enabled for child.
     bool exec;              // Whether execve(2) sandboxing is enabled for child.
     bool network;           // Whether network sandboxing is enabled for child.
     int lock;               // Whether magic commands are locked for the child.
-    GSList *write_prefixes;
-    GSList *exec_prefixes;
+    struct pathlist write_prefixes;
+    struct pathlist exec_prefixes;
+};
+
+/* Snapshot of the system call registers of a traced child, fetched once per
+ * stop so the checks don't need a ptrace() call for every argument.
+ */
+struct tregs
+{
+    int valid;               // TREGS_ flags
+    long sno;                // System call number
+    guint64 args[6];         // System call arguments
+    long retval;             // Return value of the system call
+    long subcall;            // Decoded socketcall() subcall, -1 if not decoded yet
+};
+
+/* A socket bound to port zero, its address is whitelisted for connect() when
+ * getsockname() reveals the port.
+ */
+struct tbind
+{
+    unsigned long inode;        // Inode of the socket, zero if unknown.
+    struct sydbox_addr *addr;   // Address of the bind() call.
+};
+
+/* State of a thread group, threads created with CLONE_THREAD share the
+ * sandbox data of their process.
+ */
+struct tgroup
+{
+    volatile gint refcount;  // Number of threads in the group.
+    GString *lastexec;       // Last execve() arguments converted to string (used for debugging), NULL until set
+    struct tdata *sandbox;   // Sandbox data
+};
+
+/* Current working directory, shared by the tasks created with CLONE_FS until
+ * one of them calls unshare(CLONE_FS).
+ */
+struct tfs
+{
+    volatile gint refcount;  // Number of tasks sharing the directory.
+    char *cwd;               // Current working directory, NULL if it must be looked up.
+};
+
+/* File descriptor table, shared by the tasks created with CLONE_FILES until
+ * one of them calls unshare(CLONE_FILES) or execve().
+ */
+struct tfiles
+{
+    volatile gint refcount;  // Number of tasks sharing the table.
+    GHashTable *bindzero;    // Sockets bound to port zero by file descriptor, see struct tbind, NULL until used
 };
 
 struct tchild
@@ -58,28 +117,88 @@ struct tchild
     int flags;               // TCHILD_ flags
     pid_t pid;               // Process ID of the child.
     pink_bitness_t bitness;  // Bitness (32bit, 64bit etc.)
-    char *cwd;               // Child's current working directory.
     unsigned long sno;       // Last system call called by child.
+    int sflags;              // Dispatch flags of the system call, looked up on entry.
+    int sexit;               // Post-processing flags of the system call, looked up on entry.
     long retval;             // Replaced system call will return this value.
-    GString *lastexec;       // Last execve() arguments converted to string (used for debugging)
-    GHashTable *bindzero;    // List of addresses whose port argument was zero.
     struct sydbox_addr *bindlast; // Last bind() address
-    struct tdata *sandbox;   // Sandbox data
+    struct tgroup *group;    // Thread group of the child
+    struct tfs *fs;          // Current working directory of the child
+    struct tfiles *files;    // File descriptor table of the child
+    const guint64 *args;     // System call arguments (seccomp-notify backend)
+    guint64 starttime;       // Start time of the process, zero if unknown (seccomp-notify backend)
+    struct tregs regs;       // Registers at the current stop (ptrace backend)
+};
+
+/* Children indexed by pid with open addressing and linear probing. The slots
+ * keep the pid next to the record so probing doesn't touch the records, which
+ * are allocated separately and stay put as the table grows.
+ */
+struct childslot
+{
+    pid_t pid;               // Zero if the slot is empty
+    struct tchild *child;
 };
 
-struct tchild *tchild_new(GHashTable *children, pid_t pid, bool eldest);
+struct childtab
+{
+    guint size;              // Number of children
+    guint bits;              // The table has 1 << bits slots
+    struct childslot *slots;
+};
 
-void tchild_inherit(struct tchild *child, struct tchild *parent);
+typedef void (*childtab_func) (struct tchild *child, void *userdata);
+typedef bool (*childtab_remove_func) (struct tchild *child, void *userdata);
 
-void tchild_free_one(gpointer child_ptr);
+struct tdata *tdata_new(void);
+
+struct tdata *tdata_ref(struct tdata *sandbox);
+
+void tdata_unref(struct tdata *sandbox);
+
+struct tgroup *tgroup_new(void);
+
+struct tgroup *tgroup_ref(struct tgroup *group);
+
+void tgroup_unref(struct tgroup *group);
+
+struct childtab *childtab_new(void);
+
+void childtab_free(struct childtab *children);
+
+guint childtab_size(const struct childtab *children);
 
-void tchild_kill_one(gpointer pid_ptr, gpointer child_ptr, void *userdata);
+void childtab_foreach(struct childtab *children, childtab_func func, void *userdata);
+
+guint childtab_foreach_remove(struct childtab *children, childtab_remove_func func, void *userdata);
+
+struct tchild *tchild_new(struct childtab *children, pid_t pid, bool eldest);
+
+void tchild_unshare(struct tchild *child);
+
+void tchild_inherit(struct tchild *child, struct tchild *parent, unsigned long flags);
+
+void tchild_split(struct tchild *child, unsigned long flags);
+
+const char *tchild_getcwd(struct tchild *child);
+
+bool tchild_quiescent(const struct tchild *child);
+
+GString *tchild_lastexec(struct tchild *child);
+
+GHashTable *tchild_bindzero(struct tchild *child);
+
+struct tbind *tbind_new(unsigned long inode, const struct sydbox_addr *addr);
+
+void tbind_free(gpointer bind_ptr);
+
+void tchild_free_one(gpointer child_ptr);
 
-void tchild_resume_one(gpointer pid_ptr, gpointer child_ptr, void *userdata);
+void tchild_kill_one(struct tchild *child, void *userdata);
 
-void tchild_delete(GHashTable *children, pid_t pid);
+void tchild_delete(struct childtab *children, pid_t pid);
 
-struct tchild *tchild_find(GHashTable *children, pid_t pid);
+struct tchild *tchild_find(const struct childtab *children, pid_t pid);
 
 #endif // SYDBOX_GUARD_CHILDREN_H
 
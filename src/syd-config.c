@@ -25,22 +25,37 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <arpa/inet.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
 
 #include "syd-config.h"
+#include "syd-glob.h"
+#include "syd-netset.h"
 #include "syd-log.h"
 #include "syd-net.h"
 #include "syd-path.h"
+#include "syd-proc.h"
+
+/* Automatically whitelisted addresses are dropped when there are more than
+ * this many of them and a sweep finds none to drop.
+ */
+#define NETWORK_AUTO_WHITELIST_MAX 4096
+
+/* An address whitelisted for connect() after a successful bind() */
+struct autowhitelist
+{
+    long fd;                    // File descriptor of the bound socket
+    unsigned long inode;        // Inode of the socket, zero if unknown
+    struct sydbox_addr *addr;
+};
 
 struct sydbox_config
 {
     gchar *logfile;
 
-    gint verbosity;
-
     bool sandbox_path;
     bool sandbox_exec;
     bool sandbox_network;
@@ -52,23 +67,36 @@ struct sydbox_config
     bool wait_all;
     bool allow_proc_pid;
     bool wrap_lstat;
+    bool detach_quiescent;
+    bool seccomp;
+    int backend;
 
     GSList *filters;
     GSList *exec_filters;
     GSList *network_filters;
-    GSList *write_prefixes;
-    GSList *exec_prefixes;
+    struct globset *filter_globs;
+    struct globset *exec_filter_globs;
+    struct netset *network_filter_set;
+    struct pathlist write_prefixes;
+    struct pathlist exec_prefixes;
     GSList *network_whitelist_bind;
     GSList *network_whitelist_connect;
+    struct netset *network_whitelist_sets[2]; // Indexes of the whitelists, [1] is connect
+    GHashTable *network_auto_whitelist; // Owner pid to address string to struct autowhitelist
+    guint network_auto_whitelist_size;
+    guint64 network_auto_whitelist_added;
+    guint64 network_auto_whitelist_dropped;
 } *config;
 
+gint sydbox_config_verbosity = 1;
+
 
 static void sydbox_config_set_defaults(void)
 {
     g_assert(config != NULL);
 
     config->colourise_output = true;
-    config->verbosity = 1;
+    sydbox_config_verbosity = 1;
     config->sandbox_path = true;
     config->sandbox_exec = false;
     config->sandbox_network = false;
@@ -77,13 +105,27 @@ static void sydbox_config_set_defaults(void)
     config->wait_all = true;
     config->allow_proc_pid = true;
     config->wrap_lstat = true;
+    config->detach_quiescent = false;
+    config->seccomp = true;
+    config->backend = BACKEND_PTRACE;
     config->filters = NULL;
     config->exec_filters = NULL;
     config->network_filters = NULL;
-    config->write_prefixes = NULL;
-    config->exec_prefixes = NULL;
+    config->filter_globs = NULL;
+    config->exec_filter_globs = NULL;
+    config->network_filter_set = NULL;
+    config->write_prefixes.paths = NULL;
+    config->write_prefixes.trie = NULL;
+    config->exec_prefixes.paths = NULL;
+    config->exec_prefixes.trie = NULL;
     config->network_whitelist_bind = NULL;
     config->network_whitelist_connect = NULL;
+    config->network_whitelist_sets[0] = NULL;
+    config->network_whitelist_sets[1] = NULL;
+    config->network_auto_whitelist = NULL;
+    config->network_auto_whitelist_size = 0;
+    config->network_auto_whitelist_added = 0;
+    config->network_auto_whitelist_dropped = 0;
 }
 
 static GKeyFile *sydbox_config_open(const gchar * const config_file, GError **config_error)
@@ -101,6 +143,7 @@ static GKeyFile *sydbox_config_open(const gchar * const config_file, GError **co
 
 static bool sydbox_config_load_settings(GKeyFile *config_fd)
 {
+    gchar *backend;
     GError *config_error = NULL;
 
     g_assert(config_fd != NULL);
@@ -204,11 +247,65 @@ static bool sydbox_config_load_settings(GKeyFile *config_fd)
         }
     }
 
+    // Get main.detach_quiescent
+    config->detach_quiescent = g_key_file_get_boolean(config_fd, "main", "detach_quiescent", &config_error);
+    if (!config->detach_quiescent && config_error) {
+        switch (config_error->code) {
+            case G_KEY_FILE_ERROR_INVALID_VALUE:
+                g_printerr("main.detach_quiescent not a boolean: %s\n", config_error->message);
+                g_error_free(config_error);
+                return false;
+            case G_KEY_FILE_ERROR_GROUP_NOT_FOUND:
+            case G_KEY_FILE_ERROR_KEY_NOT_FOUND:
+                g_error_free(config_error);
+                config_error = NULL;
+                config->detach_quiescent = false;
+                break;
+            default:
+                g_assert_not_reached();
+                break;
+        }
+    }
+
+    // Get main.seccomp
+    config->seccomp = g_key_file_get_boolean(config_fd, "main", "seccomp", &config_error);
+    if (!config->seccomp && config_error) {
+        switch (config_error->code) {
+            case G_KEY_FILE_ERROR_INVALID_VALUE:
+                g_printerr("main.seccomp not a boolean: %s\n", config_error->message);
+                g_error_free(config_error);
+                return false;
+            case G_KEY_FILE_ERROR_GROUP_NOT_FOUND:
+            case G_KEY_FILE_ERROR_KEY_NOT_FOUND:
+                g_error_free(config_error);
+                config_error = NULL;
+                config->seccomp = true;
+                break;
+            default:
+                g_assert_not_reached();
+                break;
+        }
+    }
+
+    // Get main.backend
+    backend = g_key_file_get_string(config_fd, "main", "backend", NULL);
+    if (NULL != backend) {
+        config->backend = sydbox_config_backend_from_string(backend);
+        if (0 > config->backend) {
+            g_printerr("main.backend not one of ptrace, seccomp-notify: %s\n", backend);
+            g_free(backend);
+            return false;
+        }
+        g_free(backend);
+    }
+    else
+        config->backend = BACKEND_PTRACE;
+
     // Get log.file
     config->logfile = g_key_file_get_string(config_fd, "log", "file", NULL);
 
     // Get log.level
-    config->verbosity = g_key_file_get_integer(config_fd, "log", "level", &config_error);
+    sydbox_config_verbosity = g_key_file_get_integer(config_fd, "log", "level", &config_error);
     if (config_error) {
         switch (config_error->code) {
             case G_KEY_FILE_ERROR_INVALID_VALUE:
@@ -219,7 +316,7 @@ static bool sydbox_config_load_settings(GKeyFile *config_fd)
             case G_KEY_FILE_ERROR_KEY_NOT_FOUND:
                 g_error_free(config_error);
                 config_error = NULL;
-                config->verbosity = 1;
+                sydbox_config_verbosity = 1;
                 break;
             default:
                 g_assert_not_reached();
@@ -348,7 +445,7 @@ static bool sydbox_config_load_lists(GKeyFile *config_fd)
                     return false;
                 }
                 sydbox_config_addfilter_net(addr);
-                g_free(addr);
+                address_free(addr);
             }
             g_strfreev(expaddr);
         }
@@ -386,7 +483,7 @@ static bool sydbox_config_load_lists(GKeyFile *config_fd)
                     g_strfreev(netwhitelist_bind);
                     return false;
                 }
-                config->network_whitelist_bind = g_slist_prepend(config->network_whitelist_bind, addr);
+                sydbox_config_addwhitelist_bind(addr);
             }
             g_strfreev(expaddr);
         }
@@ -408,7 +505,7 @@ static bool sydbox_config_load_lists(GKeyFile *config_fd)
                     g_strfreev(netwhitelist_connect);
                     return false;
                 }
-                config->network_whitelist_connect = g_slist_prepend(config->network_whitelist_connect, addr);
+                sydbox_config_addwhitelist_connect(addr);
             }
             g_strfreev(expaddr);
         }
@@ -525,7 +622,7 @@ void sydbox_config_update_from_environment(void)
                     g_strfreev(netwhitelist_bind);
                     exit(-1);
                 }
-                config->network_whitelist_bind = g_slist_prepend(config->network_whitelist_bind, addr);
+                sydbox_config_addwhitelist_bind(addr);
             }
             g_strfreev(expaddr);
         }
@@ -549,7 +646,7 @@ void sydbox_config_update_from_environment(void)
                     g_strfreev(netwhitelist_connect);
                     exit(-1);
                 }
-                config->network_whitelist_connect = g_slist_prepend(config->network_whitelist_connect, addr);
+                sydbox_config_addwhitelist_connect(addr);
             }
             g_strfreev(expaddr);
         }
@@ -583,6 +680,9 @@ void sydbox_config_write_to_stderr (void)
     g_fprintf(stderr, "main.wait_all = %s\n", config->wait_all ? "yes" : "no");
     g_fprintf(stderr, "main.allow_proc_pid = %s\n", config->allow_proc_pid ? "yes" : "no");
     g_fprintf(stderr, "main.wrap_lstat = %s\n", config->wrap_lstat ? "yes" : "no");
+    g_fprintf(stderr, "main.detach_quiescent = %s\n", config->detach_quiescent ? "yes" : "no");
+    g_fprintf(stderr, "main.seccomp = %s\n", config->seccomp ? "yes" : "no");
+    g_fprintf(stderr, "main.backend = %s\n", sydbox_config_backend_to_string(config->backend));
     g_fprintf(stderr, "filter.path:\n");
     g_slist_foreach(config->filters, print_slist_entry, NULL);
     g_fprintf(stderr, "filter.exec:\n");
@@ -590,15 +690,15 @@ void sydbox_config_write_to_stderr (void)
     g_fprintf(stderr, "filter.network:\n");
     g_slist_foreach(config->network_filters, print_netlist_entry, NULL);
     g_fprintf(stderr, "log.file = %s\n", config->logfile ? config->logfile : "stderr");
-    g_fprintf(stderr, "log.level = %d\n", config->verbosity);
+    g_fprintf(stderr, "log.level = %d\n", sydbox_config_verbosity);
     g_fprintf(stderr, "sandbox.path = %s\n", config->sandbox_path ? "yes" : "no");
     g_fprintf(stderr, "sandbox.exec = %s\n", config->sandbox_exec ? "yes" : "no");
     g_fprintf(stderr, "sandbox.network = %s\n", config->sandbox_network ? "yes" : "no");
     g_fprintf(stderr, "net.auto_whitelist_bind = %s\n", config->network_auto_whitelist_bind ? "yes" : "no");
     g_fprintf(stderr, "prefix.write:\n");
-    g_slist_foreach(config->write_prefixes, print_slist_entry, NULL);
+    g_slist_foreach(config->write_prefixes.paths, print_slist_entry, NULL);
     g_fprintf(stderr, "prefix.exec:\n");
-    g_slist_foreach(config->exec_prefixes, print_slist_entry, NULL);
+    g_slist_foreach(config->exec_prefixes.paths, print_slist_entry, NULL);
     g_fprintf(stderr, "net.whitelist_bind:\n");
     g_slist_foreach(config->network_whitelist_bind, print_netlist_entry, NULL);
     g_fprintf(stderr, "net.whitelist_connect:\n");
@@ -618,14 +718,9 @@ void sydbox_config_set_log_file(const gchar * const logfile)
     config->logfile = g_strdup(logfile);
 }
 
-gint sydbox_config_get_verbosity(void)
-{
-    return config->verbosity;
-}
-
 void sydbox_config_set_verbosity(gint verbosity)
 {
-    config->verbosity = verbosity;
+    sydbox_config_verbosity = verbosity;
 }
 
 bool sydbox_config_get_sandbox_path(void)
@@ -718,14 +813,65 @@ void sydbox_config_set_wrap_lstat(bool wrap)
     config->wrap_lstat = wrap;
 }
 
-GSList *sydbox_config_get_write_prefixes(void)
+bool sydbox_config_get_detach_quiescent(void)
+{
+    return config->detach_quiescent;
+}
+
+void sydbox_config_set_detach_quiescent(bool detach)
+{
+    config->detach_quiescent = detach;
+}
+
+bool sydbox_config_get_seccomp(void)
+{
+    return config->seccomp;
+}
+
+void sydbox_config_set_seccomp(bool on)
+{
+    config->seccomp = on;
+}
+
+int sydbox_config_get_backend(void)
+{
+    return config->backend;
+}
+
+void sydbox_config_set_backend(int backend)
+{
+    config->backend = backend;
+}
+
+int sydbox_config_backend_from_string(const gchar *name)
 {
-    return config->write_prefixes;
+    if (0 == strcmp(name, "ptrace"))
+        return BACKEND_PTRACE;
+    else if (0 == strcmp(name, "seccomp-notify"))
+        return BACKEND_SECCOMP_NOTIFY;
+    return -1;
 }
 
-GSList *sydbox_config_get_exec_prefixes(void)
+const gchar *sydbox_config_backend_to_string(int backend)
 {
-    return config->exec_prefixes;
+    switch (backend) {
+        case BACKEND_PTRACE:
+            return "ptrace";
+        case BACKEND_SECCOMP_NOTIFY:
+            return "seccomp-notify";
+        default:
+            g_assert_not_reached();
+    }
+}
+
+struct pathlist *sydbox_config_get_write_prefixes(void)
+{
+    return &config->write_prefixes;
+}
+
+struct pathlist *sydbox_config_get_exec_prefixes(void)
+{
+    return &config->exec_prefixes;
 }
 
 GSList *sydbox_config_get_filters(void)
@@ -748,24 +894,17 @@ GSList *sydbox_config_get_network_whitelist_bind(void)
     return config->network_whitelist_bind;
 }
 
-void sydbox_config_set_network_whitelist_bind(GSList *whitelist)
-{
-    config->network_whitelist_bind = whitelist;
-}
-
 GSList *sydbox_config_get_network_whitelist_connect(void)
 {
     return config->network_whitelist_connect;
 }
 
-void sydbox_config_set_network_whitelist_connect(GSList *whitelist)
-{
-    config->network_whitelist_connect = whitelist;
-}
-
 void sydbox_config_addfilter(const gchar *filter)
 {
     config->filters = g_slist_append(config->filters, g_strdup(filter));
+    if (NULL == config->filter_globs)
+        config->filter_globs = globset_new();
+    globset_add(config->filter_globs, filter);
 }
 
 int sydbox_config_rmfilter(const gchar *filter)
@@ -775,6 +914,7 @@ int sydbox_config_rmfilter(const gchar *filter)
     for (walk = config->filters; walk != NULL; walk = g_slist_next(walk)) {
         if (0 == strncmp(walk->data, filter, strlen(filter) + 1)) {
             config->filters = g_slist_remove_link(config->filters, walk);
+            globset_remove(config->filter_globs, walk->data);
             g_free(walk->data);
             g_slist_free(walk);
             return 1;
@@ -786,6 +926,9 @@ int sydbox_config_rmfilter(const gchar *filter)
 void sydbox_config_addfilter_exec(const gchar *filter)
 {
     config->exec_filters = g_slist_append(config->exec_filters, g_strdup(filter));
+    if (NULL == config->exec_filter_globs)
+        config->exec_filter_globs = globset_new();
+    globset_add(config->exec_filter_globs, filter);
 }
 
 int sydbox_config_rmfilter_exec(const gchar *filter)
@@ -795,6 +938,7 @@ int sydbox_config_rmfilter_exec(const gchar *filter)
     for (walk = config->exec_filters; walk != NULL; walk = g_slist_next(walk)) {
         if (0 == strncmp(walk->data, filter, strlen(filter) + 1)) {
             config->exec_filters = g_slist_remove_link(config->exec_filters, walk);
+            globset_remove(config->exec_filter_globs, walk->data);
             g_free(walk->data);
             g_slist_free(walk);
             return 1;
@@ -803,9 +947,15 @@ int sydbox_config_rmfilter_exec(const gchar *filter)
     return 0;
 }
 
+/* The lists of network addresses are kept for dumping the configuration, the
+ * addresses are looked up in their indexes.
+ */
 void sydbox_config_addfilter_net(const struct sydbox_addr *filter)
 {
     config->network_filters = g_slist_append(config->network_filters, address_dup(filter));
+    if (NULL == config->network_filter_set)
+        config->network_filter_set = netset_new();
+    netset_add(config->network_filter_set, filter);
 }
 
 int sydbox_config_rmfilter_net(const struct sydbox_addr *filter)
@@ -815,7 +965,8 @@ int sydbox_config_rmfilter_net(const struct sydbox_addr *filter)
     for (walk = config->network_filters; walk != NULL; walk = g_slist_next(walk)) {
         if (address_cmp(walk->data, filter)) {
             config->network_filters = g_slist_remove_link(config->network_filters, walk);
-            g_free(walk->data);
+            netset_remove(config->network_filter_set, walk->data);
+            address_free(walk->data);
             g_slist_free(walk);
             return 1;
         }
@@ -834,9 +985,194 @@ void sydbox_config_rmfilter_all(void)
     g_slist_foreach(config->exec_filters, (GFunc)g_free, NULL);
     g_slist_free(config->exec_filters);
     config->exec_filters = NULL;
-    g_slist_foreach(config->network_filters, (GFunc)g_free, NULL);
+    g_slist_foreach(config->network_filters, (GFunc)address_free, NULL);
     g_slist_free(config->network_filters);
     config->network_filters = NULL;
+
+    if (NULL != config->filter_globs)
+        globset_clear(config->filter_globs);
+    if (NULL != config->exec_filter_globs)
+        globset_clear(config->exec_filter_globs);
+    if (NULL != config->network_filter_set)
+        netset_clear(config->network_filter_set);
+}
+
+const gchar *sydbox_config_match_filter(const gchar *path)
+{
+    return config->filter_globs ? globset_match(config->filter_globs, path) : NULL;
+}
+
+const gchar *sydbox_config_match_exec_filter(const gchar *path)
+{
+    return config->exec_filter_globs ? globset_match(config->exec_filter_globs, path) : NULL;
+}
+
+bool sydbox_config_match_network_filter(struct sydbox_addr *addr)
+{
+    return config->network_filter_set ? netset_match(config->network_filter_set, addr, false) : false;
+}
+
+static void sydbox_config_addwhitelist(GSList **whitelist, struct netset **set, struct sydbox_addr *addr)
+{
+    *whitelist = g_slist_prepend(*whitelist, addr);
+    if (NULL == *set)
+        *set = netset_new();
+    netset_add(*set, addr);
+}
+
+static bool sydbox_config_rmwhitelist(GSList **whitelist, struct netset *set, const struct sydbox_addr *addr)
+{
+    GSList *walk;
+
+    for (walk = *whitelist; walk != NULL; walk = g_slist_next(walk)) {
+        if (address_cmp(walk->data, addr)) {
+            *whitelist = g_slist_remove_link(*whitelist, walk);
+            netset_remove(set, walk->data);
+            address_free(walk->data);
+            g_slist_free(walk);
+            return true;
+        }
+    }
+    return false;
+}
+
+void sydbox_config_addwhitelist_bind(struct sydbox_addr *addr)
+{
+    sydbox_config_addwhitelist(&config->network_whitelist_bind, &config->network_whitelist_sets[0], addr);
+}
+
+bool sydbox_config_rmwhitelist_bind(const struct sydbox_addr *addr)
+{
+    return sydbox_config_rmwhitelist(&config->network_whitelist_bind, config->network_whitelist_sets[0], addr);
+}
+
+void sydbox_config_addwhitelist_connect(struct sydbox_addr *addr)
+{
+    sydbox_config_addwhitelist(&config->network_whitelist_connect, &config->network_whitelist_sets[1], addr);
+}
+
+bool sydbox_config_rmwhitelist_connect(const struct sydbox_addr *addr)
+{
+    return sydbox_config_rmwhitelist(&config->network_whitelist_connect, config->network_whitelist_sets[1], addr);
+}
+
+bool sydbox_config_match_network_whitelist(const struct sydbox_addr *addr, bool bind)
+{
+    struct netset *set = config->network_whitelist_sets[bind ? 0 : 1];
+
+    return set ? netset_match(set, addr, true) : false;
+}
+
+/* Automatically whitelisted addresses are owned by the process which bound the
+ * socket. They're only in the index of the connect() whitelist, not in its list.
+ */
+static void autowhitelist_free(gpointer data)
+{
+    struct autowhitelist *entry = (struct autowhitelist *)data;
+
+    netset_remove(config->network_whitelist_sets[1], entry->addr);
+    address_free(entry->addr);
+    g_free(entry);
+    --config->network_auto_whitelist_size;
+}
+
+static gboolean autowhitelist_stale(gpointer key, gpointer value, gpointer pid_ptr)
+{
+    unsigned long inode;
+    struct autowhitelist *entry = (struct autowhitelist *)value;
+
+    inode = proc_socket_inode(GPOINTER_TO_INT(pid_ptr), entry->fd);
+    if (0 != inode && (0 == entry->inode || inode == entry->inode))
+        return FALSE;
+    g_debug("dropping automatically whitelisted address `%s' of process %i", (gchar *)key, GPOINTER_TO_INT(pid_ptr));
+    ++config->network_auto_whitelist_dropped;
+    return TRUE;
+}
+
+static gboolean autowhitelist_sweep_one(gpointer pid_ptr, gpointer value, gpointer userdata)
+{
+    GHashTable *owned = (GHashTable *)value;
+
+    g_hash_table_foreach_remove(owned, autowhitelist_stale, pid_ptr);
+    return (0 == g_hash_table_size(owned));
+}
+
+bool sydbox_config_addwhitelist_auto(pid_t pid, long fd, unsigned long inode, struct sydbox_addr *addr)
+{
+    gchar *key;
+    GHashTable *owned;
+    struct autowhitelist *entry;
+
+    key = address_to_string(addr);
+    if (NULL == config->network_auto_whitelist)
+        config->network_auto_whitelist = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                (GDestroyNotify)g_hash_table_destroy);
+    owned = g_hash_table_lookup(config->network_auto_whitelist, GINT_TO_POINTER(pid));
+    if (NULL != owned && NULL != (entry = g_hash_table_lookup(owned, key))) {
+        /* Bound again, the last socket is the one to watch */
+        entry->fd = fd;
+        entry->inode = inode;
+        address_free(addr);
+        g_free(key);
+        return true;
+    }
+
+    if (config->network_auto_whitelist_size >= NETWORK_AUTO_WHITELIST_MAX &&
+            0 == sydbox_config_sweep_whitelist_auto()) {
+        g_warning("not whitelisting `%s' for connect, %u addresses are whitelisted automatically already",
+                key, config->network_auto_whitelist_size);
+        address_free(addr);
+        g_free(key);
+        return false;
+    }
+
+    /* The sweep may have dropped the table of the process */
+    owned = g_hash_table_lookup(config->network_auto_whitelist, GINT_TO_POINTER(pid));
+    if (NULL == owned) {
+        owned = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, autowhitelist_free);
+        g_hash_table_insert(config->network_auto_whitelist, GINT_TO_POINTER(pid), owned);
+    }
+    entry = g_new(struct autowhitelist, 1);
+    entry->fd = fd;
+    entry->inode = inode;
+    entry->addr = addr;
+    g_hash_table_insert(owned, key, entry);
+
+    if (NULL == config->network_whitelist_sets[1])
+        config->network_whitelist_sets[1] = netset_new();
+    netset_add(config->network_whitelist_sets[1], addr);
+    ++config->network_auto_whitelist_size;
+    ++config->network_auto_whitelist_added;
+    return true;
+}
+
+void sydbox_config_rmwhitelist_auto(pid_t pid)
+{
+    GHashTable *owned;
+
+    if (NULL == config->network_auto_whitelist ||
+            NULL == (owned = g_hash_table_lookup(config->network_auto_whitelist, GINT_TO_POINTER(pid))))
+        return;
+    config->network_auto_whitelist_dropped += g_hash_table_size(owned);
+    g_hash_table_remove(config->network_auto_whitelist, GINT_TO_POINTER(pid));
+}
+
+guint sydbox_config_sweep_whitelist_auto(void)
+{
+    guint size;
+
+    if (NULL == config->network_auto_whitelist)
+        return 0;
+    size = config->network_auto_whitelist_size;
+    g_hash_table_foreach_remove(config->network_auto_whitelist, autowhitelist_sweep_one, NULL);
+    return size - config->network_auto_whitelist_size;
+}
+
+void sydbox_config_whitelist_auto_stats(guint *size, guint64 *added, guint64 *dropped)
+{
+    *size = config ? config->network_auto_whitelist_size : 0;
+    *added = config ? config->network_auto_whitelist_added : 0;
+    *dropped = config ? config->network_auto_whitelist_dropped : 0;
 }
 
 void sydbox_config_rmwhitelist_all(void)
@@ -844,11 +1180,20 @@ void sydbox_config_rmwhitelist_all(void)
     if (!config)
         return;
 
-    g_slist_foreach(config->network_whitelist_bind, (GFunc)g_free, NULL);
-    g_slist_foreach(config->network_whitelist_connect, (GFunc)g_free, NULL);
+    if (NULL != config->network_auto_whitelist) {
+        g_hash_table_destroy(config->network_auto_whitelist);
+        config->network_auto_whitelist = NULL;
+    }
+
+    g_slist_foreach(config->network_whitelist_bind, (GFunc)address_free, NULL);
+    g_slist_foreach(config->network_whitelist_connect, (GFunc)address_free, NULL);
     g_slist_free(config->network_whitelist_bind);
     g_slist_free(config->network_whitelist_connect);
     config->network_whitelist_bind = NULL;
     config->network_whitelist_connect = NULL;
+    for (unsigned int i = 0; i < 2; i++) {
+        if (NULL != config->network_whitelist_sets[i])
+            netset_clear(config->network_whitelist_sets[i]);
+    }
 }
 
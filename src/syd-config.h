@@ -23,10 +23,12 @@
 #define SYDBOX_GUARD_CONFIG_H 1
 
 #include <stdbool.h>
+#include <sys/types.h>
 
 #include <glib.h>
 
 #include "syd-net.h"
+#include "syd-path.h"
 
 // Environment variables
 #define ENV_LOG                     "SYDBOX_LOG"
@@ -44,8 +46,17 @@
 #define ENV_LOCK                    "SYDBOX_LOCK"
 #define ENV_NO_WAIT                 "SYDBOX_EXIT_WITH_ELDEST"
 #define ENV_NOWRAP_LSTAT            "SYDBOX_NOWRAP_LSTAT"
+#define ENV_NO_SECCOMP              "SYDBOX_NO_SECCOMP"
+#define ENV_BACKEND                 "SYDBOX_BACKEND"
 #define ENV_USER_CONFIG             "SYDBOX_USER_CONFIG"
 
+// Tracing backends
+enum sydbox_backend
+{
+    BACKEND_PTRACE,         // Children are stopped with ptrace(2)
+    BACKEND_SECCOMP_NOTIFY, // System calls are received from a seccomp listener
+};
+
 /**
  * sydbox_config_load:
  * @param config: path to the configuration file.
@@ -100,6 +111,11 @@ const gchar *sydbox_config_get_log_file(void);
  **/
 void sydbox_config_set_log_file(const gchar * const logfile);
 
+/* The verbosity lives outside the configuration so the logging macros can
+ * check it inline, even before the configuration is loaded.
+ */
+extern gint sydbox_config_verbosity;
+
 /**
  * sydbox_config_get_verbosity:
  *
@@ -109,7 +125,10 @@ void sydbox_config_set_log_file(const gchar * const logfile);
  *
  * Since: 0.1_alpha
  **/
-gint sydbox_config_get_verbosity(void);
+static inline gint sydbox_config_get_verbosity(void)
+{
+    return sydbox_config_verbosity;
+}
 
 /**
  * sydbox_config_set_verbosity:
@@ -185,18 +204,34 @@ bool sydbox_config_get_wrap_lstat(void);
 
 void sydbox_config_set_wrap_lstat(bool wrap);
 
+bool sydbox_config_get_detach_quiescent(void);
+
+void sydbox_config_set_detach_quiescent(bool detach);
+
+bool sydbox_config_get_seccomp(void);
+
+void sydbox_config_set_seccomp(bool on);
+
+int sydbox_config_get_backend(void);
+
+void sydbox_config_set_backend(int backend);
+
+int sydbox_config_backend_from_string(const gchar *name);
+
+const gchar *sydbox_config_backend_to_string(int backend);
+
 /**
  * sydbox_config_get_write_prefixes:
  *
  * Returns a list of permitted write prefixes
  *
- * Returns: a #GSList containing permitted write prefixes
+ * Returns: a #pathlist containing permitted write prefixes
  *
  * Since: 0.1_alpha
  **/
-GSList *sydbox_config_get_write_prefixes(void);
+struct pathlist *sydbox_config_get_write_prefixes(void);
 
-GSList *sydbox_config_get_exec_prefixes(void);
+struct pathlist *sydbox_config_get_exec_prefixes(void);
 
 GSList *sydbox_config_get_filters(void);
 
@@ -206,12 +241,8 @@ GSList *sydbox_config_get_network_filters(void);
 
 GSList *sydbox_config_get_network_whitelist_bind(void);
 
-void sydbox_config_set_network_whitelist_bind(GSList *whitelist);
-
 GSList *sydbox_config_get_network_whitelist_connect(void);
 
-void sydbox_config_set_network_whitelist_connect(GSList *whitelist);
-
 void sydbox_config_addfilter(const gchar *filter);
 
 int sydbox_config_rmfilter(const gchar *filter);
@@ -226,6 +257,73 @@ int sydbox_config_rmfilter_net(const struct sydbox_addr *filter);
 
 void sydbox_config_rmfilter_all(void);
 
+/**
+ * sydbox_config_match_filter:
+ * @path: path to match
+ *
+ * Matches the path against all path filters at once.
+ *
+ * Returns: the first filter matching @path, %NULL if there is none
+ **/
+const gchar *sydbox_config_match_filter(const gchar *path);
+
+const gchar *sydbox_config_match_exec_filter(const gchar *path);
+
+bool sydbox_config_match_network_filter(struct sydbox_addr *addr);
+
+void sydbox_config_addwhitelist_bind(struct sydbox_addr *addr);
+
+bool sydbox_config_rmwhitelist_bind(const struct sydbox_addr *addr);
+
+void sydbox_config_addwhitelist_connect(struct sydbox_addr *addr);
+
+bool sydbox_config_rmwhitelist_connect(const struct sydbox_addr *addr);
+
+/**
+ * sydbox_config_match_network_whitelist:
+ * @addr: address to match
+ * @bind: whether to match the bind() whitelist, the connect() whitelist otherwise
+ *
+ * Looks the address and its port up in the whitelist index.
+ *
+ * Returns: %TRUE if a whitelisted address has @addr
+ **/
+bool sydbox_config_match_network_whitelist(const struct sydbox_addr *addr, bool bind);
+
+/**
+ * sydbox_config_addwhitelist_auto:
+ * @pid: process which bound the socket
+ * @fd: file descriptor of the socket in @pid
+ * @inode: inode of the socket, zero if unknown
+ * @addr: address the socket is bound to, owned by the whitelist afterwards
+ *
+ * Whitelists the address of a successful bind() for connect() until the socket
+ * is closed or the process exits. An address is whitelisted once per process.
+ *
+ * Returns: %FALSE if there are too many automatically whitelisted addresses
+ **/
+bool sydbox_config_addwhitelist_auto(pid_t pid, long fd, unsigned long inode, struct sydbox_addr *addr);
+
+/**
+ * sydbox_config_rmwhitelist_auto:
+ * @pid: process which exited
+ *
+ * Drops the addresses whitelisted automatically for the process.
+ **/
+void sydbox_config_rmwhitelist_auto(pid_t pid);
+
+/**
+ * sydbox_config_sweep_whitelist_auto:
+ *
+ * Drops the automatically whitelisted addresses whose socket is no longer open,
+ * according to /proc/PID/fd.
+ *
+ * Returns: the number of addresses dropped
+ **/
+guint sydbox_config_sweep_whitelist_auto(void);
+
+void sydbox_config_whitelist_auto_stats(guint *size, guint64 *added, guint64 *dropped);
+
 void sydbox_config_rmwhitelist_all(void);
 
 #endif // SYDBOX_GUARD_CONFIG_H
@@ -40,7 +40,10 @@ context_t *context_new(void)
 
     ctx = g_new(context_t, 1);
 
-    ctx->children = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, tchild_free_one);
+    ctx->children = childtab_new();
+    ctx->seccomp = false;
+    ctx->exitkill = true;
+    ctx->signum = 0;
 
     return ctx;
 }
@@ -48,7 +51,7 @@ context_t *context_new(void)
 void context_free(context_t *ctx)
 {
     if (NULL != ctx->children) {
-        g_hash_table_destroy(ctx->children);
+        childtab_free(ctx->children);
         ctx->children = NULL;
     }
     g_free(ctx);
@@ -57,8 +60,8 @@ void context_free(context_t *ctx)
 int context_remove_child(context_t * const ctx, pid_t pid)
 {
     g_info("removing child %i from context", pid);
-    g_hash_table_remove(ctx->children, GINT_TO_POINTER(pid));
+    tchild_delete(ctx->children, pid);
 
-    return (0 == g_hash_table_size(ctx->children)) ? -1 : 0;
+    return (0 == childtab_size(ctx->children)) ? -1 : 0;
 }
 
@@ -26,10 +26,15 @@
 
 #include <glib.h>
 
+struct childtab;
+
 typedef struct
 {
     pid_t eldest;         // First child's pid is kept to determine return code.
-    GHashTable *children; // List of children
+    struct childtab *children; // Children indexed by pid
+    bool seccomp;         // Whether children are stopped by a seccomp filter
+    bool exitkill;        // Whether children are killed if sydbox dies, not if they were attached to
+    int signum;           // Signal that ended the loop, zero if none
 } context_t;
 
 context_t *context_new(void);
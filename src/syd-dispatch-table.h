@@ -20,84 +20,105 @@
 #ifndef SYDBOX_GUARD_DISPATCH_TABLE_H
 #define SYDBOX_GUARD_DISPATCH_TABLE_H 1
 
+#include "syd-dispatch.h"
 #include "syd-flags.h"
 
-/* System call dispatch table
- * If the system call doesn't need to be stopped at the beginning, do NOT add
- * it to this table. Add a dispatch_* function instead like dispatch_chdir().
+/* System call dispatch table indexed by system call number.
+ * flags are checked when the system call is entered, exit flags tell which
+ * post-processing the exit of the system call needs. System calls with
+ * neither are let through without a look. EXIT_ADOPT is only handled by the
+ * seccomp-notify backend, which is notified at entry. Files including this header
+ * include the asm/unistd*.h of their bitness first, so every bitness gets a
+ * table of its own.
  */
-static const struct syscall_def {
-    int no;
-    int flags;
-} syscalls[] = {
-    {__NR_chmod,        CHECK_PATH},
-    {__NR_chown,        CHECK_PATH},
+static const struct dispatch_entry dispatch_table[] = {
+    [__NR_chmod] =        {CHECK_PATH, 0},
+    [__NR_chown] =        {CHECK_PATH, 0},
 #if defined(__NR_chown32)
-    {__NR_chown32,      CHECK_PATH},
+    [__NR_chown32] =      {CHECK_PATH, 0},
 #endif
-    {__NR_open,         CHECK_PATH | OPEN_MODE},
-    {__NR_creat,        CHECK_PATH | CAN_CREAT},
-    {__NR_stat,         MAGIC_STAT},
+    [__NR_open] =         {CHECK_PATH | OPEN_MODE, 0},
+    [__NR_creat] =        {CHECK_PATH | CAN_CREAT, 0},
+    [__NR_stat] =         {MAGIC_STAT, 0},
 #if defined(__NR_stat64)
-    {__NR_stat64,       MAGIC_STAT},
+    [__NR_stat64] =       {MAGIC_STAT, 0},
 #endif
-    {__NR_lstat,        MAGIC_STAT},
+    [__NR_lstat] =        {MAGIC_STAT, 0},
 #if defined(__NR_lstat64)
-    {__NR_lstat64,      MAGIC_STAT},
+    [__NR_lstat64] =      {MAGIC_STAT, 0},
 #endif
-    {__NR_lchown,       CHECK_PATH | DONT_RESOLV},
+    [__NR_lchown] =       {CHECK_PATH | DONT_RESOLV, 0},
 #if defined(__NR_lchown32)
-    {__NR_lchown32,     CHECK_PATH | DONT_RESOLV},
-#endif
-    {__NR_link,         CHECK_PATH | CHECK_PATH2 | MUST_CREAT2 | DONT_RESOLV},
-    {__NR_mkdir,        CHECK_PATH | MUST_CREAT},
-    {__NR_mknod,        CHECK_PATH | MUST_CREAT},
-    {__NR_access,       CHECK_PATH | ACCESS_MODE},
-    {__NR_rename,       CHECK_PATH | CHECK_PATH2 | CAN_CREAT2 | DONT_RESOLV},
-    {__NR_rmdir,        CHECK_PATH | DONT_RESOLV},
-    {__NR_symlink,      CHECK_PATH2 | MUST_CREAT2 | DONT_RESOLV},
-    {__NR_truncate,     CHECK_PATH},
+    [__NR_lchown32] =     {CHECK_PATH | DONT_RESOLV, 0},
+#endif
+    [__NR_link] =         {CHECK_PATH | CHECK_PATH2 | MUST_CREAT2 | DONT_RESOLV, 0},
+    [__NR_mkdir] =        {CHECK_PATH | MUST_CREAT, 0},
+    [__NR_mknod] =        {CHECK_PATH | MUST_CREAT, 0},
+    [__NR_access] =       {CHECK_PATH | ACCESS_MODE, 0},
+    [__NR_rename] =       {CHECK_PATH | CHECK_PATH2 | CAN_CREAT2 | DONT_RESOLV | CHANGES_PATHS, 0},
+    [__NR_rmdir] =        {CHECK_PATH | DONT_RESOLV | CHANGES_PATHS, 0},
+    [__NR_symlink] =      {CHECK_PATH2 | MUST_CREAT2 | DONT_RESOLV | CHANGES_PATHS, 0},
+    [__NR_truncate] =     {CHECK_PATH, 0},
 #if defined(__NR_truncate64)
-    {__NR_truncate64,   CHECK_PATH},
+    [__NR_truncate64] =   {CHECK_PATH, 0},
 #endif
-    {__NR_mount,        CHECK_PATH2},
+    [__NR_mount] =        {CHECK_PATH2 | CHANGES_PATHS, 0},
 #if defined(__NR_umount)
-    {__NR_umount,       CHECK_PATH},
+    [__NR_umount] =       {CHECK_PATH | CHANGES_PATHS, 0},
 #endif
 #if defined(__NR_umount2)
-    {__NR_umount2,      CHECK_PATH},
+    [__NR_umount2] =      {CHECK_PATH | CHANGES_PATHS, 0},
 #endif
 #if defined(__NR_utime)
-    {__NR_utime,        CHECK_PATH},
+    [__NR_utime] =        {CHECK_PATH, 0},
 #endif
 #if defined(__NR_utimes)
-    {__NR_utimes,       CHECK_PATH},
-#endif
-    {__NR_unlink,       CHECK_PATH | DONT_RESOLV},
-    {__NR_openat,       CHECK_PATH_AT | OPEN_MODE_AT},
-    {__NR_mkdirat,      CHECK_PATH_AT | MUST_CREAT_AT},
-    {__NR_mknodat,      CHECK_PATH_AT | MUST_CREAT_AT},
-    {__NR_fchownat,     CHECK_PATH_AT | IF_AT_SYMLINK_NOFOLLOW4},
-    {__NR_unlinkat,     CHECK_PATH_AT | IF_AT_REMOVEDIR2},
-    {__NR_renameat,     CHECK_PATH_AT | CHECK_PATH_AT2 | CAN_CREAT_AT2 | DONT_RESOLV},
-    {__NR_linkat,       CHECK_PATH_AT | CHECK_PATH_AT2 | MUST_CREAT_AT2 | IF_AT_SYMLINK_FOLLOW4},
-    {__NR_symlinkat,    CHECK_PATH_AT1 | MUST_CREAT_AT1 | DONT_RESOLV},
-    {__NR_fchmodat,     CHECK_PATH_AT | IF_AT_SYMLINK_NOFOLLOW3},
-    {__NR_faccessat,    CHECK_PATH_AT | ACCESS_MODE_AT},
+    [__NR_utimes] =       {CHECK_PATH, 0},
+#endif
+    [__NR_unlink] =       {CHECK_PATH | DONT_RESOLV | CHANGES_PATHS, 0},
+    [__NR_openat] =       {CHECK_PATH_AT | OPEN_MODE_AT, 0},
+    [__NR_mkdirat] =      {CHECK_PATH_AT | MUST_CREAT_AT, 0},
+    [__NR_mknodat] =      {CHECK_PATH_AT | MUST_CREAT_AT, 0},
+    [__NR_fchownat] =     {CHECK_PATH_AT | IF_AT_SYMLINK_NOFOLLOW4, 0},
+    [__NR_unlinkat] =     {CHECK_PATH_AT | IF_AT_REMOVEDIR2 | CHANGES_PATHS, 0},
+    [__NR_renameat] =     {CHECK_PATH_AT | CHECK_PATH_AT2 | CAN_CREAT_AT2 | DONT_RESOLV | CHANGES_PATHS, 0},
+    [__NR_linkat] =       {CHECK_PATH_AT | CHECK_PATH_AT2 | MUST_CREAT_AT2 | IF_AT_SYMLINK_FOLLOW4, 0},
+    [__NR_symlinkat] =    {CHECK_PATH_AT1 | MUST_CREAT_AT1 | DONT_RESOLV | CHANGES_PATHS, 0},
+    [__NR_fchmodat] =     {CHECK_PATH_AT | IF_AT_SYMLINK_NOFOLLOW3, 0},
+    [__NR_faccessat] =    {CHECK_PATH_AT | ACCESS_MODE_AT, 0},
 #if defined(__NR_socketcall)
-    {__NR_socketcall,   DECODE_SOCKETCALL},
+    [__NR_socketcall] =   {DECODE_SOCKETCALL, EXIT_GETSOCKNAME | EXIT_DECODE},
 #endif
 #if defined(__NR_connect)
-    {__NR_connect,      CONNECT_CALL},
+    [__NR_connect] =      {CONNECT_CALL, 0},
 #endif
 #if defined(__NR_bind)
-    {__NR_bind,         BIND_CALL},
+    [__NR_bind] =         {BIND_CALL, 0},
 #endif
 #if defined(__NR_sendto)
-    {__NR_sendto,       SENDTO_CALL},
+    [__NR_sendto] =       {SENDTO_CALL, 0},
+#endif
+    [__NR_execve] =       {EXEC_CALL, 0},
+    /* System calls which are only handled at exit */
+    [__NR_chdir] =        {0, EXIT_CHDIR},
+    [__NR_fchdir] =       {0, EXIT_CHDIR},
+#if defined(__NR_unshare)
+    [__NR_unshare] =      {0, EXIT_UNSHARE},
+#endif
+    [__NR_dup] =          {0, EXIT_DUP},
+    [__NR_dup2] =         {0, EXIT_DUP},
+#if defined(__NR_dup3)
+    [__NR_dup3] =         {0, EXIT_DUP},
+#endif
+    [__NR_fcntl] =        {0, EXIT_FCNTL},
+#if defined(__NR_fcntl64)
+    [__NR_fcntl64] =      {0, EXIT_FCNTL},
+#endif
+#if !defined(__NR_socketcall) && defined(__NR_getsockname)
+    [__NR_getsockname] =  {0, EXIT_GETSOCKNAME},
 #endif
-    {__NR_execve,       EXEC_CALL},
-    {-1,                -1},
+    /* The ptrace backend has exit events instead */
+    [__NR_exit_group] =   {0, EXIT_ADOPT},
 };
 
 #endif // SYDBOX_GUARD_DISPATCH_TABLE_H
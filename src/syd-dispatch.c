@@ -30,79 +30,26 @@
 #include "syd-dispatch.h"
 #include "syd-dispatch-table.h"
 
-static GHashTable *flags = NULL;
+static const struct dispatch_entry dispatch_none = {0, 0};
 
-void dispatch_init(void)
+const struct dispatch_entry *dispatch_lookup(long sno, G_GNUC_UNUSED pink_bitness_t bitness)
 {
-    if (flags == NULL) {
-        flags = g_hash_table_new(g_direct_hash, g_direct_equal);
-        for (unsigned int i = 0; -1 != syscalls[i].no; i++)
-            g_hash_table_insert(flags, GINT_TO_POINTER(syscalls[i].no), GINT_TO_POINTER(syscalls[i].flags));
-    }
-}
-
-void dispatch_free(void)
-{
-    if (flags != NULL) {
-        g_hash_table_destroy(flags);
-        flags = NULL;
-    }
-}
-
-int dispatch_lookup(int sno, G_GNUC_UNUSED pink_bitness_t bitness)
-{
-    gpointer f;
-
-    g_assert(flags != NULL);
-    f = g_hash_table_lookup(flags, GINT_TO_POINTER(sno));
-    return (f == NULL) ? -1 : GPOINTER_TO_INT(f);
-}
-
-inline
-bool dispatch_chdir(int sno, G_GNUC_UNUSED pink_bitness_t bitness)
-{
-    return (__NR_chdir == sno) || (__NR_fchdir == sno);
-}
-
-inline
-bool dispatch_dup(int sno, G_GNUC_UNUSED pink_bitness_t bitness)
-{
-#if defined(__NR_dup3)
-    return (__NR_dup == sno) || (__NR_dup2 == sno) || (__NR_dup3 == sno);
-#else
-    return (__NR_dup == sno) || (__NR_dup2 == sno);
-#endif
+    if (G_UNLIKELY(sno < 0 || sno >= (long)G_N_ELEMENTS(dispatch_table)))
+        return &dispatch_none;
+    return &dispatch_table[sno];
 }
 
-inline
-bool dispatch_fcntl(int sno, G_GNUC_UNUSED pink_bitness_t bitness)
+GArray *dispatch_trace_list(bool need_exit)
 {
-#if defined(__NR_fcntl64)
-    return (__NR_fcntl == sno) || (__NR_fcntl64 == sno);
-#else
-    return (__NR_fcntl == sno);
-#endif
-}
-
-inline
-bool dispatch_maygetsockname(int sno, G_GNUC_UNUSED pink_bitness_t bitness, bool *decode)
-{
-#if defined(__NR_socketcall)
-    if (__NR_socketcall == sno) {
-        if (decode != NULL)
-            *decode = true;
-        return true;
+    int mask;
+    GArray *list;
+
+    /* The seccomp-notify backend only handles EXIT_ADOPT */
+    mask = need_exit ? ~EXIT_ADOPT : EXIT_ADOPT;
+    list = g_array_new(FALSE, FALSE, sizeof(int));
+    for (int i = 0; i < (int)G_N_ELEMENTS(dispatch_table); i++) {
+        if (0 != dispatch_table[i].flags || 0 != (dispatch_table[i].exit & mask))
+            g_array_append_val(list, i);
     }
-    return false;
-#elif defined(__NR_getsockname)
-    if (__NR_getsockname == sno) {
-        if (decode != NULL)
-            *decode = false;
-        return true;
-    }
-    return false;
-#else
-#error wtf? neither socketcall() nor getsockname() defined
-#endif
+    return list;
 }
-
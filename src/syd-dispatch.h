@@ -22,60 +22,31 @@
 
 #include <stdbool.h>
 
+#include <glib.h>
 #include <pinktrace/pink.h>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif // HAVE_CONFIG_H
 
+/* Dispatch flags of a system call, see syd-flags.h */
+struct dispatch_entry
+{
+    int flags;  // Checks done at system call entry, 0 if none
+    int exit;   // EXIT_ flags, post-processing done at system call exit
+};
+
 #if PINKTRACE_BITNESS_COUNT_SUPPORTED == 1
-void dispatch_init(void);
-void dispatch_free(void);
-int dispatch_lookup(int sno, pink_bitness_t bitness);
-bool dispatch_chdir(int sno, pink_bitness_t bitness);
-bool dispatch_dup(int sno, pink_bitness_t bitness);
-bool dispatch_fcntl(int sno, pink_bitness_t bitness);
-bool dispatch_maygetsockname(int sno, pink_bitness_t bitness, bool *decode);
+const struct dispatch_entry *dispatch_lookup(long sno, pink_bitness_t bitness);
+GArray *dispatch_trace_list(bool need_exit);
 #elif PINKTRACE_BITNESS_COUNT_SUPPORTED == 2
-void dispatch_init32(void);
-void dispatch_init64(void);
-void dispatch_free32(void);
-void dispatch_free64(void);
-int dispatch_lookup32(int sno);
-int dispatch_lookup64(int sno);
-const char *dispatch_name32(int sno);
-const char *dispatch_name64(int sno);
-bool dispatch_chdir32(int sno);
-bool dispatch_chdir64(int sno);
-bool dispatch_dup32(int sno);
-bool dispatch_dup64(int sno);
-bool dispatch_fcntl32(int sno);
-bool dispatch_fcntl64(int sno);
-bool dispatch_maygetsockname32(int sno, bool *decode);
-bool dispatch_maygetsockname64(int sno, bool *decode);
+const struct dispatch_entry *dispatch_lookup32(long sno);
+const struct dispatch_entry *dispatch_lookup64(long sno);
+GArray *dispatch_trace_list32(bool need_exit);
+GArray *dispatch_trace_list64(bool need_exit);
 
-#define dispatch_init()     \
-    do {                    \
-        dispatch_init32();  \
-        dispatch_init64();  \
-    } while (0)
-#define dispatch_free()     \
-    do {                    \
-        dispatch_free32();  \
-        dispatch_free64();  \
-    } while (0)
 #define dispatch_lookup(sno, bitness) \
-    ((bitness) == PINK_BITNESS_32) ? dispatch_lookup32((sno)) : dispatch_lookup64((sno))
-#define dispatch_chdir(sno, bitness) \
-    ((bitness) == PINK_BITNESS_32) ? dispatch_chdir32((sno)) : dispatch_chdir64((sno))
-#define dispatch_dup(sno, bitness) \
-    ((bitness) == PINK_BITNESS_32) ? dispatch_dup32((sno)) : dispatch_dup64((sno))
-#define dispatch_fcntl(sno, bitness) \
-    ((bitness) == PINK_BITNESS_32) ? dispatch_fcntl32((sno)) : dispatch_fcntl64((sno))
-#define dispatch_maygetsockname(sno, bitness, decode) \
-    ((bitness) == PINK_BITNESS_32)                    \
-        ? dispatch_maygetsockname32((sno), (decode))  \
-        : dispatch_maygetsockname64((sno), (decode))
+    (((bitness) == PINK_BITNESS_32) ? dispatch_lookup32((sno)) : dispatch_lookup64((sno)))
 
 #else
 #error unsupported bitness count
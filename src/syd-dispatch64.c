@@ -26,68 +26,26 @@
 #include "syd-dispatch.h"
 #include "syd-dispatch-table.h"
 
-static GHashTable *flags64 = NULL;
+static const struct dispatch_entry dispatch_none = {0, 0};
 
-void dispatch_init64(void)
+const struct dispatch_entry *dispatch_lookup64(long sno)
 {
-    if (flags64 == NULL) {
-        flags64 = g_hash_table_new(g_direct_hash, g_direct_equal);
-        for (unsigned int i = 0; -1 != syscalls[i].no; i++)
-            g_hash_table_insert(flags64, GINT_TO_POINTER(syscalls[i].no), GINT_TO_POINTER(syscalls[i].flags));
-    }
+    if (G_UNLIKELY(sno < 0 || sno >= (long)G_N_ELEMENTS(dispatch_table)))
+        return &dispatch_none;
+    return &dispatch_table[sno];
 }
 
-void dispatch_free64(void)
+GArray *dispatch_trace_list64(bool need_exit)
 {
-    if (flags64 != NULL) {
-        g_hash_table_destroy(flags64);
-        flags64 = NULL;
+    int mask;
+    GArray *list;
+
+    /* The seccomp-notify backend only handles EXIT_ADOPT */
+    mask = need_exit ? ~EXIT_ADOPT : EXIT_ADOPT;
+    list = g_array_new(FALSE, FALSE, sizeof(int));
+    for (int i = 0; i < (int)G_N_ELEMENTS(dispatch_table); i++) {
+        if (0 != dispatch_table[i].flags || 0 != (dispatch_table[i].exit & mask))
+            g_array_append_val(list, i);
     }
+    return list;
 }
-
-int dispatch_lookup64(int sno)
-{
-    gpointer f;
-
-    g_assert(flags64 != NULL);
-    f = g_hash_table_lookup(flags64, GINT_TO_POINTER(sno));
-    return (f == NULL) ? -1 : GPOINTER_TO_INT(f);
-}
-
-inline
-bool dispatch_chdir64(int sno)
-{
-    return (__NR_chdir == sno) || (__NR_fchdir == sno);
-}
-
-inline
-bool dispatch_dup64(int sno)
-{
-#if defined(__NR_dup3)
-    return (__NR_dup == sno) || (__NR_dup2 == sno) || (__NR_dup3 == sno);
-#else
-    return (__NR_dup == sno) || (__NR_dup2 == sno);
-#endif
-}
-
-inline
-bool dispatch_fcntl64(int sno)
-{
-#if defined(__NR_fcntl64)
-    return (__NR_fcntl == sno) || (__NR_fcntl64 == sno);
-#else
-    return (__NR_fcntl == sno);
-#endif
-}
-
-inline
-bool dispatch_maygetsockname64(int sno, bool *decode)
-{
-    if (__NR_getsockname == sno) {
-        if (decode != NULL)
-            *decode = false;
-        return true;
-    }
-    return false;
-}
-
@@ -50,6 +50,16 @@
 #define BIND_CALL               (1 << 26) // Check if the bind() call matches the accepted bind IPs
 #define SENDTO_CALL             (1 << 27) // Check if the sendto() call matches the accepted sendto IPs
 #define EXEC_CALL               (1 << 28) // Allowing the system call depends on the exec flag
+#define CHANGES_PATHS           (1 << 29) // The system call may change how paths resolve, flushes the canonicalization cache
+
+// System call post-processing flags, handled at system call exit
+#define EXIT_DUP                (1 << 0)  // The system call may duplicate a file descriptor
+#define EXIT_FCNTL              (1 << 1)  // The system call may duplicate a file descriptor using fcntl()
+#define EXIT_GETSOCKNAME        (1 << 2)  // The system call may be getsockname()
+#define EXIT_DECODE             (1 << 3)  // getsockname() is a socketcall() subcall
+#define EXIT_ADOPT              (1 << 4)  // The process exits, the seccomp-notify backend adopts its children before they're reparented
+#define EXIT_CHDIR              (1 << 5)  // The system call may change the current working directory, which is looked up again after it
+#define EXIT_UNSHARE            (1 << 6)  // The system call may stop sharing the current working directory or the file descriptors
 
 #endif // SYDBOX_GUARD_FLAGS_H
 
@@ -0,0 +1,507 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <fnmatch.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "syd-glob.h"
+#include "syd-log.h"
+
+/* The patterns of a set are compiled into one NFA, every pattern is a chain of
+ * positions ending with an accepting position. A path is matched against all
+ * the patterns in one pass over it, the sets of active positions are turned
+ * into DFA states as they are seen and cached, so matching paths similar to
+ * ones matched before costs one table lookup per character.
+ * Patterns using character classes like [[:alpha:]] and other rarities are left
+ * to fnmatch().
+ */
+
+/* Number of cached DFA states before the cache is flushed */
+#define GLOB_MAX_STATES     1024
+
+enum globtype
+{
+    GLOB_CHAR,      // A literal character
+    GLOB_ANY,       // ? matches any character but /
+    GLOB_STAR,      // * matches any number of characters but /
+    GLOB_CLASS,     // [...] matches the characters in the class but /
+    GLOB_ACCEPT,    // End of a pattern
+};
+
+struct globtok
+{
+    guint8 type;        // One of enum globtype
+    guchar c;           // GLOB_CHAR: the character
+    guint pattern;      // GLOB_ACCEPT: index of the pattern
+    guint32 class[8];   // GLOB_CLASS: bitmap of the characters
+};
+
+struct globstate
+{
+    guint32 *bits;      // Active positions, bits[0] is the number of words following
+    gint accept;        // Index of the first pattern accepting here, -1 if none
+    gint next[256];     // Next state for each character, -1 if not computed yet
+};
+
+struct globset
+{
+    GStaticMutex lock;
+    GPtrArray *patterns;    // Patterns in the order they were added
+    GArray *tokens;         // Compiled patterns, one after the other
+    GArray *starts;         // First position of every compiled pattern
+    GArray *slow;           // Indexes of the patterns left to fnmatch()
+    GPtrArray *states;      // Cached DFA states, the first one is the start state
+    GHashTable *cache;      // bits -> index of the state + 1
+};
+
+static guint glob_hash(gconstpointer key)
+{
+    guint i, h;
+    const guint32 *bits = key;
+
+    for (h = 5381, i = 1; i <= bits[0]; i++)
+        h = h * 33 + bits[i];
+    return h;
+}
+
+static gboolean glob_equal(gconstpointer a, gconstpointer b)
+{
+    const guint32 *abits = a, *bbits = b;
+
+    return (abits[0] == bbits[0] && 0 == memcmp(abits + 1, bbits + 1, abits[0] * sizeof(guint32)));
+}
+
+static inline void glob_class_set(struct globtok *tok, guchar c)
+{
+    tok->class[c / 32] |= 1U << (c % 32);
+}
+
+static inline bool glob_class_has(const struct globtok *tok, guchar c)
+{
+    return (tok->class[c / 32] & (1U << (c % 32)));
+}
+
+/* Parses the bracket expression starting after the [ at *pattern.
+ * Returns 1 and moves *pattern to the closing ] on success, 0 if there is no
+ * closing ] and the [ is a literal character, -1 if the expression uses a
+ * syntax only fnmatch() handles.
+ */
+static int glob_compile_class(const char **pattern, struct globtok *tok)
+{
+    bool negate;
+    guint i;
+    guchar lo, hi;
+    const char *p;
+
+    p = *pattern + 1;
+    negate = ('!' == *p || '^' == *p);
+    if (negate)
+        ++p;
+
+    memset(tok->class, 0, sizeof(tok->class));
+    for (i = 0; ']' != *p || 0 == i; p++, i++) {
+        if ('\0' == *p)
+            return 0;
+        else if ('[' == *p && (':' == p[1] || '=' == p[1] || '.' == p[1]))
+            return -1;
+        else if ('\\' == *p && '\0' == *++p)
+            return 0;
+
+        lo = *p;
+        if ('-' == p[1] && ']' != p[2] && '\0' != p[2]) {
+            if ('\\' == p[2] || '[' == p[2])
+                return -1;
+            hi = p[2];
+            p += 2;
+        }
+        else
+            hi = lo;
+        if ('/' == lo || ('/' > lo && '/' <= hi))
+            return -1; /* A slash in a bracket, fnmatch() has its own rules */
+        for (; lo <= hi && lo != 0; lo++) {
+            glob_class_set(tok, lo);
+            if (255 == lo)
+                break;
+        }
+    }
+
+    if (negate) {
+        for (i = 0; i < 8; i++)
+            tok->class[i] = ~tok->class[i];
+    }
+    tok->class['/' / 32] &= ~(1U << ('/' % 32));
+    tok->class[0] &= ~1U;
+    *pattern = p;
+    return 1;
+}
+
+/* Appends the positions of the pattern to set->tokens.
+ * Returns false if the pattern must be left to fnmatch().
+ */
+static bool glob_compile(struct globset *set, const gchar *pattern, guint index)
+{
+    guint start;
+    const char *p;
+    struct globtok tok;
+
+    start = set->tokens->len;
+    for (p = pattern; '\0' != *p; p++) {
+        memset(&tok, 0, sizeof(struct globtok));
+        switch (*p) {
+            case '*':
+                /* ** is the same as * with FNM_PATHNAME */
+                if (set->tokens->len > start &&
+                        GLOB_STAR == g_array_index(set->tokens, struct globtok, set->tokens->len - 1).type)
+                    continue;
+                tok.type = GLOB_STAR;
+                break;
+            case '?':
+                tok.type = GLOB_ANY;
+                break;
+            case '[':
+                switch (glob_compile_class(&p, &tok)) {
+                    case 1:
+                        tok.type = GLOB_CLASS;
+                        break;
+                    case 0:
+                        tok.type = GLOB_CHAR;
+                        tok.c = '[';
+                        break;
+                    default:
+                        g_array_set_size(set->tokens, start);
+                        return false;
+                }
+                break;
+            case '\\':
+                if ('\0' == p[1]) {
+                    g_array_set_size(set->tokens, start);
+                    return false;
+                }
+                ++p;
+                /* fall through */
+            default:
+                tok.type = GLOB_CHAR;
+                tok.c = *p;
+                break;
+        }
+        g_array_append_val(set->tokens, tok);
+    }
+
+    memset(&tok, 0, sizeof(struct globtok));
+    tok.type = GLOB_ACCEPT;
+    tok.pattern = index;
+    g_array_append_val(set->tokens, tok);
+    g_array_append_val(set->starts, start);
+    return true;
+}
+
+static void glob_state_free(gpointer state_ptr)
+{
+    struct globstate *state = (struct globstate *) state_ptr;
+
+    g_free(state->bits);
+    g_free(state);
+}
+
+/* Drops the cached DFA states, they're built again as paths are matched */
+static void glob_flush(struct globset *set)
+{
+    g_hash_table_remove_all(set->cache);
+    g_ptr_array_foreach(set->states, (GFunc) glob_state_free, NULL);
+    g_ptr_array_set_size(set->states, 0);
+}
+
+static inline guint32 *glob_bits_new(struct globset *set)
+{
+    guint32 *bits;
+    guint nwords;
+
+    nwords = (set->tokens->len + 31) / 32;
+    bits = g_new0(guint32, nwords + 1);
+    bits[0] = nwords;
+    return bits;
+}
+
+/* Activates the position and the positions following it which can be reached
+ * without consuming a character.
+ */
+static inline void glob_closure(const struct globtok *toks, guint32 *bits, guint pos)
+{
+    for (;; pos++) {
+        bits[1 + pos / 32] |= 1U << (pos % 32);
+        if (GLOB_STAR != toks[pos].type)
+            break;
+    }
+}
+
+static guint32 *glob_start(struct globset *set)
+{
+    guint i;
+    guint32 *bits;
+
+    bits = glob_bits_new(set);
+    for (i = 0; i < set->starts->len; i++)
+        glob_closure((struct globtok *)set->tokens->data, bits, g_array_index(set->starts, guint, i));
+    return bits;
+}
+
+static guint32 *glob_step(struct globset *set, const guint32 *from, guchar c)
+{
+    guint w, pos;
+    guint32 word, *bits;
+    const struct globtok *toks, *tok;
+
+    toks = (struct globtok *)set->tokens->data;
+    bits = glob_bits_new(set);
+    for (w = 0; w < from[0]; w++) {
+        for (word = from[w + 1]; 0 != word; word &= word - 1) {
+            pos = w * 32 + __builtin_ctz(word);
+            tok = &toks[pos];
+            switch (tok->type) {
+                case GLOB_CHAR:
+                    if (tok->c == c)
+                        glob_closure(toks, bits, pos + 1);
+                    break;
+                case GLOB_ANY:
+                    if ('/' != c)
+                        glob_closure(toks, bits, pos + 1);
+                    break;
+                case GLOB_STAR:
+                    if ('/' != c)
+                        glob_closure(toks, bits, pos);
+                    break;
+                case GLOB_CLASS:
+                    if (glob_class_has(tok, c))
+                        glob_closure(toks, bits, pos + 1);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    return bits;
+}
+
+static gint glob_accept(struct globset *set, const guint32 *bits)
+{
+    gint accept;
+    guint w, pos;
+    guint32 word;
+    const struct globtok *toks;
+
+    accept = -1;
+    toks = (struct globtok *)set->tokens->data;
+    for (w = 0; w < bits[0]; w++) {
+        for (word = bits[w + 1]; 0 != word; word &= word - 1) {
+            pos = w * 32 + __builtin_ctz(word);
+            if (GLOB_ACCEPT == toks[pos].type && (-1 == accept || (gint)toks[pos].pattern < accept))
+                accept = toks[pos].pattern;
+        }
+    }
+    return accept;
+}
+
+/* Returns the index of the cached state for bits, which are freed or taken
+ * over. Returns -1 and leaves bits alone if the cache is full.
+ */
+static gint glob_intern(struct globset *set, guint32 *bits)
+{
+    gpointer index;
+    struct globstate *state;
+
+    if (NULL != (index = g_hash_table_lookup(set->cache, bits))) {
+        g_free(bits);
+        return GPOINTER_TO_INT(index) - 1;
+    }
+    else if (set->states->len >= GLOB_MAX_STATES)
+        return -1;
+
+    state = g_new(struct globstate, 1);
+    state->bits = bits;
+    state->accept = glob_accept(set, bits);
+    memset(state->next, -1, sizeof(state->next));
+    g_ptr_array_add(set->states, state);
+    g_hash_table_insert(set->cache, bits, GINT_TO_POINTER(set->states->len));
+    return set->states->len - 1;
+}
+
+/* Matches the rest of the path without caching states, used when the cache
+ * fills up in the middle of a path.
+ */
+static gint glob_match_uncached(struct globset *set, guint32 *bits, const char *p)
+{
+    gint accept;
+    guint32 *next;
+
+    for (; '\0' != *p; p++) {
+        next = glob_step(set, bits, *p);
+        g_free(bits);
+        bits = next;
+    }
+    accept = glob_accept(set, bits);
+    g_free(bits);
+    return accept;
+}
+
+static gint glob_match_dfa(struct globset *set, const char *path)
+{
+    gint cur, next;
+    const char *p;
+    guint32 *bits;
+    struct globstate *state;
+
+    if (0 == set->starts->len)
+        return -1;
+    if (0 == set->states->len)
+        glob_intern(set, glob_start(set));
+
+    for (cur = 0, p = path; '\0' != *p; p++, cur = next) {
+        state = g_ptr_array_index(set->states, cur);
+        if (-1 != (next = state->next[(guchar)*p]))
+            continue;
+
+        bits = glob_step(set, state->bits, *p);
+        if (-1 == (next = glob_intern(set, bits))) {
+            g_debug("glob cache is full, flushing %u states", set->states->len);
+            glob_flush(set);
+            return glob_match_uncached(set, bits, p + 1);
+        }
+        state->next[(guchar)*p] = next;
+    }
+    state = g_ptr_array_index(set->states, cur);
+    return state->accept;
+}
+
+struct globset *globset_new(void)
+{
+    struct globset *set;
+
+    set = g_new(struct globset, 1);
+    g_static_mutex_init(&set->lock);
+    set->patterns = g_ptr_array_new();
+    set->tokens = g_array_new(FALSE, FALSE, sizeof(struct globtok));
+    set->starts = g_array_new(FALSE, FALSE, sizeof(guint));
+    set->slow = g_array_new(FALSE, FALSE, sizeof(guint));
+    set->states = g_ptr_array_new();
+    set->cache = g_hash_table_new(glob_hash, glob_equal);
+    return set;
+}
+
+void globset_free(struct globset *set)
+{
+    globset_clear(set);
+    g_ptr_array_free(set->patterns, TRUE);
+    g_array_free(set->tokens, TRUE);
+    g_array_free(set->starts, TRUE);
+    g_array_free(set->slow, TRUE);
+    g_ptr_array_free(set->states, TRUE);
+    g_hash_table_destroy(set->cache);
+    g_static_mutex_free(&set->lock);
+    g_free(set);
+}
+
+/* Adding a pattern compiles only the new pattern, the cached states are built
+ * again lazily.
+ */
+void globset_add(struct globset *set, const gchar *pattern)
+{
+    guint index;
+
+    g_static_mutex_lock(&set->lock);
+    index = set->patterns->len;
+    g_ptr_array_add(set->patterns, g_strdup(pattern));
+    if (!glob_compile(set, pattern, index)) {
+        g_debug("pattern `%s' is left to fnmatch()", pattern);
+        g_array_append_val(set->slow, index);
+    }
+    glob_flush(set);
+    g_static_mutex_unlock(&set->lock);
+}
+
+bool globset_remove(struct globset *set, const gchar *pattern)
+{
+    guint i;
+    gchar *data;
+
+    g_static_mutex_lock(&set->lock);
+    for (i = 0; i < set->patterns->len; i++) {
+        if (0 == strcmp(g_ptr_array_index(set->patterns, i), pattern))
+            break;
+    }
+    if (i == set->patterns->len) {
+        g_static_mutex_unlock(&set->lock);
+        return false;
+    }
+    g_free(g_ptr_array_remove_index(set->patterns, i));
+
+    /* Indexes have changed, compile the remaining patterns again */
+    glob_flush(set);
+    g_array_set_size(set->tokens, 0);
+    g_array_set_size(set->starts, 0);
+    g_array_set_size(set->slow, 0);
+    for (i = 0; i < set->patterns->len; i++) {
+        data = g_ptr_array_index(set->patterns, i);
+        if (!glob_compile(set, data, i))
+            g_array_append_val(set->slow, i);
+    }
+    g_static_mutex_unlock(&set->lock);
+    return true;
+}
+
+void globset_clear(struct globset *set)
+{
+    g_static_mutex_lock(&set->lock);
+    glob_flush(set);
+    g_ptr_array_foreach(set->patterns, (GFunc) g_free, NULL);
+    g_ptr_array_set_size(set->patterns, 0);
+    g_array_set_size(set->tokens, 0);
+    g_array_set_size(set->starts, 0);
+    g_array_set_size(set->slow, 0);
+    g_static_mutex_unlock(&set->lock);
+}
+
+/* Returns the first pattern of the set matching path, NULL if there is none.
+ * The pattern belongs to the set.
+ */
+const gchar *globset_match(struct globset *set, const gchar *path)
+{
+    gint accept;
+    guint i, index;
+
+    g_static_mutex_lock(&set->lock);
+    accept = glob_match_dfa(set, path);
+    for (i = 0; i < set->slow->len; i++) {
+        index = g_array_index(set->slow, guint, i);
+        if (-1 != accept && (gint)index > accept)
+            break;
+        if (0 == fnmatch(g_ptr_array_index(set->patterns, index), path, FNM_PATHNAME)) {
+            accept = index;
+            break;
+        }
+    }
+    g_static_mutex_unlock(&set->lock);
+    return (-1 == accept) ? NULL : g_ptr_array_index(set->patterns, accept);
+}
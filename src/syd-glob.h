@@ -0,0 +1,42 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SYDBOX_GUARD_GLOB_H
+#define SYDBOX_GUARD_GLOB_H 1
+
+#include <stdbool.h>
+
+#include <glib.h>
+
+/* A set of fnmatch(3) patterns matched with FNM_PATHNAME all at once */
+struct globset;
+
+struct globset *globset_new(void);
+
+void globset_free(struct globset *set);
+
+void globset_add(struct globset *set, const gchar *pattern);
+
+bool globset_remove(struct globset *set, const gchar *pattern);
+
+void globset_clear(struct globset *set);
+
+const gchar *globset_match(struct globset *set, const gchar *path);
+
+#endif // SYDBOX_GUARD_GLOB_H
@@ -76,10 +76,12 @@ static inline void sydbox_log_output (const gchar *log_domain, GLogLevelFlags lo
 static void sydbox_log_handler(const gchar *log_domain, GLogLevelFlags log_level,
         const gchar *message, G_GNUC_UNUSED gpointer userdata)
 {
-    if ( ((log_level & G_LOG_LEVEL_MESSAGE)   && sydbox_config_get_verbosity() < 1) ||
-         ((log_level & G_LOG_LEVEL_INFO)      && sydbox_config_get_verbosity() < 2) ||
-         ((log_level & G_LOG_LEVEL_DEBUG)     && sydbox_config_get_verbosity() < 3) ||
-         ((log_level & LOG_LEVEL_DEBUG_TRACE) && sydbox_config_get_verbosity() < 4) )
+    /* The sydbox logging macros check the verbosity before formatting, this
+     * filters messages logged by other means, e.g. by glib. */
+    if ( ((log_level & G_LOG_LEVEL_MESSAGE)   && !sydbox_log_enabled(LOG_VERBOSITY_MESSAGE)) ||
+         ((log_level & G_LOG_LEVEL_INFO)      && !sydbox_log_enabled(LOG_VERBOSITY_INFO)) ||
+         ((log_level & G_LOG_LEVEL_DEBUG)     && !sydbox_log_enabled(LOG_VERBOSITY_DEBUG)) ||
+         ((log_level & LOG_LEVEL_DEBUG_TRACE) && !sydbox_log_enabled(LOG_VERBOSITY_DEBUG_TRACE)) )
         return;
 
     sydbox_log_output(log_domain, log_level, message);
@@ -22,6 +22,8 @@
 
 #include <glib.h>
 
+#include "syd-config.h"
+
 /**
  * LOG_LEVEL_DEBUG_TRACE:
  *
@@ -31,6 +33,41 @@
  **/
 #define LOG_LEVEL_DEBUG_TRACE       (1 << (G_LOG_LEVEL_USER_SHIFT + 0))
 
+// Verbosity needed for a log level to be printed
+#define LOG_VERBOSITY_MESSAGE       1
+#define LOG_VERBOSITY_INFO          2
+#define LOG_VERBOSITY_DEBUG         3
+#define LOG_VERBOSITY_DEBUG_TRACE   4
+
+/**
+ * sydbox_log_enabled:
+ * @verbosity: the verbosity the message needs
+ *
+ * Checks whether a message would be printed, the logging macros below use it
+ * so the arguments aren't evaluated and the message isn't formatted when it
+ * would be dropped anyway.
+ **/
+#define sydbox_log_enabled(verbosity) G_UNLIKELY(sydbox_config_get_verbosity() >= (verbosity))
+
+#define sydbox_log_if(verbosity, level, ...)                \
+    do {                                                    \
+        if (sydbox_log_enabled((verbosity)))                \
+            g_log(G_LOG_DOMAIN, (level), __VA_ARGS__);      \
+    } while (0)
+
+/* Building with --disable-debug-logging compiles debug and trace messages out.
+ * They're still type checked.
+ */
+#if !defined(SYDBOX_DEBUG_LOGGING) || SYDBOX_DEBUG_LOGGING
+#define sydbox_log_debug_if(verbosity, level, ...) sydbox_log_if(verbosity, level, __VA_ARGS__)
+#else
+#define sydbox_log_debug_if(verbosity, level, ...)          \
+    do {                                                    \
+        if (0)                                              \
+            g_log(G_LOG_DOMAIN, (level), __VA_ARGS__);      \
+    } while (0)
+#endif
+
 /**
  * g_info:
  * @varargs: format string, followed by parameters to insert into the format
@@ -40,13 +77,14 @@
  *
  * Since: 0.1_alpha
  **/
-#ifndef g_info
-#define g_info(...)                 g_log(G_LOG_DOMAIN, G_LOG_LEVEL_INFO, __VA_ARGS__)
-#endif
+#undef g_info
+#define g_info(...)         sydbox_log_if(LOG_VERBOSITY_INFO, G_LOG_LEVEL_INFO, __VA_ARGS__)
 
-#ifndef g_debug_trace
-#define g_debug_trace(...)          g_log(G_LOG_DOMAIN, LOG_LEVEL_DEBUG_TRACE, __VA_ARGS__)
-#endif
+#undef g_debug
+#define g_debug(...)        sydbox_log_debug_if(LOG_VERBOSITY_DEBUG, G_LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#undef g_debug_trace
+#define g_debug_trace(...)  sydbox_log_debug_if(LOG_VERBOSITY_DEBUG_TRACE, LOG_LEVEL_DEBUG_TRACE, __VA_ARGS__)
 
 /**
  * sydbox_log_init:
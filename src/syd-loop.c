@@ -24,8 +24,15 @@
 #endif /* HAVE_CONFIG_H */
 
 #include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
@@ -38,12 +45,64 @@
 #include "syd-loop.h"
 #include "syd-pink.h"
 #include "syd-proc.h"
+#include "syd-seccomp.h"
 #include "syd-syscall.h"
+#include "syd-wrappers.h"
+
+/* Maximum number of events handled in one batch */
+#define TRACE_BATCH_MAX     256
+
+/* The statistics are logged this often, in seconds */
+#define TRACE_STATS_INTERVAL 60
+
+/* Number of file descriptors watched by the loop */
+#define TRACE_FD_MAX        2
+
+struct trace_event
+{
+    pid_t pid;
+    int status;
+};
+
+static guint64 trace_batches = 0;
+static guint64 trace_events = 0;
+static guint trace_batch_largest = 0;
+static guint64 trace_wakeups = 0;
+static guint64 trace_detached = 0;
+
+/* Set when the eldest child exits and the others are let go */
+static bool trace_letgo = false;
+
+static int trace_efd = -1;
+static int trace_sfd = -1;
+static int trace_tfd = -1;
+
+/* With the seccomp filter in place the child stops on entry to the system
+ * calls we check, so stopping at every system call is only necessary to get to
+ * the exit of a system call. Quiescent children only stop at events.
+ */
+static inline bool trace_resume(context_t *ctx, struct tchild *child, int sig)
+{
+    if (!(child->flags & TCHILD_INSYSCALL) && (ctx->seccomp || tchild_quiescent(child)))
+        return pink_trace_resume(child->pid, sig);
+    return pink_trace_syscall(child->pid, sig);
+}
+
+/* Quiescent children may be let go altogether unless a seccomp filter would
+ * fail their system calls without a tracer. The eldest child is kept for her
+ * exit status.
+ */
+static inline bool trace_detachable(context_t *ctx, struct tchild *child)
+{
+    return !ctx->seccomp && child->pid != ctx->eldest &&
+        !(child->flags & TCHILD_INSYSCALL) &&
+        sydbox_config_get_detach_quiescent() && tchild_quiescent(child);
+}
 
 // Event handlers
 static int event_setup(context_t *ctx, struct tchild *child)
 {
-    if (!pinkw_trace_setup_all(child->pid)) {
+    if (!pinkw_trace_setup_all(child->pid, ctx->seccomp, ctx->exitkill)) {
         if (G_UNLIKELY(ESRCH != errno)) {
             g_critical("failed to set tracing options: %s", g_strerror(errno));
             g_printerr("failed to set tracing options: %s\n", g_strerror(errno));
@@ -56,9 +115,26 @@ static int event_setup(context_t *ctx, struct tchild *child)
     return 0;
 }
 
+static int event_detach(context_t *ctx, struct tchild *child)
+{
+    g_debug("detaching quiescent child %i", child->pid);
+    if (!pink_trace_detach(child->pid, 0)) {
+        if (G_UNLIKELY(ESRCH != errno)) {
+            g_critical("failed to detach child %i: %s", child->pid, g_strerror(errno));
+            g_printerr("failed to detach child %i: %s\n", child->pid, g_strerror(errno));
+            exit(-1);
+        }
+    }
+    else
+        ++trace_detached;
+    return context_remove_child(ctx, child->pid);
+}
+
 static int event_syscall(context_t *ctx, struct tchild *child)
 {
-    if (!pink_trace_syscall(child->pid, 0)) {
+    if (trace_detachable(ctx, child))
+        return event_detach(ctx, child);
+    if (!trace_resume(ctx, child, 0)) {
         if (G_UNLIKELY(ESRCH != errno)) {
             g_critical("failed to resume child %i: %s", child->pid, g_strerror(errno));
             g_printerr("failed to resume child %i: %s\n", child->pid, g_strerror(errno));
@@ -69,9 +145,29 @@ static int event_syscall(context_t *ctx, struct tchild *child)
     return 0;
 }
 
+static int event_seccomp(context_t *ctx, struct tchild *child)
+{
+    int ret;
+    pid_t pid = child->pid;
+
+    /* Nothing to check, the filter still stops the child */
+    if (tchild_quiescent(child))
+        return event_syscall(ctx, child);
+
+    if (0 != (ret = syscall_handle(ctx, child)))
+        return ret;
+    else if (NULL == (child = tchild_find(ctx->children, pid)))
+        return 0;
+
+    /* Only stop at the exit of the system call if it needs to be handled. */
+    if (!syscall_need_exit(child))
+        child->flags &= ~TCHILD_INSYSCALL;
+    return event_syscall(ctx, child);
+}
+
 static int event_fork(context_t *ctx, struct tchild *child)
 {
-    unsigned long childpid;
+    unsigned long childpid, flags;
     struct tchild *newchild;
 
     // Get new child's pid
@@ -86,30 +182,63 @@ static int event_fork(context_t *ctx, struct tchild *child)
     else
         g_debug("the newborn child's pid is %ld", childpid);
 
+    /* The clone flags tell which state the new child shares with her parent */
+    if (G_UNLIKELY(!pinkw_get_clone_flags(child, &flags))) {
+        if (G_UNLIKELY(ESRCH != errno)) {
+            g_critical("failed to get the clone flags of the newborn child: %s", g_strerror(errno));
+            g_printerr("failed to get the clone flags of the newborn child: %s\n", g_strerror(errno));
+            exit(-1);
+        }
+        return context_remove_child(ctx, child->pid);
+    }
+
     newchild = tchild_find(ctx->children, childpid);
     if (NULL == newchild) {
         /* Child hasn't been born yet, add it to the list of children and
          * inherit parent's sandbox data.
          */
         newchild = tchild_new(ctx->children, childpid, false);
-        tchild_inherit(newchild, child);
+        tchild_inherit(newchild, child, flags);
     }
     else if (newchild->flags & TCHILD_NEEDINHERIT) {
         /* Child has already been born but hasn't inherited parent's sandbox data
          * yet. Inherit parent's sandbox data and resume the child.
          */
         g_debug("prematurely born child %i inherits sandbox data from her parent %i", newchild->pid, child->pid);
-        tchild_inherit(newchild, child);
+        tchild_inherit(newchild, child, flags);
         event_syscall(ctx, newchild);
     }
     return 0;
 }
 
+/* Returns whether the exiting task is a thread group leader none of whose
+ * threads is left.
+ */
+static bool trace_last_task(pid_t pid)
+{
+    bool last;
+    GSList *tasks;
+
+    if (pid != proc_tgid(pid))
+        return false;
+    tasks = proc_tasks(pid);
+    last = (NULL == tasks || (NULL == tasks->next && pid == GPOINTER_TO_INT(tasks->data)));
+    g_slist_free(tasks);
+    return last;
+}
+
 static int event_exit(context_t *ctx, pid_t pid, int *code_ptr)
 {
     int code;
     unsigned long status;
 
+    /* The automatically whitelisted addresses belong to the thread group,
+     * its sockets are closed as its last task exits. Otherwise they're left
+     * to the sweep, which finds the sockets gone.
+     */
+    if (sydbox_config_get_network_auto_whitelist_bind() && trace_last_task(pid))
+        sydbox_config_rmwhitelist_auto(pid);
+
     if (pid != ctx->eldest)
         goto resume;
 
@@ -137,9 +266,7 @@ static int event_exit(context_t *ctx, pid_t pid, int *code_ptr)
         *code_ptr = code;
 
     if (!sydbox_config_get_wait_all()) {
-        g_hash_table_foreach(ctx->children, tchild_resume_one, NULL);
-        g_hash_table_destroy(ctx->children);
-        ctx->children = NULL;
+        trace_letgo = true;
         return -1;
     }
 
@@ -166,7 +293,7 @@ static int event_genuine(context_t * ctx, struct tchild *child, int status)
     g_debug("child %i received genuine signal %d", child->pid, sig);
 #endif /* HAVE_STRSIGNAL */
 
-    if (G_UNLIKELY(!pink_trace_syscall(child->pid, sig))) {
+    if (G_UNLIKELY(!trace_resume(ctx, child, sig))) {
         if (G_UNLIKELY(ESRCH != errno)) {
             g_critical("failed to resume child %i after genuine signal: %s", child->pid, g_strerror(errno));
             g_printerr("failed to resume child %i after genuine signal: %s\n", child->pid, g_strerror(errno));
@@ -188,7 +315,7 @@ static int event_unknown(context_t *ctx, struct tchild *child, int status)
     g_info("unknown signal %#x received from child %i", sig, child->pid);
 #endif /* HAVE_STRSIGNAL */
 
-    if (G_UNLIKELY(!pink_trace_syscall(child->pid, sig))) {
+    if (G_UNLIKELY(!trace_resume(ctx, child, sig))) {
         if (G_UNLIKELY(ESRCH != errno)) {
             g_critical("failed to resume child %i after unknown signal %#x: %s",
                     child->pid, sig, g_strerror(errno));
@@ -202,109 +329,361 @@ static int event_unknown(context_t *ctx, struct tchild *child, int status)
     return 0;
 }
 
-int trace_loop(context_t *ctx)
+/* Handles one event of a batch.
+ * Returns nonzero if tracing is over.
+ */
+static int trace_event(context_t *ctx, pid_t pid, int status, struct tchild *child, int *exit_code)
 {
-    int status, exit_code;
-    pid_t pid;
     pink_event_t event;
-    struct tchild *child;
 
-    exit_code = EXIT_SUCCESS;
-    while (g_hash_table_size(ctx->children) > 0) {
-        pid = waitpid(-1, &status, __WALL);
-        if (G_UNLIKELY(0 > pid)) {
+    if (ctx->seccomp && SYDBOX_STATUS_SECCOMP(status)) {
+        /* pinktrace would report this as a trap */
+        if (0 != event_seccomp(ctx, child))
+            return -1;
+        return 0;
+    }
+    /* Seized children report their first stop, the ones we asked for and group
+     * stops as PTRACE_EVENT_STOP, which pinktrace doesn't know.
+     */
+    event = SYDBOX_STATUS_EVENT_STOP(status) ? PINK_EVENT_STOP : pink_event_decide(status);
+
+    switch(event) {
+        case PINK_EVENT_STOP:
+            g_debug("child %i stopped", pid);
+            if (NULL == child) {
+                /* Child is born before PTRACE_EVENT_FORK.
+                 * Set her up but don't resume her until we receive the
+                 * event.
+                 */
+                g_debug("setting up prematurely born child %i", pid);
+                child = tchild_new(ctx->children, pid, false);
+                if (0 != event_setup(ctx, child))
+                    return -1;
+            }
+            else {
+                g_debug("setting up child %i", child->pid);
+                if (0 != event_setup(ctx, child))
+                    return -1;
+                if (PINK_BITNESS_UNKNOWN == child->bitness) {
+                    /* Attached to a running process */
+                    child->bitness = pink_bitness_get(child->pid);
+                    if (PINK_BITNESS_UNKNOWN == child->bitness) {
+                        g_critical("failed to determine bitness of child %i: %s", child->pid, g_strerror(errno));
+                        g_printerr("failed to determine bitness of child %i: %s\n", child->pid, g_strerror(errno));
+                        exit(-1);
+                    }
+                }
+                if (0 != event_syscall(ctx, child))
+                    return -1;
+            }
+            break;
+        case PINK_EVENT_SYSCALL:
+            if (0 != syscall_handle(ctx, child))
+                return -1;
+            if (0 != event_syscall(ctx, child))
+                return -1;
+            break;
+        case PINK_EVENT_FORK:
+        case PINK_EVENT_VFORK:
+        case PINK_EVENT_CLONE:
+            g_debug("child %i called %s", pid, pink_event_name(event));
+            if (0 != event_fork(ctx, child))
+                return -1;
+            if (0 != event_syscall(ctx, child))
+                return -1;
+            break;
+        case PINK_EVENT_EXEC:
+            g_debug("child %i called execve()", pid);
+            // Check for exec_lock
+            if (G_UNLIKELY(LOCK_PENDING == child->group->sandbox->lock)) {
+                g_info("access to magic commands is now denied for child %i", child->pid);
+                tchild_unshare(child);
+                child->group->sandbox->lock = LOCK_SET;
+            }
+
+            // Update child's bitness
+            child->bitness = pink_bitness_get(child->pid);
+            if (PINK_BITNESS_UNKNOWN == child->bitness) {
+                g_critical("failed to determine bitness of child %i: %s", child->pid, g_strerror(errno));
+                g_printerr("failed to determine bitness of child %i: %s\n", child->pid, g_strerror(errno));
+                exit(-1);
+            }
+            g_debug("updated child %i's bitness to %s mode", child->pid, pink_bitness_name(child->bitness));
+            /* The process gets a file descriptor table of her own */
+            tchild_split(child, CLONE_FILES);
+            if (0 != event_syscall(ctx, child))
+                return -1;
+            break;
+        case PINK_EVENT_EXIT:
+            if (0 != event_exit(ctx, pid, exit_code))
+                return -1;
+            break;
+        case PINK_EVENT_GENUINE:
+        case PINK_EVENT_TRAP:
+            if (0 != event_genuine(ctx, child, status))
+                return -1;
+            break;
+        case PINK_EVENT_UNKNOWN:
+            if (0 != event_unknown(ctx, child, status))
+                return -1;
+            break;
+        case PINK_EVENT_EXIT_GENUINE:
+        case PINK_EVENT_EXIT_SIGNAL:
+            if (NULL != child) {
+                g_warning("dead child %i is still being traced!", child->pid);
+                tchild_delete(ctx->children, child->pid);
+            }
+            break;
+        default:
+            g_assert_not_reached();
+    }
+    return 0;
+}
+
+/* Collects the events of the children which are pending, so tracees stopped at
+ * the same time are handled in one go.
+ * Returns the number of events in batch, -1 if there are no children left.
+ */
+static int trace_wait(struct trace_event *batch)
+{
+    int n, status;
+    pid_t pid;
+
+    n = 0;
+    while (n < TRACE_BATCH_MAX) {
+        pid = waitpid(-1, &status, __WALL | WNOHANG);
+        if (0 == pid)
+            break;
+        else if (G_UNLIKELY(0 > pid)) {
             if (EINTR == errno)
                 continue;
             else if (ECHILD == errno)
-                break;
+                return (0 == n) ? -1 : n;
             else {
                 g_critical("waitpid failed: %s", g_strerror(errno));
                 g_printerr("waitpid failed: %s\n", g_strerror(errno));
                 exit(-1);
             }
         }
-        child = tchild_find(ctx->children, pid);
-        event = pink_event_decide(status);
-
-        switch(event) {
-            case PINK_EVENT_STOP:
-                g_debug("child %i stopped", pid);
-                if (NULL == child) {
-                    /* Child is born before PTRACE_EVENT_FORK.
-                     * Set her up but don't resume her until we receive the
-                     * event.
-                     */
-                    g_debug("setting up prematurely born child %i", pid);
-                    child = tchild_new(ctx->children, pid, false);
-                    if (0 != event_setup(ctx, child))
-                        return exit_code;
-                }
-                else {
-                    g_debug("setting up child %i", child->pid);
-                    if (0 != event_setup(ctx, child))
-                        return exit_code;
-                    if (0 != event_syscall(ctx, child))
-                        return exit_code;
-                }
-                break;
-            case PINK_EVENT_SYSCALL:
-                if (0 != syscall_handle(ctx, child))
-                    return exit_code;
-                if (0 != event_syscall(ctx, child))
-                    return exit_code;
-                break;
-            case PINK_EVENT_FORK:
-            case PINK_EVENT_VFORK:
-            case PINK_EVENT_CLONE:
-                g_debug("child %i called %s", pid, pink_event_name(event));
-                if (0 != event_fork(ctx, child))
-                    return exit_code;
-                if (0 != event_syscall(ctx, child))
-                    return exit_code;
-                break;
-            case PINK_EVENT_EXEC:
-                g_debug("child %i called execve()", pid);
-                // Check for exec_lock
-                if (G_UNLIKELY(LOCK_PENDING == child->sandbox->lock)) {
-                    g_info("access to magic commands is now denied for child %i", child->pid);
-                    child->sandbox->lock = LOCK_SET;
-                }
+        batch[n].pid = pid;
+        batch[n].status = status;
+        ++n;
+    }
+    return n;
+}
 
-                // Update child's bitness
-                child->bitness = pink_bitness_get(child->pid);
-                if (PINK_BITNESS_UNKNOWN == child->bitness) {
-                    g_critical("failed to determine bitness of child %i: %s", child->pid, g_strerror(errno));
-                    g_printerr("failed to determine bitness of child %i: %s\n", child->pid, g_strerror(errno));
-                    exit(-1);
-                }
-                g_debug("updated child %i's bitness to %s mode", child->pid, pink_bitness_name(child->bitness));
-                if (0 != event_syscall(ctx, child))
-                    return exit_code;
-                break;
-            case PINK_EVENT_EXIT:
-                if (0 != event_exit(ctx, pid, &exit_code))
-                    return exit_code;
-                break;
-            case PINK_EVENT_GENUINE:
-            case PINK_EVENT_TRAP:
-                if (0 != event_genuine(ctx, child, status))
-                    return exit_code;
-                break;
-            case PINK_EVENT_UNKNOWN:
-                if (0 != event_unknown(ctx, child, status))
-                    return exit_code;
-                break;
-            case PINK_EVENT_EXIT_GENUINE:
-            case PINK_EVENT_EXIT_SIGNAL:
-                if (NULL != child) {
-                    g_warning("dead child %i is still being traced!", child->pid);
-                    tchild_delete(ctx->children, child->pid);
-                }
+/* The signal a tracee is stopped for, zero unless it's a signal delivery stop */
+static inline int trace_stop_signal(int status)
+{
+    if (0 != (status >> 16) || SIGTRAP == WSTOPSIG(status) || (SIGTRAP | 0x80) == WSTOPSIG(status))
+        return 0;
+    return WSTOPSIG(status);
+}
+
+static void trace_release_one(struct tchild *child, G_GNUC_UNUSED void *userdata)
+{
+    int status;
+    pid_t pid = child->pid;
+
+    if (pink_trace_detach(pid, 0) || ESRCH != errno)
+        return;
+
+    /* Running, she has to stop before she can be detached */
+    if (!pinkw_trace_interrupt(pid))
+        return;
+    for (;;) {
+        if (0 > waitpid(pid, &status, __WALL)) {
+            if (EINTR == errno)
+                continue;
+            break;
+        }
+        else if (!WIFSTOPPED(status))
+            break;
+        else if (pink_trace_detach(pid, trace_stop_signal(status)) || ESRCH != errno)
+            break;
+    }
+}
+
+/* Lets the children go when the eldest child exits and sydbox doesn't wait for
+ * them, they'd be killed with sydbox otherwise. pending are the unhandled
+ * events of the batch, their children are stopped.
+ */
+static void trace_release(context_t *ctx, struct trace_event *pending, int n)
+{
+    int status;
+    pid_t pid;
+
+    childtab_foreach(ctx->children, trace_release_one, NULL);
+    for (int i = 0; i < n; i++) {
+        if (NULL == tchild_find(ctx->children, pending[i].pid) && WIFSTOPPED(pending[i].status))
+            pink_trace_detach(pending[i].pid, trace_stop_signal(pending[i].status));
+    }
+    childtab_free(ctx->children);
+    ctx->children = NULL;
+
+    /* Children born meanwhile are traced as well, they report their first stop
+     * soon enough. The eldest child is reaped here too.
+     */
+    for (;;) {
+        if (0 > (pid = waitpid(-1, &status, __WALL))) {
+            if (EINTR == errno)
+                continue;
+            break;
+        }
+        else if (WIFSTOPPED(status))
+            pink_trace_detach(pid, trace_stop_signal(status));
+    }
+}
+
+void trace_log_stats(void)
+{
+    guint size;
+    guint64 hits, misses, added, dropped;
+
+    canonicalize_cache_stats(&hits, &misses);
+    g_info("canonicalization cache: %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses", hits, misses);
+    g_info("trace loop: %" G_GUINT64_FORMAT " events in %" G_GUINT64_FORMAT " batches, "
+            "%" G_GUINT64_FORMAT " wake-ups, largest batch %u, %" G_GUINT64_FORMAT " detached",
+            trace_events, trace_batches, trace_wakeups, trace_batch_largest, trace_detached);
+    sydbox_config_whitelist_auto_stats(&size, &added, &dropped);
+    g_info("auto whitelist: %u addresses, %" G_GUINT64_FORMAT " added, %" G_GUINT64_FORMAT " dropped",
+            size, added, dropped);
+}
+
+/* SIGCHLD, SIGINT and SIGTERM have been blocked before the eldest child was
+ * forked, they're read from a signal file descriptor so waitpid() is never
+ * interrupted. Another file descriptor to watch, like a control socket, is one
+ * more entry in the epoll set.
+ */
+static void trace_setup(void)
+{
+    sigset_t mask;
+    struct itimerspec interval;
+    struct epoll_event ev;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if (0 > (trace_sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC))) {
+        g_critical("failed to create signal file descriptor: %s", g_strerror(errno));
+        g_printerr("failed to create signal file descriptor: %s\n", g_strerror(errno));
+        exit(-1);
+    }
+
+    if (0 > (trace_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))) {
+        g_critical("failed to create timer file descriptor: %s", g_strerror(errno));
+        g_printerr("failed to create timer file descriptor: %s\n", g_strerror(errno));
+        exit(-1);
+    }
+    memset(&interval, 0, sizeof(struct itimerspec));
+    interval.it_value.tv_sec = TRACE_STATS_INTERVAL;
+    interval.it_interval.tv_sec = TRACE_STATS_INTERVAL;
+    timerfd_settime(trace_tfd, 0, &interval, NULL);
+
+    if (0 > (trace_efd = epoll_create1(EPOLL_CLOEXEC))) {
+        g_critical("failed to create epoll file descriptor: %s", g_strerror(errno));
+        g_printerr("failed to create epoll file descriptor: %s\n", g_strerror(errno));
+        exit(-1);
+    }
+    memset(&ev, 0, sizeof(struct epoll_event));
+    ev.events = EPOLLIN;
+    ev.data.fd = trace_sfd;
+    epoll_ctl(trace_efd, EPOLL_CTL_ADD, trace_sfd, &ev);
+    ev.data.fd = trace_tfd;
+    epoll_ctl(trace_efd, EPOLL_CTL_ADD, trace_tfd, &ev);
+}
+
+static void trace_teardown(void)
+{
+    close(trace_efd);
+    close(trace_tfd);
+    close(trace_sfd);
+    trace_efd = trace_tfd = trace_sfd = -1;
+}
+
+/* Waits timeout milliseconds at most until a child changes state, a signal
+ * arrives or the statistics are due, -1 sleeps until then and 0 only checks.
+ * Automatically whitelisted addresses of closed sockets are dropped along with
+ * the statistics.
+ * Returns the signal that ends tracing, zero otherwise.
+ */
+static int trace_sleep(int timeout)
+{
+    int n, signum;
+    uint64_t expirations;
+    struct epoll_event events[TRACE_FD_MAX];
+    struct signalfd_siginfo info;
+
+    while (0 > (n = epoll_wait(trace_efd, events, TRACE_FD_MAX, timeout))) {
+        if (EINTR != errno) {
+            g_critical("epoll_wait failed: %s", g_strerror(errno));
+            g_printerr("epoll_wait failed: %s\n", g_strerror(errno));
+            exit(-1);
+        }
+    }
+    if (0 > timeout)
+        ++trace_wakeups;
+
+    signum = 0;
+    for (int i = 0; i < n; i++) {
+        if (events[i].data.fd == trace_tfd) {
+            if (sizeof(uint64_t) == read(trace_tfd, &expirations, sizeof(uint64_t))) {
+                sydbox_config_sweep_whitelist_auto();
+                trace_log_stats();
+            }
+        }
+        else if (events[i].data.fd == trace_sfd) {
+            /* SIGCHLD only wakes us up, the children are reaped by the caller */
+            while (sizeof(struct signalfd_siginfo) == read(trace_sfd, &info, sizeof(struct signalfd_siginfo))) {
+                if (SIGCHLD != info.ssi_signo)
+                    signum = info.ssi_signo;
+            }
+        }
+    }
+    return signum;
+}
+
+int trace_loop(context_t *ctx)
+{
+    int n, exit_code;
+    struct tchild *child;
+    struct trace_event batch[TRACE_BATCH_MAX];
+
+    trace_setup();
+
+    exit_code = EXIT_SUCCESS;
+    while (childtab_size(ctx->children) > 0) {
+        if (0 > (n = trace_wait(batch)))
+            break;
+        else if (0 == n) {
+            if (0 != (ctx->signum = trace_sleep(-1)))
                 break;
-            default:
-                g_assert_not_reached();
+            continue;
+        }
+        /* Signals and the statistics aren't put off while events keep
+         * arriving
+         */
+        else if (0 != (ctx->signum = trace_sleep(0)))
+            break;
+        ++trace_batches;
+        trace_events += n;
+        if ((guint)n > trace_batch_largest)
+            trace_batch_largest = n;
+
+        /* The child is looked up as her event is handled, an event earlier in
+         * the batch may have added or removed her.
+         */
+        for (int i = 0; i < n; i++) {
+            child = tchild_find(ctx->children, batch[i].pid);
+            if (0 != trace_event(ctx, batch[i].pid, batch[i].status, child, &exit_code)) {
+                if (trace_letgo)
+                    trace_release(ctx, batch + i + 1, n - i - 1);
+                trace_teardown();
+                return exit_code;
+            }
         }
     }
+    trace_teardown();
     return exit_code;
 }
-
@@ -20,9 +20,16 @@
 #ifndef SYDBOX_GUARD_LOOP_H
 #define SYDBOX_GUARD_LOOP_H 1
 
+#include <glib.h>
+
 #include "syd-context.h"
 
 int trace_loop(context_t *ctx);
 
+/* Logs the statistics of the canonicalization cache, the trace loop and the
+ * automatic whitelist
+ */
+void trace_log_stats(void);
+
 #endif // SYDBOX_GUARD_CONTEXT_H
 
@@ -25,11 +25,17 @@
 #include <grp.h>
 #include <pwd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 
 #include <glib.h>
@@ -37,11 +43,13 @@
 
 #include "syd-children.h"
 #include "syd-config.h"
-#include "syd-dispatch.h"
 #include "syd-log.h"
 #include "syd-loop.h"
+#include "syd-notify.h"
 #include "syd-path.h"
 #include "syd-pink.h"
+#include "syd-proc.h"
+#include "syd-seccomp.h"
 #include "syd-syscall.h"
 #include "syd-utils.h"
 #include "syd-wrappers.h"
@@ -80,6 +88,7 @@ static gint verbosity = -1;
 static gchar *logfile;
 static gchar *config_file;
 static gchar *config_profile;
+static gchar *backend;
 
 static gboolean dump;
 static gboolean disable_sandbox_path;
@@ -91,6 +100,13 @@ static gboolean colour;
 static gboolean version;
 static gboolean nowait;
 static gboolean nowrap_lstat;
+static gboolean noseccomp;
+static gint attach;
+
+/* Signal mask of sydbox before the loop's signals were blocked, the eldest
+ * child starts with it.
+ */
+static sigset_t orig_sigmask;
 
 static GOptionEntry entries[] =
 {
@@ -122,18 +138,28 @@ static GOptionEntry entries[] =
         "Finish tracing when eldest child exits", NULL},
     { "nowrap-lstat",           'W', 0, G_OPTION_ARG_NONE,                         &nowrap_lstat,
         "Disable wrapping of lstat() calls for too long paths", NULL},
+    { "no-seccomp",             'S', 0, G_OPTION_ARG_NONE,                         &noseccomp,
+        "Stop at every system call instead of using a seccomp filter", NULL},
+    { "backend",                'b', 0, G_OPTION_ARG_STRING,                       &backend,
+        "Tracing backend, ptrace or seccomp-notify", NULL},
+    { "attach",                 'a', 0, G_OPTION_ARG_INT,                          &attach,
+        "Attach to a running process and its children instead of executing a command, "
+        "they aren't killed if sydbox dies", "PID"},
     { NULL, -1, 0, 0, NULL, NULL, NULL },
 };
 
 // Cleanup functions
 static void cleanup(void)
 {
-    dispatch_free();
+    trace_log_stats();
+    canonicalize_cache_flush();
+
     sydbox_config_rmfilter_all();
     sydbox_config_rmwhitelist_all();
     if (NULL != ctx) {
-        if (NULL != ctx->children)
-            g_hash_table_foreach(ctx->children, tchild_kill_one, NULL);
+        /* Tracees that aren't killed are detached when sydbox exits */
+        if (NULL != ctx->children && ctx->exitkill)
+            childtab_foreach(ctx->children, tchild_kill_one, NULL);
         context_free(ctx);
         ctx = NULL;
     }
@@ -142,12 +168,17 @@ static void cleanup(void)
 
 static void sig_cleanup(int signum)
 {
+    sigset_t mask;
     struct sigaction action;
     g_fprintf(stderr, "Caught signal %d, exiting\n", signum);
     cleanup();
     sigaction(signum, NULL, &action);
     action.sa_handler = SIG_DFL;
     sigaction(signum, &action, NULL);
+    /* The signals read by the loops are blocked */
+    sigemptyset(&mask);
+    sigaddset(&mask, signum);
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
     raise(signum);
 }
 
@@ -176,11 +207,27 @@ static gchar *get_groupname (void)
 }
 
 G_GNUC_NORETURN
-static void sydbox_execute_child(G_GNUC_UNUSED int argc, char **argv)
+static void sydbox_execute_child(G_GNUC_UNUSED int argc, char **argv, int fd)
 {
-    if (!pink_trace_me()) {
-        g_printerr("failed to set tracing: %s\n", g_strerror(errno));
-        _exit(-1);
+    char dummy;
+    ssize_t n;
+
+    sigprocmask(SIG_SETMASK, &orig_sigmask, NULL);
+
+    /* Wait until the parent has seized us with the tracing options set, the
+     * pipe is closed without a byte written if she failed to.
+     */
+    while (1 != (n = read(fd, &dummy, 1))) {
+        if (0 == n || EINTR != errno)
+            _exit(-1);
+    }
+    close(fd);
+
+    if (ctx->seccomp) {
+        if (0 > seccomp_apply()) {
+            g_printerr("failed to install seccomp filter: %s\n", g_strerror(errno));
+            _exit(-1);
+        }
     }
 
     if (strncmp(argv[0], "/bin/sh", 8) == 0)
@@ -192,11 +239,45 @@ static void sydbox_execute_child(G_GNUC_UNUSED int argc, char **argv)
     _exit(-1);
 }
 
-static int sydbox_execute_parent(int argc, char **argv, pid_t pid)
+/* Lets the eldest child run until execvp() succeeds, the initial exec isn't
+ * checked.
+ */
+static void sydbox_wait_exec(pid_t pid)
+{
+    int sig, status;
+
+    for (;;) {
+        while (0 > waitpid(pid, &status, __WALL)) {
+            if (EINTR != errno) {
+                g_critical("waitpid failed: %s", g_strerror(errno));
+                g_printerr("waitpid failed: %s\n", g_strerror(errno));
+                exit(-1);
+            }
+        }
+        if (WIFEXITED(status))
+            exit(WEXITSTATUS(status));
+        else if (WIFSIGNALED(status))
+            exit(128 + WTERMSIG(status));
+        else if (PINK_EVENT_EXEC == pink_event_decide(status))
+            break;
+
+        sig = (SIGTRAP == WSTOPSIG(status) || SYDBOX_STATUS_EVENT_STOP(status)) ? 0 : WSTOPSIG(status);
+        if (!pink_trace_resume(pid, sig)) {
+            pink_trace_kill(pid);
+            g_critical("failed to resume eldest child %i: %s", pid, g_strerror(errno));
+            g_printerr("failed to resume eldest child %i: %s\n", pid, g_strerror(errno));
+            exit(-1);
+        }
+    }
+}
+
+/* The loops read SIGCHLD, SIGINT and SIGTERM from a signal file descriptor,
+ * only the synchronous signals get a handler.
+ */
+static void sydbox_setup_signals(void)
 {
-    int status, retval;
+    sigset_t mask;
     struct sigaction new_action, old_action;
-    struct tchild *eldest;
 
     new_action.sa_handler = sig_cleanup;
     sigemptyset(&new_action.sa_mask);
@@ -211,8 +292,6 @@ static int sydbox_execute_parent(int argc, char **argv, pid_t pid)
 
     HANDLE_SIGNAL(SIGABRT);
     HANDLE_SIGNAL(SIGSEGV);
-    HANDLE_SIGNAL(SIGINT);
-    HANDLE_SIGNAL(SIGTERM);
 
     /* Make sure SIGCHLD has the default handler */
     new_action.sa_handler = SIG_DFL;
@@ -220,61 +299,91 @@ static int sydbox_execute_parent(int argc, char **argv, pid_t pid)
 
 #undef HANDLE_SIGNAL
 
-    /* wait for SIGTRAP */
-    wait(&status);
-    if (WIFEXITED(status)) {
-        g_critical("wtf? child died before sending SIGTRAP");
-        g_printerr("wtf? child died before sending SIGTRAP\n");
-        exit(WEXITSTATUS(status));
-    }
-    g_assert(WIFSTOPPED(status));
-    g_assert(WSTOPSIG(status) == SIGTRAP);
+    /* Block them before the eldest child is forked, the worker threads of the
+     * seccomp-notify backend inherit the mask.
+     */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, &orig_sigmask);
+}
 
-    if (!pinkw_trace_setup_all(pid)) {
-        g_critical("failed to setup tracing options: %s", g_strerror(errno));
-        g_printerr("failed to setup tracing options: %s\n", g_strerror(errno));
-        exit(-1);
-    }
+/* Creates the eldest child and sets up her sandbox data from the configuration */
+static struct tchild *sydbox_eldest_new(int argc, char **argv, pid_t pid)
+{
+    int i;
+    const char *sep;
+    GString *lastexec;
+    struct tchild *eldest;
 
     ctx->eldest = pid;
     eldest = tchild_new(ctx->children, pid, true);
-    eldest->bitness = pink_bitness_get(pid);
-    if (PINK_BITNESS_UNKNOWN == eldest->bitness) {
-        g_critical("failed to determine bitness of the eldest child %i: %s", eldest->pid, g_strerror(errno));
-        g_printerr("failed to determine bitness of the eldest child %i: %s\n", eldest->pid, g_strerror(errno));
-        exit(-1);
-    }
-    g_debug("eldest child %i runs in %s mode", eldest->pid, pink_bitness_name(eldest->bitness));
-    eldest->sandbox->path = sydbox_config_get_sandbox_path();
-    eldest->sandbox->exec = sydbox_config_get_sandbox_exec();
-    eldest->sandbox->network = sydbox_config_get_sandbox_network();
-    eldest->sandbox->lock = sydbox_config_get_disallow_magic_commands() ? LOCK_SET : LOCK_UNSET;
+    eldest->group->sandbox->path = sydbox_config_get_sandbox_path();
+    eldest->group->sandbox->exec = sydbox_config_get_sandbox_exec();
+    eldest->group->sandbox->network = sydbox_config_get_sandbox_network();
+    eldest->group->sandbox->lock = sydbox_config_get_disallow_magic_commands() ? LOCK_SET : LOCK_UNSET;
 
-    eldest->sandbox->write_prefixes = sydbox_config_get_write_prefixes();
+    pathlist_copy(&(eldest->group->sandbox->write_prefixes), sydbox_config_get_write_prefixes());
     if (sydbox_config_get_allow_proc_pid()) {
         gchar *proc_pid = g_strdup_printf("/proc/%i", pid);
-        pathnode_new(&(eldest->sandbox->write_prefixes), proc_pid, false);
+        pathnode_new(&(eldest->group->sandbox->write_prefixes), proc_pid, false);
         g_free(proc_pid);
     }
-    eldest->sandbox->exec_prefixes = sydbox_config_get_exec_prefixes();
+    pathlist_copy(&(eldest->group->sandbox->exec_prefixes), sydbox_config_get_exec_prefixes());
 
-    eldest->cwd = egetcwd();
-    if (NULL == eldest->cwd) {
+    eldest->fs->cwd = proc_getcwd(pid);
+    if (NULL == eldest->fs->cwd) {
         g_critical("failed to get current working directory: %s", g_strerror(errno));
         g_printerr("failed to get current working directory: %s\n", g_strerror(errno));
         exit(-1);
     }
 
     /* Construct the lastexec string for the initial exec */
-    int i;
-    const char *sep;
-    g_string_printf(eldest->lastexec, "execvp(\"%s\", [", argv[0]);
+    lastexec = tchild_lastexec(eldest);
+    g_string_printf(lastexec, "execvp(\"%s\", [", argv[0]);
     for (sep = "", i = 0; i < argc; sep = ", ", i++)
-        g_string_append_printf(eldest->lastexec, "%s\"%s\"", sep, argv[i]);
-    g_string_append(eldest->lastexec, "])");
+        g_string_append_printf(lastexec, "%s\"%s\"", sep, argv[i]);
+    g_string_append(lastexec, "])");
+
+    return eldest;
+}
+
+static int sydbox_execute_parent(int argc, char **argv, pid_t pid, int fd)
+{
+    int retval;
+    struct tchild *eldest;
+
+    /* The options are in place before the child installs the seccomp filter,
+     * the filtered system calls would fail with ENOSYS otherwise.
+     */
+    if (!pinkw_trace_seize(pid, ctx->seccomp, ctx->exitkill)) {
+        kill(pid, SIGKILL);
+        g_critical("failed to seize the eldest child %i: %s", pid, g_strerror(errno));
+        g_printerr("failed to seize the eldest child %i: %s\n", pid, g_strerror(errno));
+        exit(-1);
+    }
+    if (1 != write(fd, "", 1)) {
+        kill(pid, SIGKILL);
+        g_critical("failed to wake up the eldest child %i: %s", pid, g_strerror(errno));
+        g_printerr("failed to wake up the eldest child %i: %s\n", pid, g_strerror(errno));
+        exit(-1);
+    }
+    close(fd);
+
+    sydbox_wait_exec(pid);
+
+    eldest = sydbox_eldest_new(argc, argv, pid);
+    eldest->bitness = pink_bitness_get(pid);
+    if (PINK_BITNESS_UNKNOWN == eldest->bitness) {
+        g_critical("failed to determine bitness of the eldest child %i: %s", eldest->pid, g_strerror(errno));
+        g_printerr("failed to determine bitness of the eldest child %i: %s\n", eldest->pid, g_strerror(errno));
+        exit(-1);
+    }
+    g_debug("eldest child %i runs in %s mode", eldest->pid, pink_bitness_name(eldest->bitness));
 
     g_info ("child %i is ready to go, resuming", pid);
-    if (!pink_trace_syscall(pid, 0)) {
+    if (!(ctx->seccomp ? pink_trace_resume(pid, 0) : pink_trace_syscall(pid, 0))) {
         pink_trace_kill(pid);
         g_critical("failed to resume eldest child %i: %s", pid, g_strerror(errno));
         g_printerr("failed to resume eldest child %i: %s\n", pid, g_strerror(errno));
@@ -285,14 +394,287 @@ static int sydbox_execute_parent(int argc, char **argv, pid_t pid)
     retval = trace_loop(ctx);
     g_info("exited loop with return value: %d", retval);
 
+    if (0 != ctx->signum)
+        sig_cleanup(ctx->signum);
+
+    return retval;
+}
+
+/* Seizes one task, a thread joins the thread group of parent.
+ * Returns NULL if the task couldn't be seized.
+ */
+static struct tchild *sydbox_seize_task(pid_t tid, struct tchild *parent, bool thread)
+{
+    struct tchild *child;
+
+    if (!pinkw_trace_seize(tid, false, ctx->exitkill)) {
+        /* Gone already or attached by the kernel as a new child */
+        g_info("failed to attach to %i: %s", tid, g_strerror(errno));
+        return NULL;
+    }
+    pinkw_trace_interrupt(tid);
+
+    /* Set up when the interruption is reported */
+    child = tchild_new(ctx->children, tid, false);
+    /* The threads of a running process are taken to share what pthreads
+     * share, the clone flags are long gone.
+     */
+    tchild_inherit(child, parent, thread ? CLONE_THREAD | CLONE_FS | CLONE_FILES : 0);
+    child->bitness = PINK_BITNESS_UNKNOWN;
+    if (!thread) {
+        g_free(child->fs->cwd);
+        child->fs->cwd = NULL;
+    }
+    return child;
+}
+
+/* Seizes the thread group leader, then the other threads of the process until
+ * no new thread shows up, then the processes they've forked. Whatever is
+ * forked after its parent was seized is attached by the kernel.
+ */
+static void sydbox_seize_tree(pid_t pid, struct tchild *eldest)
+{
+    bool found;
+    pid_t tid;
+    GSList *tasks, *children, *walk;
+    struct tchild *leader;
+
+    leader = tchild_find(ctx->children, pid);
+    if (NULL == leader && NULL == (leader = sydbox_seize_task(pid, eldest, false)))
+        return;
+
+    for (;;) {
+        found = false;
+        tasks = proc_tasks(pid);
+        for (walk = tasks; NULL != walk; walk = g_slist_next(walk)) {
+            tid = GPOINTER_TO_INT(walk->data);
+            if (NULL != tchild_find(ctx->children, tid))
+                continue;
+            else if (NULL != sydbox_seize_task(tid, leader, true))
+                found = true;
+        }
+        if (!found)
+            break;
+        g_slist_free(tasks);
+    }
+
+    g_slist_free(tasks);
+
+    children = proc_children(pid);
+    for (walk = children; NULL != walk; walk = g_slist_next(walk))
+        sydbox_seize_tree(GPOINTER_TO_INT(walk->data), eldest);
+    g_slist_free(children);
+}
+
+/* Attaches to a running process and everything it has forked instead of
+ * executing a command. A seccomp filter can't be installed into a running
+ * process, so the children are stopped at every system call.
+ */
+static int sydbox_execute_attach(pid_t pid)
+{
+    int retval;
+    gchar **argv;
+    struct tchild *eldest;
+
+    argv = proc_cmdline(pid);
+    if (NULL == argv || NULL == argv[0]) {
+        g_printerr("failed to attach to process %i: %s\n", pid, g_strerror((NULL == argv) ? errno : ESRCH));
+        g_strfreev(argv);
+        return EXIT_FAILURE;
+    }
+
+    /* The processes were running before sydbox, they outlive it */
+    ctx->seccomp = false;
+    ctx->exitkill = false;
+    sydbox_setup_signals();
+
+    if (!pinkw_trace_seize(pid, false, ctx->exitkill)) {
+        g_printerr("failed to attach to process %i: %s\n", pid, g_strerror(errno));
+        g_strfreev(argv);
+        return EXIT_FAILURE;
+    }
+    pinkw_trace_interrupt(pid);
+
+    /* The eldest child is set up in the loop like the others, when she reports
+     * the interruption.
+     */
+    eldest = sydbox_eldest_new(g_strv_length(argv), argv, pid);
+    eldest->bitness = PINK_BITNESS_UNKNOWN;
+    g_strfreev(argv);
+    sydbox_seize_tree(pid, eldest);
+
+    g_info("entering loop");
+    retval = trace_loop(ctx);
+    g_info("exited loop with return value: %d", retval);
+
+    if (0 != ctx->signum)
+        sig_cleanup(ctx->signum);
+
+    return retval;
+}
+
+/* Passes the seccomp listener of the eldest child to sydbox */
+static int sydbox_send_fd(int sock, int fd)
+{
+    char dummy = 0;
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+    memset(&msg, 0, sizeof(struct msghdr));
+    memset(buf, 0, sizeof(buf));
+    iov.iov_base = &dummy;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = buf;
+    msg.msg_controllen = sizeof(buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+#if defined(__NR_socketcall) && defined(__NR_sendmsg)
+    /* socketcall() is filtered and nobody would answer the notification yet */
+    return syscall(__NR_sendmsg, sock, &msg, 0);
+#else
+    return sendmsg(sock, &msg, 0);
+#endif
+}
+
+static int sydbox_recv_fd(int sock)
+{
+    int fd;
+    char dummy;
+    char buf[CMSG_SPACE(sizeof(int))];
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+    memset(&msg, 0, sizeof(struct msghdr));
+    iov.iov_base = &dummy;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = buf;
+    msg.msg_controllen = sizeof(buf);
+    while (0 > recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) {
+        if (EINTR != errno)
+            return -1;
+    }
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (NULL == cmsg || SCM_RIGHTS != cmsg->cmsg_type) {
+        errno = EBADMSG;
+        return -1;
+    }
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+G_GNUC_NORETURN
+static void sydbox_execute_child_notify(char **argv, const gchar *path, int sock)
+{
+    int fd;
+
+    if (0 > (fd = seccomp_notify_apply())) {
+        g_printerr("failed to install seccomp listener: %s\n", g_strerror(errno));
+        _exit(-1);
+    }
+    if (0 > sydbox_send_fd(sock, fd)) {
+        g_printerr("failed to send seccomp listener: %s\n", g_strerror(errno));
+        _exit(-1);
+    }
+    close(fd);
+    close(sock);
+
+    if (strncmp(argv[0], "/bin/sh", 8) == 0)
+        g_fprintf(stderr, ANSI_DARK_MAGENTA PINK_FLOYD ANSI_NORMAL);
+
+    /* The listener is ours now, this execv() is let through unchecked */
+    execv(path, argv);
+
+    g_printerr("execv() failed: %s\n", g_strerror(errno));
+    _exit(-1);
+}
+
+/* Runs the command with the seccomp-notify backend.
+ * Nothing is traced, the eldest child installs a filter that reports the
+ * system calls sydbox checks to a listener and passes the listener to sydbox.
+ */
+static int sydbox_execute_notify(int argc, char **argv)
+{
+    int fd, retval;
+    int sv[2];
+    pid_t pid;
+    gchar *path;
+    struct tchild *eldest;
+
+    /* Resolve the command before the filter is installed */
+    if (NULL == (path = g_find_program_in_path(argv[0]))) {
+        g_printerr("failed to find command `%s'\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (0 > socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv)) {
+        g_printerr("failed to create socket pair: %s\n", g_strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    /* Orphaned children are reparented to sydbox, so waitpid() tells when
+     * they're all gone.
+     */
+    if (0 > prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0))
+        g_info("failed to become a subreaper: %s", g_strerror(errno));
+
+    sydbox_setup_signals();
+
+    if ((pid = fork()) < 0) {
+        g_printerr("failed to fork: %s\n", g_strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (0 == pid) {
+        close(sv[0]);
+        sigprocmask(SIG_SETMASK, &orig_sigmask, NULL);
+        sydbox_execute_child_notify(argv, path, sv[1]);
+    }
+
+    g_free(path);
+    close(sv[1]);
+    fd = sydbox_recv_fd(sv[0]);
+    close(sv[0]);
+    if (0 > fd) {
+        g_critical("failed to receive seccomp listener: %s", g_strerror(errno));
+        g_printerr("failed to receive seccomp listener: %s\n", g_strerror(errno));
+        kill(pid, SIGKILL);
+        exit(-1);
+    }
+
+    eldest = sydbox_eldest_new(argc, argv, pid);
+    eldest->flags |= TCHILD_UNTRACED;
+
+    g_info("entering loop");
+    retval = notify_loop(ctx, fd);
+    g_info("exited loop with return value: %d", retval);
+
+    if (0 != ctx->signum)
+        sig_cleanup(ctx->signum);
+
+    /* Remaining children aren't traced, let them run */
+    childtab_free(ctx->children);
+    ctx->children = NULL;
+    notify_release(fd);
+
     return retval;
 }
 
 static int sydbox_internal_main(int argc, char **argv)
 {
+    int pfd[2];
     pid_t pid;
 
-    dispatch_init();
     ctx = context_new();
 
     atexit(cleanup);
@@ -357,11 +739,34 @@ static int sydbox_internal_main(int argc, char **argv)
     else if (g_getenv(ENV_NOWRAP_LSTAT))
         sydbox_config_set_wrap_lstat(false);
 
+    if (noseccomp)
+        sydbox_config_set_seccomp(false);
+    else if (g_getenv(ENV_NO_SECCOMP))
+        sydbox_config_set_seccomp(false);
+
+    if (backend || g_getenv(ENV_BACKEND)) {
+        const gchar *name = backend ? backend : g_getenv(ENV_BACKEND);
+        int b = sydbox_config_backend_from_string(name);
+        if (0 > b) {
+            g_printerr("invalid backend `%s', expected ptrace or seccomp-notify\n", name);
+            return EXIT_FAILURE;
+        }
+        sydbox_config_set_backend(b);
+    }
+
     if (dump) {
         sydbox_config_write_to_stderr();
         return EXIT_SUCCESS;
     }
 
+    if (0 < attach) {
+        if (BACKEND_PTRACE != sydbox_config_get_backend()) {
+            g_printerr("attaching requires the ptrace backend\n");
+            return EXIT_FAILURE;
+        }
+        return sydbox_execute_attach(attach);
+    }
+
     if (sydbox_config_get_verbosity() > 1) {
         gchar *username = NULL, *groupname = NULL;
         GString *command = NULL;
@@ -395,15 +800,40 @@ static int sydbox_internal_main(int argc, char **argv)
     g_setenv("SYDBOX_VERSION", VERSION, 1);
     g_setenv("SYDBOX_GITHEAD", GIT_HEAD, 1);
 
-    if ((pid = vfork()) < 0) {
+    if (BACKEND_SECCOMP_NOTIFY == sydbox_config_get_backend()) {
+        if (!seccomp_notify_supported()) {
+            g_printerr("seccomp-notify backend isn't available\n");
+            return EXIT_FAILURE;
+        }
+        return sydbox_execute_notify(argc, argv);
+    }
+
+    if (sydbox_config_get_seccomp()) {
+        ctx->seccomp = seccomp_supported();
+        if (!ctx->seccomp)
+            g_info("seccomp filter unavailable, stopping at every system call");
+    }
+
+    sydbox_setup_signals();
+
+    /* The child waits to be seized, which would block a vfork()'ed parent
+     * forever.
+     */
+    if (0 > pipe2(pfd, O_CLOEXEC)) {
+        g_printerr("failed to create pipe: %s\n", g_strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if ((pid = fork()) < 0) {
         g_printerr("failed to fork: %s\n", g_strerror(errno));
         return EXIT_FAILURE;
     }
 
-    if (pid == 0)
-        sydbox_execute_child(argc, argv);
-    else
-        return sydbox_execute_parent(argc, argv, pid);
+    if (pid == 0) {
+        close(pfd[1]);
+        sydbox_execute_child(argc, argv, pfd[0]);
+    }
+    close(pfd[0]);
+    return sydbox_execute_parent(argc, argv, pid, pfd[1]);
 }
 
 int main(int argc, char **argv)
@@ -411,6 +841,9 @@ int main(int argc, char **argv)
     GError *parse_error = NULL;
     GOptionContext *context;
 
+    if (!g_thread_supported())
+        g_thread_init(NULL);
+
     context = g_option_context_new("-- command [args]");
     g_option_context_add_main_entries(context, entries, PACKAGE);
     g_option_context_set_summary(context, PACKAGE "-" VERSION GIT_HEAD " - ptrace based sandbox");
@@ -437,7 +870,11 @@ int main(int argc, char **argv)
             argv++;
         }
 
-        if (!argv[0]) {
+        if (0 < attach && argv[0]) {
+            g_printerr("fatal: no command may be given with --attach\n");
+            return EXIT_FAILURE;
+        }
+        else if (0 >= attach && !argv[0]) {
             g_printerr("fatal: no command given\n");
             return EXIT_FAILURE;
         }
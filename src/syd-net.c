@@ -25,6 +25,7 @@
 
 #include <limits.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <fnmatch.h>
@@ -39,12 +40,78 @@
 #include "syd-log.h"
 #include "syd-net.h"
 
+/* Interned UNIX socket paths, equal paths are the same string so they're
+ * compared by pointer. A path is freed when the last address using it is.
+ */
+struct addrpath
+{
+    guint refcount;
+    char path[];
+};
+
+static GStaticMutex address_paths_mutex = G_STATIC_MUTEX_INIT;
+static GHashTable *address_paths = NULL;
+
+static const char *address_path_ref(const char *path)
+{
+    size_t len;
+    struct addrpath *entry;
+
+    if (NULL == path)
+        return NULL;
+
+    g_static_mutex_lock(&address_paths_mutex);
+    if (NULL == address_paths)
+        address_paths = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    entry = g_hash_table_lookup(address_paths, path);
+    if (NULL == entry) {
+        len = strlen(path) + 1;
+        entry = g_malloc(sizeof(struct addrpath) + len);
+        entry->refcount = 0;
+        memcpy(entry->path, path, len);
+        g_hash_table_insert(address_paths, entry->path, entry);
+    }
+    ++entry->refcount;
+    g_static_mutex_unlock(&address_paths_mutex);
+    return entry->path;
+}
+
+static void address_path_unref(const char *path)
+{
+    struct addrpath *entry;
+
+    if (NULL == path)
+        return;
+
+    entry = (struct addrpath *)(path - offsetof(struct addrpath, path));
+    g_static_mutex_lock(&address_paths_mutex);
+    if (0 == --entry->refcount)
+        g_hash_table_remove(address_paths, entry->path);
+    g_static_mutex_unlock(&address_paths_mutex);
+}
+
+void address_set_path(struct sydbox_addr *addr, const char *path)
+{
+    const char *old = addr->u.saun.sun_path;
+
+    addr->u.saun.sun_path = address_path_ref(path);
+    address_path_unref(old);
+}
+
+void address_set_rpath(struct sydbox_addr *addr, const char *rpath)
+{
+    const char *old = addr->u.saun.rsun_path;
+
+    addr->u.saun.rsun_path = address_path_ref(rpath);
+    address_path_unref(old);
+}
+
 void address_free(struct sydbox_addr *addr)
 {
-    if (addr != NULL &&
-            addr->family == AF_UNIX &&
-            !addr->u.saun.abstract)
-        g_free(addr->u.saun.rsun_path);
+    if (addr != NULL && addr->family == AF_UNIX) {
+        address_path_unref(addr->u.saun.sun_path);
+        address_path_unref(addr->u.saun.rsun_path);
+    }
     g_free(addr);
 }
 
@@ -57,7 +124,7 @@ bool address_cmp(const struct sydbox_addr *addr1, const struct sydbox_addr *addr
         case AF_UNIX:
             if (addr1->u.saun.abstract != addr2->u.saun.abstract)
                 return false;
-            return (0 == strncmp(addr1->u.saun.sun_path, addr2->u.saun.sun_path, PATH_MAX));
+            return (addr1->u.saun.sun_path == addr2->u.saun.sun_path);
         case AF_INET:
             if (addr1->u.sa.netmask != addr2->u.sa.netmask)
                 return false;
@@ -90,32 +157,11 @@ struct sydbox_addr *address_dup(const struct sydbox_addr *src)
         return NULL;
     }
 
-    dest = g_new0(struct sydbox_addr, 1);
-
-    dest->family = src->family;
-    switch (src->family) {
-        case AF_UNIX:
-            dest->u.saun.abstract = src->u.saun.abstract;
-            dest->u.saun.exact = src->u.saun.exact;
-            strncpy(dest->u.saun.sun_path, src->u.saun.sun_path, PATH_MAX);
-            dest->u.saun.rsun_path = g_strdup(src->u.saun.rsun_path);
-            break;
-        case AF_INET:
-            dest->u.sa.netmask = src->u.sa.netmask;
-            dest->u.sa.port[0] = src->u.sa.port[0];
-            dest->u.sa.port[1] = src->u.sa.port[1];
-            memcpy(&dest->u.sa.sin_addr, &src->u.sa.sin_addr, sizeof(struct in_addr));
-            break;
-#if SYDBOX_HAVE_IPV6
-        case AF_INET6:
-            dest->u.sa6.netmask = src->u.sa6.netmask;
-            dest->u.sa6.port[0] = src->u.sa6.port[0];
-            dest->u.sa6.port[1] = src->u.sa6.port[1];
-            memcpy(&dest->u.sa6.sin6_addr, &src->u.sa6.sin6_addr, sizeof(struct in6_addr));
-            break;
-#endif /* SYDBOX_HAVE_IPV6 */
-        default:
-            g_assert_not_reached();
+    dest = g_new(struct sydbox_addr, 1);
+    memcpy(dest, src, sizeof(struct sydbox_addr));
+    if (AF_UNIX == src->family) {
+        address_path_ref(src->u.saun.sun_path);
+        address_path_ref(src->u.saun.rsun_path);
     }
     return dest;
 }
@@ -124,7 +170,7 @@ bool address_has(struct sydbox_addr *haystack, struct sydbox_addr *needle)
 {
     int n, mask;
     unsigned char *b, *ptr;
-    char *hsun_path, *nsun_path;
+    const char *hsun_path, *nsun_path;
     char *haystack_str, *needle_str;
 
     /* Only stringify if log level is debug because stringifying network
@@ -155,7 +201,7 @@ bool address_has(struct sydbox_addr *haystack, struct sydbox_addr *needle)
             hsun_path = haystack->u.saun.rsun_path ? haystack->u.saun.rsun_path : haystack->u.saun.sun_path;
             nsun_path = needle->u.saun.rsun_path ? needle->u.saun.rsun_path : needle->u.saun.sun_path;
             if (haystack->u.saun.exact) {
-                if (0 == strncmp(hsun_path, nsun_path, sizeof(hsun_path))) {
+                if (hsun_path == nsun_path) {
                     g_debug("%s has %s (path exact match)", haystack_str, needle_str);
                     g_free(haystack_str);
                     g_free(needle_str);
@@ -261,8 +307,7 @@ struct sydbox_addr *address_from_string(const gchar *src, bool canlog)
         saddr->family = AF_UNIX;
         saddr->u.saun.abstract = false;
         saddr->u.saun.exact = false;
-        strncpy(saddr->u.saun.sun_path, src + 7, PATH_MAX);
-        saddr->u.saun.sun_path[PATH_MAX - 1] = '\0';
+        address_set_path(saddr, src + 7);
         if (canlog)
             g_info("New whitelist address {family=AF_UNIX path=%s abstract=false}", saddr->u.saun.sun_path);
     }
@@ -270,8 +315,7 @@ struct sydbox_addr *address_from_string(const gchar *src, bool canlog)
         saddr->family = AF_UNIX;
         saddr->u.saun.abstract = true;
         saddr->u.saun.exact = false;
-        strncpy(saddr->u.saun.sun_path, src + 16, PATH_MAX);
-        saddr->u.saun.sun_path[PATH_MAX - 1] = '\0';
+        address_set_path(saddr, src + 16);
         if (canlog)
             g_info("New whitelist address {family=AF_UNIX path=%s abstract=true}", saddr->u.saun.sun_path);
     }
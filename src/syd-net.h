@@ -31,6 +31,9 @@
 #include <glib.h>
 #include <pinktrace/pink.h>
 
+/* UNIX socket paths are interned and shared between the addresses, see
+ * address_set_path(). An address is 40 bytes whatever its family.
+ */
 struct sydbox_addr {
     int family;
 
@@ -38,8 +41,8 @@ struct sydbox_addr {
         struct {
             bool abstract;
             bool exact;
-            char sun_path[PATH_MAX];
-            char *rsun_path;
+            const char *sun_path;
+            const char *rsun_path;  // Canonicalized path, NULL if not resolved
         } saun;
 
         struct {
@@ -58,6 +61,10 @@ struct sydbox_addr {
     } u;
 };
 
+void address_set_path(struct sydbox_addr *addr, const char *path);
+
+void address_set_rpath(struct sydbox_addr *addr, const char *rpath);
+
 void address_free(struct sydbox_addr *addr);
 
 bool address_cmp(const struct sydbox_addr *addr1, const struct sydbox_addr *addr2);
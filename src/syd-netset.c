@@ -0,0 +1,285 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <glib.h>
+
+#include "syd-glob.h"
+#include "syd-log.h"
+#include "syd-net.h"
+#include "syd-netset.h"
+
+/* IPv4 and IPv6 addresses are kept in binary tries with one level per bit of
+ * the address, an address with netmask n ends at depth n and its port range is
+ * stored there. Looking an address up walks down its bits and checks the port
+ * ranges found on the way, so the cost depends on the length of the address
+ * and not on the number of addresses in the set.
+ * UNIX socket paths are looked up in a hash table, patterns in a glob set.
+ */
+
+struct netrange
+{
+    int port[2];
+};
+
+struct netnode
+{
+    struct netnode *child[2];
+    GArray *ranges;     // Port ranges of the addresses ending here, NULL if none
+};
+
+struct netset
+{
+    struct netnode *inet;
+#if SYDBOX_HAVE_IPV6
+    struct netnode *inet6;
+#endif /* SYDBOX_HAVE_IPV6 */
+    GHashTable *paths[2];           // Exact paths to their count, [1] is abstract
+    struct globset *patterns[2];    // Path patterns, [1] is abstract
+};
+
+static inline int netset_bit(const unsigned char *b, int i)
+{
+    return (b[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+static inline const gchar *netset_path(const struct sydbox_addr *addr)
+{
+    return addr->u.saun.rsun_path ? addr->u.saun.rsun_path : addr->u.saun.sun_path;
+}
+
+/* Returns the trie root of the address family, the address bytes, the length
+ * of the prefix and the port range in the address.
+ */
+static struct netnode **netset_inet(struct netset *set, const struct sydbox_addr *addr,
+        const unsigned char **b, int *bits, const int **port)
+{
+    switch (addr->family) {
+        case AF_INET:
+            *b = (const unsigned char *)&addr->u.sa.sin_addr;
+            *bits = CLAMP(addr->u.sa.netmask, 0, 32);
+            *port = addr->u.sa.port;
+            return &set->inet;
+#if SYDBOX_HAVE_IPV6
+        case AF_INET6:
+            *b = (const unsigned char *)&addr->u.sa6.sin6_addr;
+            *bits = CLAMP(addr->u.sa6.netmask, 0, 128);
+            *port = addr->u.sa6.port;
+            return &set->inet6;
+#endif /* SYDBOX_HAVE_IPV6 */
+        default:
+            return NULL;
+    }
+}
+
+static void netnode_free(struct netnode *node)
+{
+    if (NULL == node)
+        return;
+    netnode_free(node->child[0]);
+    netnode_free(node->child[1]);
+    if (NULL != node->ranges)
+        g_array_free(node->ranges, TRUE);
+    g_free(node);
+}
+
+struct netset *netset_new(void)
+{
+    struct netset *set;
+
+    set = g_new0(struct netset, 1);
+    for (unsigned int i = 0; i < 2; i++)
+        set->paths[i] = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    return set;
+}
+
+void netset_free(struct netset *set)
+{
+    if (NULL == set)
+        return;
+    netset_clear(set);
+    for (unsigned int i = 0; i < 2; i++) {
+        g_hash_table_destroy(set->paths[i]);
+        if (NULL != set->patterns[i])
+            globset_free(set->patterns[i]);
+    }
+    g_free(set);
+}
+
+void netset_add(struct netset *set, const struct sydbox_addr *addr)
+{
+    int abstract, bits;
+    guint count;
+    const int *port;
+    const unsigned char *b;
+    struct netnode **node;
+    struct netrange range;
+
+    if (AF_UNIX == addr->family) {
+        abstract = addr->u.saun.abstract ? 1 : 0;
+        if (addr->u.saun.exact) {
+            count = GPOINTER_TO_UINT(g_hash_table_lookup(set->paths[abstract], netset_path(addr)));
+            g_hash_table_insert(set->paths[abstract], g_strdup(netset_path(addr)), GUINT_TO_POINTER(count + 1));
+        }
+        else {
+            if (NULL == set->patterns[abstract])
+                set->patterns[abstract] = globset_new();
+            globset_add(set->patterns[abstract], netset_path(addr));
+        }
+        return;
+    }
+
+    if (NULL == (node = netset_inet(set, addr, &b, &bits, &port)))
+        return;
+    for (int i = 0;; i++) {
+        if (NULL == *node)
+            *node = g_new0(struct netnode, 1);
+        if (i == bits)
+            break;
+        node = &(*node)->child[netset_bit(b, i)];
+    }
+    if (NULL == (*node)->ranges)
+        (*node)->ranges = g_array_new(FALSE, FALSE, sizeof(struct netrange));
+    range.port[0] = port[0];
+    range.port[1] = port[1];
+    g_array_append_val((*node)->ranges, range);
+}
+
+bool netset_remove(struct netset *set, const struct sydbox_addr *addr)
+{
+    int abstract, bits, depth;
+    guint i, count;
+    const int *port;
+    const unsigned char *b;
+    struct netnode **node;
+    struct netnode **path[129];
+    struct netrange *range;
+
+    if (AF_UNIX == addr->family) {
+        abstract = addr->u.saun.abstract ? 1 : 0;
+        if (!addr->u.saun.exact)
+            return (NULL != set->patterns[abstract]) && globset_remove(set->patterns[abstract], netset_path(addr));
+
+        count = GPOINTER_TO_UINT(g_hash_table_lookup(set->paths[abstract], netset_path(addr)));
+        if (0 == count)
+            return false;
+        else if (1 == count)
+            g_hash_table_remove(set->paths[abstract], netset_path(addr));
+        else
+            g_hash_table_insert(set->paths[abstract], g_strdup(netset_path(addr)), GUINT_TO_POINTER(count - 1));
+        return true;
+    }
+
+    if (NULL == (node = netset_inet(set, addr, &b, &bits, &port)))
+        return false;
+    for (depth = 0; NULL != *node; depth++) {
+        path[depth] = node;
+        if (depth == bits)
+            break;
+        node = &(*node)->child[netset_bit(b, depth)];
+    }
+    if (NULL == *node || NULL == (*node)->ranges)
+        return false;
+
+    for (i = 0; i < (*node)->ranges->len; i++) {
+        range = &g_array_index((*node)->ranges, struct netrange, i);
+        if (range->port[0] == port[0] && range->port[1] == port[1])
+            break;
+    }
+    if (i == (*node)->ranges->len)
+        return false;
+    g_array_remove_index_fast((*node)->ranges, i);
+    if (0 == (*node)->ranges->len) {
+        g_array_free((*node)->ranges, TRUE);
+        (*node)->ranges = NULL;
+    }
+
+    /* Prune the nodes nothing ends at or below anymore */
+    for (; depth >= 0; depth--) {
+        node = path[depth];
+        if (NULL != (*node)->ranges || NULL != (*node)->child[0] || NULL != (*node)->child[1])
+            break;
+        g_free(*node);
+        *node = NULL;
+    }
+    return true;
+}
+
+void netset_clear(struct netset *set)
+{
+    netnode_free(set->inet);
+    set->inet = NULL;
+#if SYDBOX_HAVE_IPV6
+    netnode_free(set->inet6);
+    set->inet6 = NULL;
+#endif /* SYDBOX_HAVE_IPV6 */
+    for (unsigned int i = 0; i < 2; i++) {
+        g_hash_table_remove_all(set->paths[i]);
+        if (NULL != set->patterns[i])
+            globset_clear(set->patterns[i]);
+    }
+}
+
+/* Returns true if an address of the set has the address, with its port range
+ * in the range of the address of the set if ports is true.
+ */
+bool netset_match(struct netset *set, const struct sydbox_addr *addr, bool ports)
+{
+    int abstract, bits;
+    const int *port;
+    const unsigned char *b;
+    const struct netrange *range;
+    struct netnode **root, *node;
+
+    if (AF_UNIX == addr->family) {
+        abstract = addr->u.saun.abstract ? 1 : 0;
+        if (NULL != g_hash_table_lookup(set->paths[abstract], netset_path(addr)))
+            return true;
+        return (NULL != set->patterns[abstract]) && (NULL != globset_match(set->patterns[abstract], netset_path(addr)));
+    }
+
+    if (NULL == (root = netset_inet(set, addr, &b, &bits, &port)))
+        return false;
+    /* The netmask of the address looked up doesn't matter, all its bits do */
+    bits = (AF_INET == addr->family) ? 32 : 128;
+    node = *root;
+    for (int i = 0; NULL != node; i++) {
+        if (NULL != node->ranges) {
+            if (!ports)
+                return true;
+            for (guint j = 0; j < node->ranges->len; j++) {
+                range = &g_array_index(node->ranges, struct netrange, j);
+                if (port[0] >= range->port[0] && port[1] <= range->port[1])
+                    return true;
+            }
+        }
+        if (i == bits)
+            break;
+        node = node->child[netset_bit(b, i)];
+    }
+    return false;
+}
@@ -0,0 +1,44 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SYDBOX_GUARD_NETSET_H
+#define SYDBOX_GUARD_NETSET_H 1
+
+#include <stdbool.h>
+
+#include <glib.h>
+
+#include "syd-net.h"
+
+/* A set of network addresses, looked up by the address family */
+struct netset;
+
+struct netset *netset_new(void);
+
+void netset_free(struct netset *set);
+
+void netset_add(struct netset *set, const struct sydbox_addr *addr);
+
+bool netset_remove(struct netset *set, const struct sydbox_addr *addr);
+
+void netset_clear(struct netset *set);
+
+bool netset_match(struct netset *set, const struct sydbox_addr *addr, bool ports);
+
+#endif // SYDBOX_GUARD_NETSET_H
@@ -0,0 +1,491 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#if SYDBOX_HAVE_SECCOMP
+#include <linux/seccomp.h>
+#endif // SYDBOX_HAVE_SECCOMP
+
+#include <glib.h>
+#include <pinktrace/pink.h>
+
+#include "syd-children.h"
+#include "syd-config.h"
+#include "syd-dispatch.h"
+#include "syd-flags.h"
+#include "syd-log.h"
+#include "syd-notify.h"
+#include "syd-proc.h"
+#include "syd-seccomp.h"
+#include "syd-syscall.h"
+
+#if SYDBOX_HAVE_SECCOMP && defined(SECCOMP_USER_NOTIF_FLAG_CONTINUE) && defined(__NR_seccomp)
+
+/* Children that are gone are removed from the table this often, in
+ * milliseconds, whether the listener is busy or not.
+ */
+#define NOTIFY_SWEEP_INTERVAL 1000
+
+/* Busy children are being checked by a worker and are never removed */
+#define TCHILD_BUSY TCHILD_INSYSCALL
+
+static int notify_fd = -1;
+static struct seccomp_notif_sizes notify_sizes;
+
+/* Protects ctx->children, the workers and the main thread share it */
+static GStaticMutex children_mutex = G_STATIC_MUTEX_INIT;
+
+/* Returns whether the pid of the child has been recycled, the process with
+ * the given start time isn't the one she was added for.
+ */
+static bool notify_recycled(const struct tchild *child, guint64 starttime)
+{
+    return 0 != child->starttime && starttime != child->starttime;
+}
+
+/* Finds the tracked child the new child pid inherits its sandbox data from.
+ * Threads inherit from their thread group leader, processes from their closest
+ * tracked ancestor. Children of exiting processes have been adopted before
+ * they were reparented to sydbox, see notify_adopt().
+ * Returns NULL if there's no tracked ancestor, the sandbox data of the child
+ * is unknown then.
+ */
+static struct tchild *notify_find_parent(context_t *ctx, pid_t pid)
+{
+    pid_t ppid;
+    struct tchild *parent;
+
+    ppid = proc_tgid(pid);
+    if (ppid == pid)
+        ppid = proc_ppid(pid);
+    while (1 < ppid && ppid != getpid()) {
+        parent = tchild_find(ctx->children, ppid);
+        if (NULL != parent && !notify_recycled(parent, proc_starttime(ppid)))
+            return parent;
+        ppid = proc_ppid(ppid);
+    }
+    return NULL;
+}
+
+/* Adds the new child pid, called with children_mutex held */
+static struct tchild *notify_new_child(context_t *ctx, pid_t pid, guint64 starttime, struct tchild *parent)
+{
+    struct tchild *child;
+
+    child = tchild_new(ctx->children, pid, false);
+    child->flags |= TCHILD_UNTRACED;
+    child->starttime = starttime;
+    g_debug("child %i inherits sandbox data from %i", pid, parent->pid);
+    syscall_notify_inherit(child, parent);
+    child->flags &= ~TCHILD_NEEDSETUP;
+    return child;
+}
+
+/* Looks up the child with the given pid, adding it if it's new, and marks it
+ * busy. An entry left behind by a process that's gone is dropped when its pid
+ * is recycled, the start time of the process tells them apart.
+ * Returns NULL if the child isn't tracked and has no tracked ancestor.
+ */
+static struct tchild *notify_get_child(context_t *ctx, pid_t pid)
+{
+    guint64 starttime;
+    struct tchild *child, *parent;
+
+    if (0 == (starttime = proc_starttime(pid)))
+        return NULL;
+
+    g_static_mutex_lock(&children_mutex);
+    child = tchild_find(ctx->children, pid);
+    if (NULL != child && notify_recycled(child, starttime)) {
+        if (child->flags & TCHILD_BUSY) {
+            /* The worker of the process that's gone still holds it */
+            g_static_mutex_unlock(&children_mutex);
+            return NULL;
+        }
+        g_info("pid %i has been recycled, removing stale child from context", pid);
+        tchild_delete(ctx->children, pid);
+        child = NULL;
+    }
+    if (NULL == child) {
+        parent = notify_find_parent(ctx, pid);
+        if (NULL != parent)
+            child = notify_new_child(ctx, pid, starttime, parent);
+    }
+    if (NULL != child) {
+        child->starttime = starttime;
+        child->flags |= TCHILD_BUSY;
+    }
+    g_static_mutex_unlock(&children_mutex);
+    return child;
+}
+
+static void notify_put_child(struct tchild *child)
+{
+    g_static_mutex_lock(&children_mutex);
+    child->flags &= ~TCHILD_BUSY;
+    g_static_mutex_unlock(&children_mutex);
+}
+
+/* Adopts the children of the exiting process parent. Once she's gone they're
+ * reparented to sydbox and can't be traced back to her.
+ */
+static void notify_adopt(context_t *ctx, struct tchild *parent)
+{
+    pid_t pid;
+    guint64 starttime;
+    GSList *children, *walk;
+    struct tchild *child;
+
+    children = proc_children(parent->pid);
+    g_static_mutex_lock(&children_mutex);
+    for (walk = children; NULL != walk; walk = g_slist_next(walk)) {
+        pid = GPOINTER_TO_INT(walk->data);
+        if (0 == (starttime = proc_starttime(pid)))
+            continue;
+        child = tchild_find(ctx->children, pid);
+        if (NULL != child && (!notify_recycled(child, starttime) || (child->flags & TCHILD_BUSY)))
+            continue;
+        notify_new_child(ctx, pid, starttime, parent);
+    }
+    g_static_mutex_unlock(&children_mutex);
+    g_slist_free(children);
+}
+
+/* Decides about one notification.
+ * Returns true if the system call should continue, otherwise false and the
+ * value to reply with in *error.
+ */
+static bool notify_decide(context_t *ctx, struct tchild *child, struct seccomp_notif *req, int *error)
+{
+    child->bitness = seccomp_bitness(req->data.arch, req->data.nr);
+    if (PINK_BITNESS_UNKNOWN == child->bitness) {
+        g_info("child %i called system call %d with unsupported architecture %#x",
+                child->pid, req->data.nr, req->data.arch);
+        *error = -ENOSYS;
+        return false;
+    }
+
+    if (dispatch_lookup(req->data.nr, child->bitness)->exit & EXIT_ADOPT) {
+        notify_adopt(ctx, child);
+        return true;
+    }
+
+    if (child->flags & TCHILD_NEEDSETUP) {
+        /* The first system call of the eldest child is the initial execve(),
+         * which isn't checked.
+         */
+        child->flags &= ~TCHILD_NEEDSETUP;
+        return true;
+    }
+
+    child->sno = req->data.nr;
+    child->args = (const guint64 *)req->data.args;
+    if (syscall_notify(ctx, child)) {
+        child->args = NULL;
+        return true;
+    }
+    child->args = NULL;
+    *error = child->retval;
+    return false;
+}
+
+static void notify_handle(gpointer data, gpointer userdata)
+{
+    int error;
+    context_t *ctx = (context_t *)userdata;
+    struct seccomp_notif *req = (struct seccomp_notif *)data;
+    struct seccomp_notif_resp *resp;
+    struct tchild *child;
+
+    resp = g_malloc0(notify_sizes.seccomp_notif_resp);
+    resp->id = req->id;
+
+    error = 0;
+    child = notify_get_child(ctx, req->pid);
+    if (NULL == child) {
+        g_info("no sandbox data for unknown child %i, denying system call %d", req->pid, req->data.nr);
+        resp->error = -EPERM;
+    }
+    else {
+        if (notify_decide(ctx, child, req, &error))
+            resp->flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+        else
+            resp->error = error;
+        notify_put_child(child);
+    }
+
+    /* The arguments read from the memory of the child are only valid if the
+     * child is still blocked in the same system call.
+     */
+    if (0 > ioctl(notify_fd, SECCOMP_IOCTL_NOTIF_ID_VALID, &req->id))
+        g_debug("notification %llu of child %i is no longer valid", (unsigned long long)req->id, req->pid);
+    else if (0 > ioctl(notify_fd, SECCOMP_IOCTL_NOTIF_SEND, resp) && ENOENT != errno)
+        g_warning("failed to reply to child %i: %s", req->pid, g_strerror(errno));
+
+    g_free(resp);
+    g_free(req);
+}
+
+static bool notify_sweep_one(struct tchild *child, G_GNUC_UNUSED void *userdata)
+{
+    pid_t pid = child->pid;
+
+    /* A pid recycled before the sweep is told apart by notify_get_child() */
+    if (child->flags & TCHILD_BUSY)
+        return false;
+    if (0 > kill(pid, 0) && ESRCH == errno) {
+        g_info("removing child %i from context", pid);
+        return true;
+    }
+    return false;
+}
+
+static void notify_sweep(context_t *ctx)
+{
+    g_static_mutex_lock(&children_mutex);
+    childtab_foreach_remove(ctx->children, notify_sweep_one, NULL);
+    g_static_mutex_unlock(&children_mutex);
+
+    /* There are no exit events, the sockets of exited processes are gone */
+    syscall_notify_sweep();
+}
+
+/* Reaps exited children.
+ * Returns true if tracing is finished.
+ */
+static bool notify_reap(context_t *ctx, int *code_ptr)
+{
+    int status;
+    pid_t pid;
+
+    for (;;) {
+        pid = waitpid(-1, &status, __WALL | WNOHANG);
+        if (0 == pid)
+            return false;
+        else if (0 > pid) {
+            if (EINTR == errno)
+                continue;
+            else if (ECHILD == errno)
+                return true;
+            g_critical("waitpid failed: %s", g_strerror(errno));
+            g_printerr("waitpid failed: %s\n", g_strerror(errno));
+            exit(-1);
+        }
+        else if (pid != ctx->eldest)
+            continue;
+
+        if (WIFEXITED(status)) {
+            *code_ptr = WEXITSTATUS(status);
+            g_info("Eldest child %i exited with status:%#x", pid, status);
+        }
+        else if (WIFSIGNALED(status)) {
+            *code_ptr = 128 + WTERMSIG(status);
+            g_info("Eldest child %i was terminated with status:%#x", pid, status);
+        }
+        else
+            continue;
+
+        if (!sydbox_config_get_wait_all())
+            return true;
+    }
+}
+
+int notify_loop(context_t *ctx, int fd)
+{
+    int nfds, sfd, ncpu, exit_code, timeout;
+    gint64 now, deadline;
+    sigset_t mask;
+    struct pollfd pfd[2];
+    struct signalfd_siginfo info;
+    struct seccomp_notif *req;
+    GError *error = NULL;
+    GThreadPool *pool;
+
+    if (0 > syscall(__NR_seccomp, SECCOMP_GET_NOTIF_SIZES, 0, &notify_sizes)) {
+        notify_sizes.seccomp_notif = sizeof(struct seccomp_notif);
+        notify_sizes.seccomp_notif_resp = sizeof(struct seccomp_notif_resp);
+    }
+    if (notify_sizes.seccomp_notif < sizeof(struct seccomp_notif))
+        notify_sizes.seccomp_notif = sizeof(struct seccomp_notif);
+    if (notify_sizes.seccomp_notif_resp < sizeof(struct seccomp_notif_resp))
+        notify_sizes.seccomp_notif_resp = sizeof(struct seccomp_notif_resp);
+    notify_fd = fd;
+
+    /* The signals have been blocked before the eldest child was forked */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if (0 > (sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC))) {
+        g_critical("failed to create signal file descriptor: %s", g_strerror(errno));
+        g_printerr("failed to create signal file descriptor: %s\n", g_strerror(errno));
+        exit(-1);
+    }
+
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    pool = g_thread_pool_new(notify_handle, ctx, (0 < ncpu) ? ncpu : 1, FALSE, &error);
+    if (NULL == pool) {
+        g_critical("failed to create thread pool: %s", error->message);
+        g_printerr("failed to create thread pool: %s\n", error->message);
+        exit(-1);
+    }
+
+    exit_code = EXIT_SUCCESS;
+    pfd[0].fd = sfd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = fd;
+    pfd[1].events = POLLIN;
+    deadline = g_get_monotonic_time() + (gint64)NOTIFY_SWEEP_INTERVAL * 1000;
+    for (nfds = 2;;) {
+        now = g_get_monotonic_time();
+        timeout = (now < deadline) ? (int)((deadline - now + 999) / 1000) : 0;
+        if (0 > poll(pfd, nfds, timeout)) {
+            if (EINTR == errno)
+                continue;
+            g_critical("poll failed: %s", g_strerror(errno));
+            g_printerr("poll failed: %s\n", g_strerror(errno));
+            exit(-1);
+        }
+
+        if (pfd[0].revents & POLLIN) {
+            while (0 < read(sfd, &info, sizeof(struct signalfd_siginfo))) {
+                if (SIGCHLD != info.ssi_signo)
+                    ctx->signum = info.ssi_signo;
+            }
+            if (0 != ctx->signum || notify_reap(ctx, &exit_code))
+                break;
+        }
+
+        if (2 == nfds && pfd[1].revents & POLLIN) {
+            req = g_malloc0(notify_sizes.seccomp_notif);
+            if (0 > ioctl(fd, SECCOMP_IOCTL_NOTIF_RECV, req)) {
+                /* ENOENT: the child was killed before we received the
+                 * notification.
+                 */
+                if (EINTR != errno && ENOENT != errno)
+                    g_warning("failed to receive notification: %s", g_strerror(errno));
+                g_free(req);
+            }
+            else
+                g_thread_pool_push(pool, req, NULL);
+        }
+        else if (2 == nfds && pfd[1].revents & (POLLHUP | POLLERR)) {
+            /* No process uses the filter anymore */
+            g_debug("seccomp listener hung up");
+            pfd[1].revents = 0;
+            nfds = 1;
+        }
+
+        /* The sweep is due on time under load as well */
+        now = g_get_monotonic_time();
+        if (now >= deadline) {
+            notify_sweep(ctx);
+            deadline = now + (gint64)NOTIFY_SWEEP_INTERVAL * 1000;
+        }
+    }
+
+    g_thread_pool_free(pool, TRUE, TRUE);
+    close(sfd);
+    return exit_code;
+}
+
+/* The filter of the children left can't be removed, their filtered system
+ * calls would fail once the listener is closed. A forked helper keeps answering
+ * the listener and continues every system call until no process uses the
+ * filter anymore, like the ptrace backend detaches the children left.
+ */
+void notify_release(int fd)
+{
+    pid_t pid;
+    struct pollfd pfd;
+    struct seccomp_notif *req;
+    struct seccomp_notif_resp *resp;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (0 < poll(&pfd, 1, 0) && pfd.revents & (POLLHUP | POLLERR)) {
+        /* No process uses the filter anymore */
+        close(fd);
+        return;
+    }
+
+    /* The helper doesn't allocate, another thread may have held the lock of
+     * the allocator at fork()
+     */
+    req = g_malloc0(notify_sizes.seccomp_notif);
+    resp = g_malloc0(notify_sizes.seccomp_notif_resp);
+    if (0 > (pid = fork()))
+        g_warning("failed to fork the listener of the children left, their system calls fail: %s", g_strerror(errno));
+    else if (0 == pid) {
+        for (;;) {
+            if (0 > poll(&pfd, 1, -1)) {
+                if (EINTR == errno)
+                    continue;
+                _exit(EXIT_FAILURE);
+            }
+            if (pfd.revents & POLLIN) {
+                memset(req, 0, notify_sizes.seccomp_notif);
+                if (0 > ioctl(fd, SECCOMP_IOCTL_NOTIF_RECV, req))
+                    continue;
+                memset(resp, 0, notify_sizes.seccomp_notif_resp);
+                resp->id = req->id;
+                resp->flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+                ioctl(fd, SECCOMP_IOCTL_NOTIF_SEND, resp);
+            }
+            else if (pfd.revents & (POLLHUP | POLLERR))
+                _exit(EXIT_SUCCESS);
+        }
+    }
+    g_free(resp);
+    g_free(req);
+    close(fd);
+}
+
+#else
+
+int notify_loop(G_GNUC_UNUSED context_t *ctx, G_GNUC_UNUSED int fd)
+{
+    g_critical("seccomp-notify backend isn't supported");
+    g_printerr("seccomp-notify backend isn't supported\n");
+    exit(-1);
+}
+
+void notify_release(int fd)
+{
+    close(fd);
+}
+
+#endif // SYDBOX_HAVE_SECCOMP && defined(SECCOMP_USER_NOTIF_FLAG_CONTINUE) && defined(__NR_seccomp)
@@ -18,6 +18,7 @@
  */
 
 #include <limits.h>
+#include <pwd.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -54,6 +55,124 @@ static char *shell_expand(const char * const str)
     return output;
 }
 
+/* Characters which make the shell do more than expanding variables and tildes */
+#define SHELL_SPECIAL   "\\'\"`;&|<>()*?[]{}#\t\n "
+
+static inline bool expand_isname(char c, bool first)
+{
+    return ('_' == c || g_ascii_isalpha(c) || (!first && g_ascii_isdigit(c)));
+}
+
+/* Appends the value of a variable or a home directory to res.
+ * Returns false if the shell would split or glob the value.
+ */
+static bool expand_append(GString *res, const char *val)
+{
+    if (NULL == val)
+        return true;
+    else if (NULL != strpbrk(val, "*?[ \t\n"))
+        return false;
+    g_string_append(res, val);
+    return true;
+}
+
+/* Expands ~, ~user, $VAR and ${VAR} in str the way /bin/sh -c "echo str"
+ * does, without spawning a shell. Returns NULL if str or the values of its
+ * variables contain anything else the shell would interpret.
+ */
+static char *expand_simple(const char *str)
+{
+    size_t i, len;
+    const char *p, *end;
+    char *name;
+    struct passwd *pw;
+    GString *res;
+
+    if ('-' == str[0])
+        return NULL; /* echo option */
+
+    res = g_string_sized_new(strlen(str) + 64);
+    p = str;
+    if ('~' == p[0]) {
+        end = strchrnul(p + 1, '/');
+        len = end - (p + 1);
+        for (i = 1; i <= len; i++) {
+            if ('$' == p[i] || NULL != strchr(SHELL_SPECIAL, p[i]))
+                goto fail;
+        }
+        if (0 == len) {
+            if (NULL == g_getenv("HOME") || !expand_append(res, g_getenv("HOME")))
+                goto fail;
+        }
+        else {
+            name = g_strndup(p + 1, len);
+            pw = getpwnam(name);
+            g_free(name);
+            if (NULL == pw) /* The shell leaves ~user alone if there's no such user */
+                g_string_append_len(res, p, end - p);
+            else if (!expand_append(res, pw->pw_dir))
+                goto fail;
+        }
+        p = end;
+    }
+
+    for (; '\0' != *p; p++) {
+        if ('$' != *p) {
+            if (NULL != strchr(SHELL_SPECIAL, *p))
+                goto fail;
+            g_string_append_c(res, *p);
+            continue;
+        }
+
+        if ('{' == p[1]) {
+            for (end = p + 2; expand_isname(*end, end == p + 2); end++)
+                ;
+            /* Only plain ${VAR}, no ${VAR:-default} and the like */
+            if (end == p + 2 || '}' != *end)
+                goto fail;
+            name = g_strndup(p + 2, end - (p + 2));
+        }
+        else if (expand_isname(p[1], true)) {
+            for (end = p + 1; expand_isname(*end, false); end++)
+                ;
+            name = g_strndup(p + 1, end - (p + 1));
+            --end;
+        }
+        else if ('\0' == p[1] || '/' == p[1] || '.' == p[1] || ':' == p[1]) {
+            /* A lone $ is left alone */
+            g_string_append_c(res, '$');
+            continue;
+        }
+        else /* $(, $$, $1 and friends */
+            goto fail;
+
+        if (!expand_append(res, g_getenv(name))) {
+            g_free(name);
+            goto fail;
+        }
+        g_free(name);
+        p = end;
+    }
+    return g_string_free(res, FALSE);
+
+fail:
+    g_string_free(res, TRUE);
+    return NULL;
+}
+
+/* Expands the path, falling back to the shell for anything but variables and
+ * tildes.
+ */
+static char *path_expand(const char *str)
+{
+    char *res;
+
+    if (NULL != (res = expand_simple(str)))
+        return res;
+    g_debug("`%s' needs the shell to expand", str);
+    return shell_expand(str);
+}
+
 inline bool path_magic_prefix(const char *path)
 {
     return (0 == strncmp(path, CMD_PATH, sizeof(CMD_PATH) - 2));
@@ -209,7 +328,136 @@ inline bool path_magic_net_unwhitelist_connect(const char *path)
     return (0 == strncmp(path, CMD_NET_UNWHITELIST_CONNECT, sizeof(CMD_NET_UNWHITELIST_CONNECT) - 1));
 }
 
-int pathnode_new(GSList **pathlist, const char *path, bool sanitize)
+/* The prefixes are kept in a trie of their '/' separated components too, so a
+ * check costs one hash table lookup per component of the checked path no matter
+ * how many prefixes there are. The root node stands for the prefix "/", which
+ * matches every path.
+ */
+struct pathtrie
+{
+    guint count;            // Number of prefixes ending at this node.
+    GHashTable *children;   // Next component -> struct pathtrie
+};
+
+static void pathtrie_free(gpointer node_ptr)
+{
+    struct pathtrie *node = (struct pathtrie *) node_ptr;
+
+    if (NULL != node->children)
+        g_hash_table_destroy(node->children);
+    g_free(node);
+}
+
+/* Returns a copy of the prefix with repeated and trailing slashes stripped,
+ * so "/tmp/" and "//tmp" end at the same node as "/tmp".
+ */
+static char *pathtrie_key(const char *path)
+{
+    char *key, *p;
+
+    key = g_malloc(strlen(path) + 1);
+    for (p = key; '\0' != *path; path++) {
+        if ('/' == *path && p > key && '/' == p[-1])
+            continue;
+        *p++ = *path;
+    }
+    while (p > key + 1 && '/' == p[-1])
+        --p;
+    *p = '\0';
+    return key;
+}
+
+static void pathtrie_insert(struct pathlist *pathlist, const char *path)
+{
+    char *buf, *comp, *end;
+    struct pathtrie *node, *next;
+
+    if (NULL == pathlist->trie)
+        pathlist->trie = g_new0(struct pathtrie, 1);
+    node = pathlist->trie;
+
+    buf = pathtrie_key(path);
+    if (0 != strncmp(buf, "/", 2)) {
+        for (comp = buf;; comp = end + 1) {
+            if (NULL != (end = strchr(comp, '/')))
+                *end = '\0';
+            if (NULL == node->children)
+                node->children = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, pathtrie_free);
+            if (NULL == (next = g_hash_table_lookup(node->children, comp))) {
+                next = g_new0(struct pathtrie, 1);
+                g_hash_table_insert(node->children, g_strdup(comp), next);
+            }
+            node = next;
+            if (NULL == end)
+                break;
+        }
+    }
+    g_free(buf);
+    ++node->count;
+}
+
+/* Removes one prefix from the trie, comp points to the components left below
+ * node. Returns true if node is left empty and can be pruned.
+ */
+static bool pathtrie_remove(struct pathtrie *node, char *comp)
+{
+    char *end;
+    struct pathtrie *next;
+
+    if (NULL == comp) {
+        if (0 < node->count)
+            --node->count;
+    }
+    else if (NULL != node->children) {
+        if (NULL != (end = strchr(comp, '/')))
+            *end = '\0';
+        next = g_hash_table_lookup(node->children, comp);
+        if (NULL != next && pathtrie_remove(next, (NULL == end) ? NULL : end + 1))
+            g_hash_table_remove(node->children, comp);
+        if (0 == g_hash_table_size(node->children)) {
+            g_hash_table_destroy(node->children);
+            node->children = NULL;
+        }
+    }
+    return (0 == node->count && NULL == node->children);
+}
+
+static bool pathtrie_lookup(const struct pathtrie *root, const char *path)
+{
+    bool ret;
+    char *buf, *comp, *end;
+    const struct pathtrie *node;
+
+    if (NULL == root)
+        return false;
+    else if (0 < root->count)
+        return true;
+
+    ret = false;
+    buf = g_strdup(path);
+    for (node = root, comp = buf; NULL != node->children; comp = end + 1) {
+        if (NULL != (end = strchr(comp, '/')))
+            *end = '\0';
+        if (NULL == (node = g_hash_table_lookup(node->children, comp)))
+            break;
+        else if (0 < node->count) {
+            ret = true;
+            break;
+        }
+        else if (NULL == end)
+            break;
+    }
+    g_free(buf);
+    return ret;
+}
+
+static void pathlist_prepend(struct pathlist *pathlist, char *data)
+{
+    pathlist->paths = g_slist_prepend(pathlist->paths, data);
+    pathtrie_insert(pathlist, data);
+}
+
+int pathnode_new(struct pathlist *pathlist, const char *path, bool sanitize)
 {
     char *data;
 
@@ -226,22 +474,22 @@ int pathnode_new(GSList **pathlist, const char *path, bool sanitize)
         data = g_strdup(path);
     else {
         char *spath = sydbox_compress_path(path);
-        data = shell_expand(spath);
+        data = path_expand(spath);
         g_free(spath);
-        /* shell_expand() may return empty string! */
+        /* path_expand() may return empty string! */
         if (G_UNLIKELY('\0' == data[0])) {
-            g_info("shell_expand() returned empty string for `%s', not adding to list", path);
+            g_info("path_expand() returned empty string for `%s', not adding to list", path);
             g_free(data);
             return -1;
         }
         else
             g_info("new path item `%s'", data);
     }
-    *pathlist = g_slist_prepend(*pathlist, data);
+    pathlist_prepend(pathlist, data);
     return 0;
 }
 
-int pathnode_new_early(GSList **pathlist, const char *path, bool sanitize)
+int pathnode_new_early(struct pathlist *pathlist, const char *path, bool sanitize)
 {
     char *data, *spath;
 
@@ -252,33 +500,44 @@ int pathnode_new_early(GSList **pathlist, const char *path, bool sanitize)
         data = g_strdup(path);
     else {
         spath = sydbox_compress_path(path);
-        data = shell_expand(spath);
+        data = path_expand(spath);
         g_free(spath);
-        /* shell_expand() may return empty string! */
+        /* path_expand() may return empty string! */
         if (G_UNLIKELY('\0' == data[0])) {
             g_free(data);
             return -1;
         }
     }
-    *pathlist = g_slist_prepend(*pathlist, data);
+    pathlist_prepend(pathlist, data);
     return 0;
 }
 
-void pathnode_free(GSList **pathlist)
+void pathnode_free(struct pathlist *pathlist)
 {
-    g_slist_foreach(*pathlist, (GFunc) g_free, NULL);
-    g_slist_free(*pathlist);
-    *pathlist = NULL;
+    g_slist_foreach(pathlist->paths, (GFunc) g_free, NULL);
+    g_slist_free(pathlist->paths);
+    pathlist->paths = NULL;
+    if (NULL != pathlist->trie) {
+        pathtrie_free(pathlist->trie);
+        pathlist->trie = NULL;
+    }
 }
 
-void pathnode_delete(GSList **pathlist, const char *path_sanitized)
+void pathnode_delete(struct pathlist *pathlist, const char *path_sanitized)
 {
+    char *key;
     GSList *walk;
 
-    for (walk = *pathlist; walk != NULL; walk = g_slist_next(walk)) {
+    for (walk = pathlist->paths; walk != NULL; walk = g_slist_next(walk)) {
         if (0 == strncmp(walk->data, path_sanitized, strlen(path_sanitized) + 1)) {
             g_debug("freeing pathnode %p", (void *) walk);
-            *pathlist = g_slist_remove_link(*pathlist, walk);
+            pathlist->paths = g_slist_remove_link(pathlist->paths, walk);
+            key = pathtrie_key(walk->data);
+            if (0 == strncmp(key, "/", 2))
+                pathtrie_remove(pathlist->trie, NULL);
+            else
+                pathtrie_remove(pathlist->trie, key);
+            g_free(key);
             g_free(walk->data);
             g_slist_free(walk);
             break;
@@ -286,7 +545,15 @@ void pathnode_delete(GSList **pathlist, const char *path_sanitized)
     }
 }
 
-int pathlist_init(GSList **pathlist, const char *pathlist_env)
+void pathlist_copy(struct pathlist *dest, const struct pathlist *src)
+{
+    GSList *walk;
+
+    for (walk = src->paths; walk != NULL; walk = g_slist_next(walk))
+        pathlist_prepend(dest, g_strdup(walk->data));
+}
+
+int pathlist_init(struct pathlist *pathlist, const char *pathlist_env)
 {
     char **split;
     int nempty, npaths;
@@ -300,7 +567,7 @@ int pathlist_init(GSList **pathlist, const char *pathlist_env)
     split = g_strsplit(pathlist_env, ":", -1);
     for (unsigned int i = 0; i < g_strv_length(split); i++) {
         if (0 != strncmp(split[i], "", 2))
-            *pathlist = g_slist_prepend(*pathlist, g_strdup(split[i]));
+            pathlist_prepend(pathlist, g_strdup(split[i]));
         else {
             g_debug("ignoring empty path element in position %d", i);
             ++nempty;
@@ -312,51 +579,16 @@ int pathlist_init(GSList **pathlist, const char *pathlist_env)
     return npaths;
 }
 
-bool pathlist_check(GSList *pathlist, const char *path_sanitized)
+bool pathlist_check(const struct pathlist *pathlist, const char *path_sanitized)
 {
     bool ret;
-    size_t len;
-    GSList *walk;
 
     g_debug("checking `%s'", path_sanitized);
 
-    ret = false;
-    for (walk = pathlist; walk != NULL; walk = g_slist_next(walk)) {
-        if (0 == strncmp(walk->data, "/", 2)) {
-            g_debug("`%s' begins with `%s'", path_sanitized, (char *) walk->data);
-            ret = true;
-            break;
-        }
-        len = strlen(walk->data);
-        if (0 == strncmp(path_sanitized, walk->data, len)) {
-            if (strlen(path_sanitized) > len) {
-                /* Path begins with one of the allowed paths. Check for a
-                 * zero byte or a / on the next character so that for example
-                 * /devzero/foo doesn't pass the test when /dev is the only
-                 * allowed path.
-                 */
-                const char last = path_sanitized[len];
-                if ('\0' == last || '/' == last) {
-                    g_debug("`%s' begins with `%s'", path_sanitized, (char *) walk->data);
-                    ret = true;
-                    break;
-                }
-                else
-                    g_debug("`%s' doesn't begin with `%s'", path_sanitized, (char *) walk->data);
-            }
-            else {
-                g_debug("`%s' begins with `%s'", path_sanitized, (char *) walk->data);
-                ret = true;
-                break;
-            }
-        }
-        else
-            g_debug("`%s' doesn't begin with `%s'", path_sanitized, (char *) walk->data);
-    }
+    ret = pathtrie_lookup(pathlist->trie, path_sanitized);
     if (ret)
         g_debug("path list check succeeded for `%s'", path_sanitized);
     else
         g_debug("path list check failed for `%s'", path_sanitized);
     return ret;
 }
-
@@ -125,17 +125,30 @@ bool path_magic_net_whitelist_connect(const char *path);
 
 bool path_magic_net_unwhitelist_connect(const char *path);
 
-int pathnode_new(GSList **pathlist, const char *path, bool sanitize);
+struct pathtrie;
 
-int pathnode_new_early(GSList **pathlist, const char *path, bool sanitize);
+/* A list of path prefixes */
+struct pathlist
+{
+    GSList *paths;          // Prefixes, the last added one first.
+    struct pathtrie *trie;  // Trie of the prefixes used by pathlist_check().
+};
 
-void pathnode_free(GSList **pathlist);
+#define PATHLIST_INIT { NULL, NULL }
 
-void pathnode_delete(GSList **pathlist, const char *path_sanitized);
+int pathnode_new(struct pathlist *pathlist, const char *path, bool sanitize);
 
-int pathlist_init(GSList **pathlist, const char *pathlist_env);
+int pathnode_new_early(struct pathlist *pathlist, const char *path, bool sanitize);
 
-bool pathlist_check(GSList *pathlist, const char *path_sanitized);
+void pathnode_free(struct pathlist *pathlist);
+
+void pathnode_delete(struct pathlist *pathlist, const char *path_sanitized);
+
+void pathlist_copy(struct pathlist *dest, const struct pathlist *src);
+
+int pathlist_init(struct pathlist *pathlist, const char *pathlist_env);
+
+bool pathlist_check(const struct pathlist *pathlist, const char *path_sanitized);
 
 #endif // SYDBOX_GUARD_PATH_H
 
@@ -17,30 +17,632 @@
  * Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
 #include <errno.h>
+#include <fcntl.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <arpa/inet.h>
+
+#include "syd-flags.h"
 #include "syd-log.h"
 #include "syd-pink.h"
+#include "syd-seccomp.h"
 
 /* Wrappers around pinktrace functions */
 
+/* Cleared if the kernel doesn't know PTRACE_O_EXITKILL, older than 3.8 */
+static bool trace_exitkill = true;
+
+static long pinkw_trace_options(bool seccomp, bool exitkill)
+{
+    long options;
+
+    options = PTRACE_O_TRACESYSGOOD
+        | PTRACE_O_TRACEFORK
+        | PTRACE_O_TRACEVFORK
+        | PTRACE_O_TRACECLONE
+        | PTRACE_O_TRACEEXEC
+        | PTRACE_O_TRACEEXIT;
+    if (seccomp)
+        options |= SYDBOX_PTRACE_O_TRACESECCOMP;
+    if (exitkill && trace_exitkill)
+        options |= SYDBOX_PTRACE_O_EXITKILL;
+    return options;
+}
+
 inline
-bool pinkw_trace_setup_all(pid_t pid)
+bool pinkw_trace_setup_all(pid_t pid, bool seccomp, bool exitkill)
+{
+    /* pinktrace can't set PTRACE_O_TRACESECCOMP or PTRACE_O_EXITKILL */
+    return (0 == ptrace(PTRACE_SETOPTIONS, pid, NULL, pinkw_trace_options(seccomp, exitkill)));
+}
+
+/* Attaches to the process without stopping it, with the options set at once
+ * so no event of the process is missed. With exitkill the tracees are killed
+ * if sydbox dies.
+ */
+bool pinkw_trace_seize(pid_t pid, bool seccomp, bool exitkill)
+{
+    if (0 == ptrace(SYDBOX_PTRACE_SEIZE, pid, NULL, pinkw_trace_options(seccomp, exitkill)))
+        return true;
+    else if (EINVAL != errno || !exitkill || !trace_exitkill)
+        return false;
+
+    g_info("PTRACE_O_EXITKILL isn't supported, tracees may outlive sydbox");
+    trace_exitkill = false;
+    return (0 == ptrace(SYDBOX_PTRACE_SEIZE, pid, NULL, pinkw_trace_options(seccomp, exitkill)));
+}
+
+/* Stops a seized tracee, she reports a PTRACE_EVENT_STOP */
+bool pinkw_trace_interrupt(pid_t pid)
+{
+    return (0 == ptrace(SYDBOX_PTRACE_INTERRUPT, pid, NULL, NULL));
+}
+
+/* The seccomp-notify backend doesn't stop the children, their registers can't
+ * be read and their arguments are taken from the notification instead.
+ * child->args is non-NULL while the child is blocked in a notification.
+ * Traced children have their arguments in the register snapshot of the current
+ * stop, if the kernel could provide one.
+ */
+static inline const guint64 *pinkw_args(struct tchild *child)
+{
+    if (NULL != child->args)
+        return child->args;
+    else if (child->regs.valid & TREGS_ARGS)
+        return child->regs.args;
+    return NULL;
+}
+
+static long args_get_arg(struct tchild *child, const guint64 *args, unsigned ind)
+{
+#if PINKTRACE_BITNESS_COUNT_SUPPORTED == 2
+    if (PINK_BITNESS_32 == child->bitness)
+        return (gint32)args[ind];
+#endif
+    return (long)args[ind];
+}
+
+static unsigned long args_get_addr(struct tchild *child, const guint64 *args, unsigned ind)
+{
+#if PINKTRACE_BITNESS_COUNT_SUPPORTED == 2
+    if (PINK_BITNESS_32 == child->bitness)
+        return (guint32)args[ind];
+#endif
+    return (unsigned long)args[ind];
+}
+
+static bool pinkw_get_addr(struct tchild *child, unsigned ind, unsigned long *res)
 {
-    return pink_trace_setup(pid, PINK_TRACE_OPTION_SYSGOOD
-                | PINK_TRACE_OPTION_FORK
-                | PINK_TRACE_OPTION_VFORK
-                | PINK_TRACE_OPTION_CLONE
-                | PINK_TRACE_OPTION_EXEC
-                | PINK_TRACE_OPTION_EXIT);
+    long arg;
+    const guint64 *args;
+
+    if (NULL != (args = pinkw_args(child))) {
+        *res = args_get_addr(child, args, ind);
+        return true;
+    }
+    if (!pink_util_get_arg(child->pid, child->bitness, ind, &arg))
+        return false;
+#if PINKTRACE_BITNESS_COUNT_SUPPORTED == 2
+    if (PINK_BITNESS_32 == child->bitness)
+        arg = (guint32)arg;
+#endif
+    *res = (unsigned long)arg;
+    return true;
+}
+
+/* Fetches the register snapshot of a traced child with a single
+ * PTRACE_GET_SYSCALL_INFO call. At an exit stop only the return value is
+ * fetched, the arguments are kept from the entry. Without kernel support the
+ * snapshot stays invalid and the wrappers below fall back to one PTRACE_PEEKUSER
+ * per register.
+ */
+#ifdef PTRACE_GET_SYSCALL_INFO
+static volatile gboolean pinkw_regs_broken = FALSE;
+#endif // PTRACE_GET_SYSCALL_INFO
+
+bool pinkw_regs_fetch(struct tchild *child, bool entering)
+{
+#ifdef PTRACE_GET_SYSCALL_INFO
+    long ret;
+    struct __ptrace_syscall_info info;
+#endif // PTRACE_GET_SYSCALL_INFO
+
+    if (entering) {
+        child->regs.valid = 0;
+        child->regs.subcall = -1;
+    }
+    else
+        child->regs.valid &= ~TREGS_RETVAL;
+
+#ifdef PTRACE_GET_SYSCALL_INFO
+    if (pinkw_regs_broken)
+        return true;
+
+    ret = ptrace(PTRACE_GET_SYSCALL_INFO, child->pid, sizeof(info), &info);
+    if (0 > ret) {
+        if (ESRCH == errno)
+            return false;
+        /* Older kernels don't know about PTRACE_GET_SYSCALL_INFO */
+        pinkw_regs_broken = TRUE;
+        return true;
+    }
+
+    switch (info.op) {
+        case PTRACE_SYSCALL_INFO_ENTRY:
+            child->regs.sno = info.entry.nr;
+            memcpy(child->regs.args, info.entry.args, sizeof(child->regs.args));
+            child->regs.valid |= TREGS_ARGS;
+            break;
+        case PTRACE_SYSCALL_INFO_SECCOMP:
+            child->regs.sno = info.seccomp.nr;
+            memcpy(child->regs.args, info.seccomp.args, sizeof(child->regs.args));
+            child->regs.valid |= TREGS_ARGS;
+            break;
+        case PTRACE_SYSCALL_INFO_EXIT:
+            child->regs.retval = info.exit.rval;
+            child->regs.valid |= TREGS_RETVAL;
+            break;
+        default:
+            break;
+    }
+#endif // PTRACE_GET_SYSCALL_INFO
+    return true;
+}
+
+void pinkw_regs_clear(struct tchild *child)
+{
+    child->regs.valid = 0;
+    child->regs.subcall = -1;
+}
+
+bool pinkw_get_syscall(struct tchild *child, long *res)
+{
+    if (child->regs.valid & TREGS_ARGS) {
+        *res = child->regs.sno;
+        return true;
+    }
+    return pink_util_get_syscall(child->pid, child->bitness, res);
+}
+
+bool pinkw_get_return(struct tchild *child, long *res)
+{
+    if (child->regs.valid & TREGS_RETVAL) {
+        *res = child->regs.retval;
+        return true;
+    }
+    return pink_util_get_return(child->pid, res);
+}
+
+/* Memory of the children is accessed in bulk with process_vm_readv() and
+ * process_vm_writev(), which need one system call for a whole string where
+ * PTRACE_PEEKDATA needs one per word. If the kernel lacks them, traced children
+ * fall back to ptrace() and notified children to /proc/PID/mem.
+ */
+#ifdef HAVE_PROCESS_VM_READV
+static volatile gboolean pinkw_vm_broken = FALSE;
+#endif // HAVE_PROCESS_VM_READV
+
+static inline bool pinkw_vm_works(void)
+{
+#ifdef HAVE_PROCESS_VM_READV
+    return !pinkw_vm_broken;
+#else
+    return false;
+#endif // HAVE_PROCESS_VM_READV
+}
+
+static ssize_t pinkw_mem_read_slow(struct tchild *child, unsigned long addr, void *buf, size_t len)
+{
+    int fd, save_errno;
+    ssize_t ret;
+    char mem[32];
+
+    if (NULL == child->args)
+        return pink_util_moven(child->pid, addr, buf, len) ? (ssize_t)len : -1;
+
+    snprintf(mem, 32, "/proc/%i/mem", child->pid);
+    if (0 > (fd = open(mem, O_RDONLY)))
+        return -1;
+    ret = pread(fd, buf, len, addr);
+    save_errno = errno;
+    close(fd);
+    errno = save_errno;
+    return ret;
+}
+
+/* Reads the n remote vectors into the n local vectors of the same lengths.
+ * Like process_vm_readv() it stops at the first vector which can't be read
+ * completely and returns the number of bytes read.
+ */
+static ssize_t pinkw_mem_readv(struct tchild *child, const struct iovec *local,
+        const struct iovec *remote, unsigned long n)
+{
+    unsigned long i;
+    ssize_t ret, total;
+
+#ifdef HAVE_PROCESS_VM_READV
+    if (!pinkw_vm_broken) {
+        ret = process_vm_readv(child->pid, local, n, remote, n, 0);
+        if (0 <= ret || ENOSYS != errno)
+            return ret;
+        pinkw_vm_broken = TRUE;
+    }
+#endif // HAVE_PROCESS_VM_READV
+
+    for (i = 0, total = 0; i < n; i++) {
+        ret = pinkw_mem_read_slow(child, (unsigned long)remote[i].iov_base,
+                local[i].iov_base, local[i].iov_len);
+        if (0 > ret)
+            return (0 == total) ? -1 : total;
+        total += ret;
+        if ((size_t)ret != local[i].iov_len)
+            break;
+    }
+    return total;
+}
+
+static ssize_t pinkw_mem_read(struct tchild *child, unsigned long addr, void *buf, size_t len)
+{
+    struct iovec local, remote;
+
+    local.iov_base = buf;
+    local.iov_len = len;
+    remote.iov_base = (void *)addr;
+    remote.iov_len = len;
+    return pinkw_mem_readv(child, &local, &remote, 1);
+}
+
+static bool pinkw_mem_read_all(struct tchild *child, unsigned long addr, void *buf, size_t len)
+{
+    ssize_t ret;
+
+    ret = pinkw_mem_read(child, addr, buf, len);
+    if (0 > ret)
+        return false;
+    else if ((size_t)ret != len) {
+        errno = EFAULT;
+        return false;
+    }
+    return true;
+}
+
+/* Reads the rest of the string at addr, the first len bytes of which are in buf
+ * already and have no terminating zero. The string is read page by page, a
+ * string near the end of a mapping can't be read in one go with a larger
+ * buffer. buf is freed on failure.
+ */
+static char *pinkw_mem_read_string_from(struct tchild *child, unsigned long addr, char *buf, size_t len)
+{
+    long pagesize;
+    size_t n;
+    ssize_t ret;
+
+    pagesize = sysconf(_SC_PAGESIZE);
+    for (;; len += ret) {
+        n = pagesize - ((addr + len) % pagesize);
+        buf = g_realloc(buf, len + n + 1);
+        ret = pinkw_mem_read(child, addr + len, buf + len, n);
+        if (0 >= ret) {
+            if (0 == ret)
+                errno = EFAULT;
+            g_free(buf);
+            return NULL;
+        }
+        if (NULL != memchr(buf + len, '\0', ret))
+            return buf;
+    }
+}
+
+static char *pinkw_mem_read_string(struct tchild *child, unsigned long addr)
+{
+    if (NULL == child->args && !pinkw_vm_works())
+        return pink_util_movestr_persistent(child->pid, addr);
+    return pinkw_mem_read_string_from(child, addr, NULL, 0);
+}
+
+static bool pinkw_mem_read_pointer(struct tchild *child, unsigned long addr, unsigned long *res)
+{
+#if PINKTRACE_BITNESS_COUNT_SUPPORTED == 2
+    guint32 addr32;
+
+    if (PINK_BITNESS_32 == child->bitness) {
+        if (!pinkw_mem_read_all(child, addr, &addr32, sizeof(guint32)))
+            return false;
+        *res = addr32;
+        return true;
+    }
+#endif
+    return pinkw_mem_read_all(child, addr, res, sizeof(unsigned long));
+}
+
+/* Traced children have no fallback here, the caller falls back to
+ * pink_encode_simple() when this fails with ENOSYS.
+ */
+static bool pinkw_mem_write(struct tchild *child, unsigned long addr, const void *buf, size_t len)
+{
+    int fd, save_errno;
+    ssize_t ret;
+    char mem[32];
+#ifdef HAVE_PROCESS_VM_READV
+    struct iovec local, remote;
+
+    if (!pinkw_vm_broken) {
+        local.iov_base = (void *)buf;
+        local.iov_len = len;
+        remote.iov_base = (void *)addr;
+        remote.iov_len = len;
+        ret = process_vm_writev(child->pid, &local, 1, &remote, 1, 0);
+        if (0 <= ret || ENOSYS != errno)
+            goto done;
+        pinkw_vm_broken = TRUE;
+    }
+#endif // HAVE_PROCESS_VM_READV
+
+    if (NULL == child->args) {
+        errno = ENOSYS;
+        return false;
+    }
+
+    snprintf(mem, 32, "/proc/%i/mem", child->pid);
+    if (0 > (fd = open(mem, O_WRONLY)))
+        return false;
+    ret = pwrite(fd, buf, len, addr);
+    save_errno = errno;
+    close(fd);
+    errno = save_errno;
+#ifdef HAVE_PROCESS_VM_READV
+done:
+#endif // HAVE_PROCESS_VM_READV
+    if (0 > ret)
+        return false;
+    else if ((size_t)ret != len) {
+        errno = EFAULT;
+        return false;
+    }
+    return true;
 }
 
-bool pinkw_encode_stat(pid_t pid, pink_bitness_t bitness)
+static inline bool pinkw_is_socketcall(struct tchild *child)
 {
+    return (child->sflags & DECODE_SOCKETCALL);
+}
+
+/* Receives the file descriptor, the address and the address length arguments
+ * of a socket call, socketcall() passes them in an array.
+ * The caller makes sure pinkw_args() isn't NULL.
+ */
+static bool pinkw_socket_args(struct tchild *child, unsigned ind, long *fd,
+        unsigned long *addr, unsigned long *addrlen)
+{
+    unsigned long args;
+    const guint64 *sargs;
+
+    sargs = pinkw_args(child);
+    if (!pinkw_is_socketcall(child)) {
+        if (NULL != fd)
+            *fd = args_get_arg(child, sargs, 0);
+        *addr = args_get_addr(child, sargs, ind);
+        *addrlen = args_get_addr(child, sargs, ind + 1);
+        return true;
+    }
+
+    args = args_get_addr(child, sargs, 1);
+    if (NULL != fd) {
+        unsigned long ufd;
+        if (!pinkw_mem_read_pointer(child, args, &ufd))
+            return false;
+        *fd = (int)ufd;
+    }
+    if (!pinkw_mem_read_pointer(child, args + ind * (child->bitness / 8), addr))
+        return false;
+    return pinkw_mem_read_pointer(child, args + (ind + 1) * (child->bitness / 8), addrlen);
+}
+
+bool pinkw_get_arg(struct tchild *child, unsigned ind, long *res)
+{
+    const guint64 *args;
+
+    if (NULL == (args = pinkw_args(child)))
+        return pink_util_get_arg(child->pid, child->bitness, ind, res);
+    *res = args_get_arg(child, args, ind);
+    return true;
+}
+
+/* Reads the flags of the clone() or clone3() call the child is stopped in at a
+ * fork event, zero for fork() and vfork() which share none of the state
+ * sydbox tracks. The registers are read directly, the snapshot may be of an
+ * earlier stop.
+ * Returns false and sets errno on failure.
+ */
+bool pinkw_get_clone_flags(struct tchild *child, unsigned long *res)
+{
+    long sno, arg;
+    guint64 flags;
+    const char *name;
+
+    if (!pink_util_get_syscall(child->pid, child->bitness, &sno))
+        return false;
+    if (!pink_util_get_arg(child->pid, child->bitness, 0, &arg))
+        return false;
+#if PINKTRACE_BITNESS_COUNT_SUPPORTED == 2
+    if (PINK_BITNESS_32 == child->bitness)
+        arg = (guint32)arg;
+#endif
+
+#if defined(__NR_clone3)
+    /* pinktrace predates clone3(), which has the same number for every bitness.
+     * The flags are the first member of struct clone_args.
+     */
+    if (__NR_clone3 == sno) {
+        if (!pinkw_mem_read_all(child, (unsigned long)arg, &flags, sizeof(guint64)))
+            return false;
+        *res = (unsigned long)flags;
+        return true;
+    }
+#endif // defined(__NR_clone3)
+
+    name = pink_name_syscall(sno, child->bitness);
+    *res = (NULL != name && 0 == strcmp(name, "clone")) ? (unsigned long)arg : 0;
+    return true;
+}
+
+char *pinkw_decode_string_persistent(struct tchild *child, unsigned ind)
+{
+    unsigned failed;
+    char *res;
+
+    if (!pinkw_decode_strings(child, &ind, 1, NULL, &res, &failed))
+        return NULL;
+    return res;
+}
+
+/* Moves the string str read from the heap into arena, if there is one */
+static char *pinkw_adopt_string(struct arena *arena, char *str)
+{
+    char *copy;
+
+    if (NULL == arena || NULL == str)
+        return str;
+    copy = arena_strdup(arena, str);
+    g_free(str);
+    return copy;
+}
+
+bool pinkw_decode_strings(struct tchild *child, const unsigned *inds, unsigned n,
+        struct arena *arena, char **res, unsigned *failed)
+{
+    unsigned i;
+    int save_errno;
+    long pagesize;
+    size_t len;
+    ssize_t ret, got;
+    unsigned long addr[PINKW_STRINGS_MAX];
+    struct iovec local[PINKW_STRINGS_MAX], remote[PINKW_STRINGS_MAX];
+
+    g_assert(n <= PINKW_STRINGS_MAX);
+
+    for (i = 0; i < n; i++)
+        res[i] = NULL;
+    for (i = 0; i < n; i++) {
+        if (!pinkw_get_addr(child, inds[i], &addr[i]))
+            goto fail;
+        if (0 == addr[i]) {
+            errno = 0;
+            goto fail;
+        }
+    }
+
+    if (NULL == child->args && !pinkw_vm_works()) {
+        for (i = 0; i < n; i++) {
+            res[i] = pinkw_adopt_string(arena, pink_util_movestr_persistent(child->pid, addr[i]));
+            if (NULL == res[i])
+                goto fail;
+        }
+        return true;
+    }
+
+    /* Read the first page of every string with a single call, most strings end
+     * there. If this fails, every string is read on its own below which yields
+     * the right errno for the right argument.
+     */
+    pagesize = sysconf(_SC_PAGESIZE);
+    for (i = 0; i < n; i++) {
+        len = pagesize - (addr[i] % pagesize);
+        res[i] = (NULL != arena) ? arena_alloc(arena, len + 1) : g_malloc(len + 1);
+        local[i].iov_base = res[i];
+        local[i].iov_len = len;
+        remote[i].iov_base = (void *)addr[i];
+        remote[i].iov_len = len;
+    }
+    ret = pinkw_mem_readv(child, local, remote, n);
+    got = (0 > ret) ? 0 : ret;
+
+    for (i = 0; i < n; i++) {
+        len = MIN((size_t)got, local[i].iov_len);
+        got -= len;
+        if (0 < len && NULL != memchr(res[i], '\0', len))
+            continue;
+        if (NULL != arena) {
+            /* The rest is read onto the heap, the arena can't grow a string */
+            res[i] = pinkw_adopt_string(arena,
+                    pinkw_mem_read_string_from(child, addr[i], g_memdup(res[i], len), len));
+        }
+        else
+            res[i] = pinkw_mem_read_string_from(child, addr[i], res[i], len);
+        if (NULL == res[i])
+            goto fail;
+    }
+    return true;
+
+fail:
+    save_errno = errno;
+    *failed = i;
+    for (i = 0; i < n; i++) {
+        if (NULL == arena)
+            g_free(res[i]);
+        res[i] = NULL;
+    }
+    errno = save_errno;
+    return false;
+}
+
+/* The subcall is kept in the register snapshot, the exit stop doesn't decode it
+ * again.
+ */
+bool pinkw_decode_socket_call(struct tchild *child, long *subcall)
+{
+    const guint64 *args;
+
+    if (NULL != child->args) {
+        *subcall = args_get_arg(child, child->args, 0);
+        return true;
+    }
+    if (-1 == child->regs.subcall) {
+        if (NULL != (args = pinkw_args(child)))
+            child->regs.subcall = args_get_arg(child, args, 0);
+        else if (!pink_decode_socket_call(child->pid, child->bitness, &child->regs.subcall)) {
+            child->regs.subcall = -1;
+            return false;
+        }
+    }
+    *subcall = child->regs.subcall;
+    return true;
+}
+
+bool pinkw_decode_socket_fd(struct tchild *child, unsigned ind, long *fd)
+{
+    unsigned long ufd;
+    const guint64 *args;
+
+    if (NULL == (args = pinkw_args(child)))
+        return pink_decode_socket_fd(child->pid, child->bitness, ind, fd);
+    if (!pinkw_is_socketcall(child)) {
+        *fd = args_get_arg(child, args, ind);
+        return true;
+    }
+    if (!pinkw_mem_read_pointer(child, args_get_addr(child, args, 1) + ind * (child->bitness / 8), &ufd))
+        return false;
+    *fd = (int)ufd;
+    return true;
+}
+
+bool pinkw_encode_stat(struct tchild *child)
+{
+    unsigned long addr;
     struct stat buf;
 
     memset(&buf, 0, sizeof(struct stat));
@@ -48,42 +650,45 @@ bool pinkw_encode_stat(pid_t pid, pink_bitness_t bitness)
     buf.st_rdev = 259; // /dev/null
     buf.st_mtime = -842745600; // ;)
 
-    return pink_encode_simple(pid, bitness, 1, &buf, sizeof(struct stat));
+    if (!pinkw_get_addr(child, 1, &addr))
+        return false;
+    if (pinkw_mem_write(child, addr, &buf, sizeof(struct stat)))
+        return true;
+    if (NULL == child->args && ENOSYS == errno)
+        return pink_encode_simple(child->pid, child->bitness, 1, &buf, sizeof(struct stat));
+    return false;
 }
 
-struct sydbox_addr *pinkw_get_socket_addr(pid_t pid, pink_bitness_t bitness, unsigned ind, long *fd)
+static struct sydbox_addr *pinkw_convert_addr(const pink_socket_address_t *addr)
 {
-    pink_socket_address_t addr;
+    char path[sizeof(addr->u.sa_un.sun_path) + 1];
     struct sydbox_addr *saddr;
 
-    if (!pink_decode_socket_address(pid, bitness, ind, fd, &addr))
-        return NULL;
-
     saddr = g_new0(struct sydbox_addr, 1);
-    saddr->family = addr.family;
+    saddr->family = addr->family;
     switch (saddr->family) {
         case -1: /* Unknown family */
             return saddr;
         case AF_UNIX:
             saddr->u.saun.exact = true;
-            saddr->u.saun.abstract = (addr.u.sa_un.sun_path[0] == '\0' && addr.u.sa_un.sun_path[1] != '\0');
-            if (saddr->u.saun.abstract)
-                strncpy(saddr->u.saun.sun_path, addr.u.sa_un.sun_path + 1, strlen(addr.u.sa_un.sun_path + 1) + 1);
-            else
-                strncpy(saddr->u.saun.sun_path, addr.u.sa_un.sun_path, strlen(addr.u.sa_un.sun_path) + 1);
+            saddr->u.saun.abstract = (addr->u.sa_un.sun_path[0] == '\0' && addr->u.sa_un.sun_path[1] != '\0');
+            /* The path isn't necessarily null terminated */
+            memcpy(path, addr->u.sa_un.sun_path, sizeof(addr->u.sa_un.sun_path));
+            path[sizeof(addr->u.sa_un.sun_path)] = '\0';
+            address_set_path(saddr, saddr->u.saun.abstract ? path + 1 : path);
             break;
         case AF_INET:
-            saddr->u.sa.port[0] = ntohs(addr.u.sa_in.sin_port);
+            saddr->u.sa.port[0] = ntohs(addr->u.sa_in.sin_port);
             saddr->u.sa.port[1] = saddr->u.sa.port[0];
             saddr->u.sa.netmask = 32;
-            memcpy(&saddr->u.sa.sin_addr, &addr.u.sa_in.sin_addr, sizeof(struct in_addr));
+            memcpy(&saddr->u.sa.sin_addr, &addr->u.sa_in.sin_addr, sizeof(struct in_addr));
             break;
 #if SYDBOX_HAVE_IPV6
         case AF_INET6:
-            saddr->u.sa6.port[0] = ntohs(addr.u.sa6.sin6_port);
+            saddr->u.sa6.port[0] = ntohs(addr->u.sa6.sin6_port);
             saddr->u.sa6.port[1] = saddr->u.sa6.port[0];
             saddr->u.sa6.netmask = 64;
-            memcpy(&saddr->u.sa6.sin6_addr, &addr.u.sa6.sin6_addr, sizeof(struct in6_addr));
+            memcpy(&saddr->u.sa6.sin6_addr, &addr->u.sa6.sin6_addr, sizeof(struct in6_addr));
             break;
 #endif /* SYDBOX_HAVE_IPV6 */
         default:
@@ -93,7 +698,124 @@ struct sydbox_addr *pinkw_get_socket_addr(pid_t pid, pink_bitness_t bitness, uns
     return saddr;
 }
 
-char *pinkw_stringify_argv(pid_t pid, pink_bitness_t bitness, unsigned ind)
+/* Reads the socket address of a socket call like pink_decode_socket_address()
+ * does, using the arguments from pinkw_args().
+ */
+static bool pinkw_socket_address(struct tchild *child, unsigned ind, long *fd, pink_socket_address_t *paddr)
+{
+    unsigned long addr, addrlen;
+
+    if (!pinkw_socket_args(child, ind, fd, &addr, &addrlen))
+        return false;
+
+    memset(paddr, 0, sizeof(pink_socket_address_t));
+    if (0 == addr) {
+        paddr->family = -1;
+        return true;
+    }
+    if (addrlen > sizeof(paddr->u))
+        addrlen = sizeof(paddr->u);
+    paddr->length = addrlen;
+    if (!pinkw_mem_read_all(child, addr, &paddr->u, addrlen))
+        return false;
+    paddr->family = paddr->u.sa_un.sun_family;
+    return true;
+}
+
+struct sydbox_addr *pinkw_get_socket_addr(struct tchild *child, unsigned ind, long *fd)
+{
+    pink_socket_address_t addr;
+
+    if (NULL == pinkw_args(child)) {
+        if (!pink_decode_socket_address(child->pid, child->bitness, ind, fd, &addr))
+            return NULL;
+    }
+    else if (!pinkw_socket_address(child, ind, fd, &addr))
+        return NULL;
+    return pinkw_convert_addr(&addr);
+}
+
+struct sydbox_addr *pinkw_bind(struct tchild *child, bool *called)
+{
+#if defined(SYS_pidfd_open) && defined(SYS_pidfd_getfd)
+    int pidfd, sfd, save_errno;
+    long fd;
+    socklen_t len;
+    pink_socket_address_t addr;
+
+    g_assert(NULL != child->args);
+
+    *called = false;
+    if (!pinkw_socket_address(child, 1, &fd, &addr))
+        return NULL;
+    if (-1 == addr.family) {
+        errno = EFAULT;
+        return NULL;
+    }
+
+    if (0 > (pidfd = syscall(SYS_pidfd_open, child->pid, 0)))
+        return NULL;
+    sfd = syscall(SYS_pidfd_getfd, pidfd, fd, 0);
+    save_errno = errno;
+    close(pidfd);
+    if (0 > sfd) {
+        errno = save_errno;
+        return NULL;
+    }
+
+    /* The copy shares the socket with the child */
+    *called = true;
+    if (0 > bind(sfd, (struct sockaddr *)&addr.u, addr.length)) {
+        save_errno = errno;
+        close(sfd);
+        errno = save_errno;
+        return NULL;
+    }
+    len = sizeof(addr.u);
+    if (0 > getsockname(sfd, (struct sockaddr *)&addr.u, &len)) {
+        /* The socket is bound already, don't fail the system call */
+        save_errno = errno;
+        close(sfd);
+        *called = false;
+        errno = save_errno;
+        return NULL;
+    }
+    close(sfd);
+    addr.length = len;
+    addr.family = addr.u.sa_un.sun_family;
+    return pinkw_convert_addr(&addr);
+#else
+    *called = false;
+    errno = ENOSYS;
+    return NULL;
+#endif
+}
+
+static bool pinkw_decode_argv_member(struct tchild *child, long addr, unsigned i, char *buf, size_t len, bool *nil)
+{
+    unsigned long straddr;
+    char *str;
+
+    if (NULL == child->args && !pinkw_vm_works())
+        return pink_decode_string_array_member(child->pid, child->bitness, addr, i, buf, len, nil);
+
+    if (PINK_BITNESS_32 == child->bitness)
+        addr = (guint32)addr;
+    if (!pinkw_mem_read_pointer(child, (unsigned long)addr + i * (child->bitness / 8), &straddr))
+        return false;
+    if (0 == straddr) {
+        *nil = true;
+        buf[0] = '\0';
+        return true;
+    }
+    if (NULL == (str = pinkw_mem_read_string(child, straddr)))
+        return false;
+    g_strlcpy(buf, str, len);
+    g_free(str);
+    return true;
+}
+
+char *pinkw_stringify_argv(struct tchild *child, unsigned ind)
 {
     bool nil;
     unsigned i;
@@ -103,7 +825,7 @@ char *pinkw_stringify_argv(pid_t pid, pink_bitness_t bitness, unsigned ind)
     const char *sep;
     GString *res;
 
-    if (!pink_util_get_arg(pid, bitness, ind, &addr)) {
+    if (!pinkw_get_arg(child, ind, &addr)) {
         save_errno = errno;
         g_info("failed to get address of argument %d: %s", ind, g_strerror(errno));
         errno = save_errno;
@@ -112,7 +834,7 @@ char *pinkw_stringify_argv(pid_t pid, pink_bitness_t bitness, unsigned ind)
 
     res = g_string_new("");
     for (i = 0, nil = false, sep = "";;sep=", ") {
-        if (!pink_decode_string_array_member(pid, bitness, addr, ++i, buf, 256, &nil)) {
+        if (!pinkw_decode_argv_member(child, addr, ++i, buf, 256, &nil)) {
             g_string_append(res, "...");
             return g_string_free(res, FALSE);
         }
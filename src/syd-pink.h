@@ -24,12 +24,40 @@
 #include <sys/types.h>
 #include <pinktrace/pink.h>
 
+#include "syd-arena.h"
+#include "syd-children.h"
 #include "syd-net.h"
 
-bool pinkw_trace_setup_all(pid_t pid);
-bool pinkw_encode_stat(pid_t pid, pink_bitness_t bitness);
-struct sydbox_addr *pinkw_get_socket_addr(pid_t pid, pink_bitness_t bitness, unsigned ind, long *fd);
-char *pinkw_stringify_argv(pid_t pid, pink_bitness_t bitness, unsigned ind);
+/* Maximum number of strings pinkw_decode_strings() reads at once */
+#define PINKW_STRINGS_MAX 4
+
+/* pinktrace predates PTRACE_SEIZE, so do older C libraries. */
+#define SYDBOX_PTRACE_SEIZE             0x4206
+#define SYDBOX_PTRACE_INTERRUPT         0x4207
+#define SYDBOX_PTRACE_O_EXITKILL        0x00100000
+#define SYDBOX_PTRACE_EVENT_STOP        128
+
+#define SYDBOX_STATUS_EVENT_STOP(status)    \
+    (((status) >> 16) == SYDBOX_PTRACE_EVENT_STOP)
+
+bool pinkw_trace_setup_all(pid_t pid, bool seccomp, bool exitkill);
+bool pinkw_trace_seize(pid_t pid, bool seccomp, bool exitkill);
+bool pinkw_trace_interrupt(pid_t pid);
+bool pinkw_regs_fetch(struct tchild *child, bool entering);
+void pinkw_regs_clear(struct tchild *child);
+bool pinkw_get_syscall(struct tchild *child, long *res);
+bool pinkw_get_return(struct tchild *child, long *res);
+bool pinkw_get_arg(struct tchild *child, unsigned ind, long *res);
+bool pinkw_get_clone_flags(struct tchild *child, unsigned long *res);
+char *pinkw_decode_string_persistent(struct tchild *child, unsigned ind);
+bool pinkw_decode_strings(struct tchild *child, const unsigned *inds, unsigned n,
+        struct arena *arena, char **res, unsigned *failed);
+bool pinkw_decode_socket_call(struct tchild *child, long *subcall);
+bool pinkw_decode_socket_fd(struct tchild *child, unsigned ind, long *fd);
+bool pinkw_encode_stat(struct tchild *child);
+struct sydbox_addr *pinkw_get_socket_addr(struct tchild *child, unsigned ind, long *fd);
+struct sydbox_addr *pinkw_bind(struct tchild *child, bool *called);
+char *pinkw_stringify_argv(struct tchild *child, unsigned ind);
 
 #endif // SYDBOX_GUARD_SYD_PINK_H
 
@@ -21,68 +21,257 @@
 #include "config.h"
 #endif /* HAVE_CONFIG_H */
 
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <glib.h>
 
 #include "syd-proc.h"
 #include "syd-wrappers.h"
 
-char *proc_getcwd(pid_t pid)
+/* Returns the path of the directory /proc/PID/NAME links to.
+ * Paths too long for readlink() are looked up relative to the directory
+ * itself, rooted at /proc/PID/root.
+ */
+static char *proc_getlink(pid_t pid, const char *name)
 {
-    int ret;
-    char *cwd;
-    char linkcwd[64];
+    int fd, rootfd, save_errno;
+    char *dir;
+    char link[128];
 
-    snprintf(linkcwd, 64, "/proc/%i/cwd", pid);
+    snprintf(link, 128, "/proc/%i/%s", pid, name);
 
     // First try ereadlink()
-    cwd = ereadlink(linkcwd);
-    if (G_LIKELY(NULL != cwd))
-        return cwd;
+    dir = ereadlink(link);
+    if (G_LIKELY(NULL != dir))
+        return dir;
     else if (ENAMETOOLONG != errno)
         return NULL;
 
-    // Now try egetcwd()
-    errno = 0;
-    ret = echdir(linkcwd);
-    if (G_LIKELY(0 == ret))
-        return egetcwd();
-    errno = ENAMETOOLONG;
-    return NULL;
+    // Now walk the directory up
+    if (0 > (fd = open(link, O_PATH | O_DIRECTORY)))
+        return NULL;
+    snprintf(link, 128, "/proc/%i/root", pid);
+    if (0 > (rootfd = open(link, O_PATH | O_DIRECTORY))) {
+        save_errno = errno;
+        close(fd);
+        errno = save_errno;
+        return NULL;
+    }
+    dir = edirpath(fd, rootfd);
+    save_errno = errno;
+    close(fd);
+    close(rootfd);
+    errno = save_errno;
+    return dir;
+}
+
+char *proc_getcwd(pid_t pid)
+{
+    return proc_getlink(pid, "cwd");
 }
 
 char *proc_getdir(pid_t pid, int dfd) {
-    int ret;
     char *dir;
-    char linkdir[128];
+    char name[32];
 
-    snprintf(linkdir, 128, "/proc/%i/fd/%d", pid, dfd);
+    snprintf(name, 32, "fd/%d", dfd);
+    dir = proc_getlink(pid, name);
+    if (NULL == dir && ENOENT == errno) {
+        /* The file descriptor doesn't exist!
+         * Correct errno to EBADF.
+         */
+        errno = EBADF;
+    }
+    return dir;
+}
 
-    // First try ereadlink()
-    dir = ereadlink(linkdir);
-    if (G_LIKELY(NULL != dir))
-        return dir;
-    else if (ENAMETOOLONG != errno) {
-        if (ENOENT == errno) {
-            /* The file descriptor doesn't exist!
-             * Correct errno to EBADF.
-             */
-            errno = EBADF;
+/* Reads a pid field, such as Tgid or PPid, of /proc/PID/status.
+ * Returns -1 and sets errno on failure.
+ */
+static pid_t proc_status_pid(pid_t pid, const char *field)
+{
+    size_t len;
+    pid_t ret;
+    char path[32], line[128];
+    FILE *fp;
+
+    snprintf(path, 32, "/proc/%i/status", pid);
+    if (NULL == (fp = fopen(path, "r")))
+        return -1;
+
+    ret = -1;
+    len = strlen(field);
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        if (0 == strncmp(line, field, len) && ':' == line[len]) {
+            ret = atoi(line + len + 1);
+            break;
         }
+    }
+    fclose(fp);
+    if (-1 == ret)
+        errno = EINVAL;
+    return ret;
+}
+
+pid_t proc_tgid(pid_t pid)
+{
+    return proc_status_pid(pid, "Tgid");
+}
+
+pid_t proc_ppid(pid_t pid)
+{
+    return proc_status_pid(pid, "PPid");
+}
+
+/* Returns the start time of the process, field 22 of /proc/PID/stat, in clock
+ * ticks after boot. Together with the pid it tells a process apart from the
+ * one it recycled the pid of.
+ * Returns zero and sets errno on failure.
+ */
+guint64 proc_starttime(pid_t pid)
+{
+    int fd, i;
+    ssize_t len;
+    char path[32], buf[1024];
+    char *p;
+
+    snprintf(path, 32, "/proc/%i/stat", pid);
+    if (0 > (fd = open(path, O_RDONLY | O_CLOEXEC)))
+        return 0;
+    len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (0 >= len)
+        return 0;
+    buf[len] = '\0';
+
+    /* The command name may contain spaces and parentheses */
+    if (NULL == (p = strrchr(buf, ')')))
+        goto inval;
+    for (i = 0; i < 20; i++) {
+        if (NULL == (p = strchr(p + 1, ' ')))
+            goto inval;
+    }
+    return strtoull(p + 1, NULL, 10);
+inval:
+    errno = EINVAL;
+    return 0;
+}
+
+/* Returns the inode of the socket the file descriptor of the process refers
+ * to, zero and sets errno if it's closed or not a socket.
+ */
+unsigned long proc_socket_inode(pid_t pid, long fd)
+{
+    char name[64];
+    struct stat buf;
+
+    snprintf(name, 64, "/proc/%i/fd/%ld", pid, fd);
+    if (0 > stat(name, &buf))
+        return 0;
+    if (!S_ISSOCK(buf.st_mode)) {
+        errno = ENOTSOCK;
+        return 0;
+    }
+    return buf.st_ino;
+}
+
+/* Lists the threads of the process, read from /proc/PID/task.
+ * Returns NULL and sets errno on failure.
+ */
+GSList *proc_tasks(pid_t pid)
+{
+    char path[32];
+    GSList *tasks;
+    DIR *dir;
+    struct dirent *ent;
+
+    snprintf(path, 32, "/proc/%i/task", pid);
+    if (NULL == (dir = opendir(path)))
         return NULL;
+
+    tasks = NULL;
+    while (NULL != (ent = readdir(dir))) {
+        if ('.' == ent->d_name[0])
+            continue;
+        tasks = g_slist_prepend(tasks, GINT_TO_POINTER(atoi(ent->d_name)));
     }
+    closedir(dir);
+    return tasks;
+}
 
-    // Now try egetcwd()
-    errno = 0;
-    ret = echdir(linkdir);
-    if (G_LIKELY(0 == ret))
-        return egetcwd();
-    errno = ENAMETOOLONG;
-    return NULL;
+/* Lists the children of the process, read from /proc/PID/task/TID/children
+ * which requires CONFIG_PROC_CHILDREN. Without it every process in /proc is
+ * checked for its parent.
+ */
+GSList *proc_children(pid_t pid)
+{
+    int child;
+    char path[64];
+    GSList *tasks, *walk, *children;
+    DIR *dir;
+    FILE *fp;
+    struct dirent *ent;
+
+    children = NULL;
+    tasks = proc_tasks(pid);
+    for (walk = tasks; NULL != walk; walk = g_slist_next(walk)) {
+        snprintf(path, 64, "/proc/%i/task/%i/children", pid, GPOINTER_TO_INT(walk->data));
+        if (NULL == (fp = fopen(path, "r"))) {
+            if (ENOENT == errno && walk == tasks)
+                goto scan;
+            continue;
+        }
+        while (1 == fscanf(fp, "%d", &child))
+            children = g_slist_prepend(children, GINT_TO_POINTER(child));
+        fclose(fp);
+    }
+    g_slist_free(tasks);
+    return children;
+
+scan:
+    g_slist_free(tasks);
+    if (NULL == (dir = opendir("/proc")))
+        return NULL;
+    while (NULL != (ent = readdir(dir))) {
+        if (!g_ascii_isdigit(ent->d_name[0]))
+            continue;
+        child = atoi(ent->d_name);
+        if (proc_ppid(child) == pid)
+            children = g_slist_prepend(children, GINT_TO_POINTER(child));
+    }
+    closedir(dir);
+    return children;
 }
 
+/* Returns the arguments of the process as a NULL-terminated vector, empty for
+ * zombies. Free it with g_strfreev().
+ * Returns NULL and sets errno on failure.
+ */
+gchar **proc_cmdline(pid_t pid)
+{
+    gsize len;
+    gchar *contents;
+    char path[32];
+    GPtrArray *argv;
+
+    snprintf(path, 32, "/proc/%i/cmdline", pid);
+    if (!g_file_get_contents(path, &contents, &len, NULL)) {
+        errno = ESRCH;
+        return NULL;
+    }
+
+    argv = g_ptr_array_new();
+    for (gsize i = 0; i < len; i += strlen(contents + i) + 1)
+        g_ptr_array_add(argv, g_strdup(contents + i));
+    g_ptr_array_add(argv, NULL);
+    g_free(contents);
+    return (gchar **)g_ptr_array_free(argv, FALSE);
+}
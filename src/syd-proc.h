@@ -23,9 +23,25 @@
 
 #include <sys/types.h>
 
+#include <glib.h>
+
 char *proc_getcwd(pid_t pid);
 
 char *proc_getdir(pid_t pid, int dfd);
 
+pid_t proc_tgid(pid_t pid);
+
+pid_t proc_ppid(pid_t pid);
+
+guint64 proc_starttime(pid_t pid);
+
+unsigned long proc_socket_inode(pid_t pid, long fd);
+
+GSList *proc_tasks(pid_t pid);
+
+GSList *proc_children(pid_t pid);
+
+gchar **proc_cmdline(pid_t pid);
+
 #endif /* !SYDBOX_GUARD_PROC_H */
 
@@ -0,0 +1,393 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+
+#if SYDBOX_HAVE_SECCOMP
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#endif // SYDBOX_HAVE_SECCOMP
+
+#include <glib.h>
+#include <pinktrace/pink.h>
+
+#include "syd-dispatch.h"
+#include "syd-log.h"
+#include "syd-seccomp.h"
+
+#if SYDBOX_HAVE_SECCOMP
+
+#ifndef PR_SET_NO_NEW_PRIVS
+#define PR_SET_NO_NEW_PRIVS 38
+#endif
+
+/* Audit architectures of the personalities pinktrace supports */
+#if defined(__x86_64__)
+#define SECCOMP_ARCH32      AUDIT_ARCH_I386
+#define SECCOMP_ARCH64      AUDIT_ARCH_X86_64
+#define SECCOMP_X32_BIT     0x40000000
+#elif defined(__i386__)
+#define SECCOMP_ARCH32      AUDIT_ARCH_I386
+#elif defined(__powerpc64__)
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SECCOMP_ARCH64      AUDIT_ARCH_PPC64LE
+#else
+#define SECCOMP_ARCH32      AUDIT_ARCH_PPC
+#define SECCOMP_ARCH64      AUDIT_ARCH_PPC64
+#endif
+#elif defined(__powerpc__)
+#define SECCOMP_ARCH32      AUDIT_ARCH_PPC
+#elif defined(__ia64__)
+#define SECCOMP_ARCH64      AUDIT_ARCH_IA64
+#endif
+
+#if defined(SECCOMP_ARCH32) || defined(SECCOMP_ARCH64)
+
+/* The kernel must report seccomp stops after the syscall-enter-stop, and let
+ * the tracer change the system call number, which it does since 4.8
+ */
+#define SECCOMP_KERNEL_MAJOR 4
+#define SECCOMP_KERNEL_MINOR 8
+
+/* The seccomp-notify backend needs SECCOMP_USER_NOTIF_FLAG_CONTINUE, which is
+ * available since 5.5
+ */
+#define SECCOMP_NOTIFY_KERNEL_MAJOR 5
+#define SECCOMP_NOTIFY_KERNEL_MINOR 5
+
+static void seccomp_append(GArray *prog, guint16 code, guint8 jt, guint8 jf, guint32 k)
+{
+    struct sock_filter insn;
+
+    insn.code = code;
+    insn.jt = jt;
+    insn.jf = jf;
+    insn.k = k;
+    g_array_append_val(prog, insn);
+}
+
+/* Appends a block that matches the system calls in list for the given
+ * architecture:
+ *   ld arch; jeq arch ? next : skip the block
+ *   ld nr; [jge x32 bit ? action]; jeq nr[0] ? action; ...; ret allow; ret action
+ */
+static void seccomp_append_arch(GArray *prog, guint32 arch, GArray *list, bool x32, guint32 action)
+{
+    guint n, len;
+
+    n = list->len;
+    len = n + (x32 ? 4 : 3);
+    g_assert(len <= G_MAXUINT8);
+
+    seccomp_append(prog, BPF_LD | BPF_W | BPF_ABS, 0, 0, offsetof(struct seccomp_data, arch));
+    seccomp_append(prog, BPF_JMP | BPF_JEQ | BPF_K, 0, len, arch);
+    seccomp_append(prog, BPF_LD | BPF_W | BPF_ABS, 0, 0, offsetof(struct seccomp_data, nr));
+#ifdef SECCOMP_X32_BIT
+    if (x32)
+        seccomp_append(prog, BPF_JMP | BPF_JGE | BPF_K, n + 1, 0, SECCOMP_X32_BIT);
+#endif
+    for (guint i = 0; i < n; i++)
+        seccomp_append(prog, BPF_JMP | BPF_JEQ | BPF_K, n - i, 0, g_array_index(list, int, i));
+    seccomp_append(prog, BPF_RET | BPF_K, 0, 0, SECCOMP_RET_ALLOW);
+    seccomp_append(prog, BPF_RET | BPF_K, 0, 0, action);
+}
+
+/* Builds a filter that returns action for the system calls sydbox checks.
+ * need_exit adds the system calls which are only handled on exit, which is
+ * only possible with ptrace, otherwise exit_group() is added, where the
+ * seccomp-notify backend adopts the children of the exiting process.
+ */
+static GArray *seccomp_build(guint32 action, bool need_exit)
+{
+    GArray *prog, *list;
+
+    prog = g_array_new(FALSE, FALSE, sizeof(struct sock_filter));
+#if PINKTRACE_BITNESS_COUNT_SUPPORTED == 1
+    list = dispatch_trace_list(need_exit);
+#if defined(SECCOMP_ARCH64)
+    seccomp_append_arch(prog, SECCOMP_ARCH64, list, false, action);
+#else
+    seccomp_append_arch(prog, SECCOMP_ARCH32, list, false, action);
+#endif
+    g_array_free(list, TRUE);
+#elif PINKTRACE_BITNESS_COUNT_SUPPORTED == 2
+    list = dispatch_trace_list64(need_exit);
+#ifdef SECCOMP_X32_BIT
+    seccomp_append_arch(prog, SECCOMP_ARCH64, list, true, action);
+#else
+    seccomp_append_arch(prog, SECCOMP_ARCH64, list, false, action);
+#endif
+    g_array_free(list, TRUE);
+#if defined(SECCOMP_ARCH32)
+    list = dispatch_trace_list32(need_exit);
+    seccomp_append_arch(prog, SECCOMP_ARCH32, list, false, action);
+    g_array_free(list, TRUE);
+#endif
+#endif
+    /* Unknown architecture, let sydbox have a look */
+    seccomp_append(prog, BPF_RET | BPF_K, 0, 0, action);
+
+    return prog;
+}
+
+static bool seccomp_kernel_check(int req_major, int req_minor, const char *what)
+{
+    int major, minor;
+    struct utsname buf;
+
+    if (0 > uname(&buf) || 2 != sscanf(buf.release, "%d.%d", &major, &minor))
+        return false;
+    if (major < req_major || (major == req_major && minor < req_minor)) {
+        g_info("kernel %s is too old for %s", buf.release, what);
+        return false;
+    }
+    return true;
+}
+
+bool seccomp_supported(void)
+{
+    int status;
+    pid_t pid;
+
+    if (!seccomp_kernel_check(SECCOMP_KERNEL_MAJOR, SECCOMP_KERNEL_MINOR, "seccomp prefiltering"))
+        return false;
+
+    /* Check whether we're allowed to install a filter at all */
+    if (0 > (pid = fork()))
+        return false;
+    if (0 == pid) {
+        struct sock_filter allow = BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+        struct sock_fprog fprog;
+
+        fprog.len = 1;
+        fprog.filter = &allow;
+        if (0 > prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0))
+            _exit(EXIT_FAILURE);
+        _exit((0 == prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog)) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    while (0 > waitpid(pid, &status, 0)) {
+        if (EINTR != errno)
+            return false;
+    }
+    if (!WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status)) {
+        g_info("kernel doesn't allow installing seccomp filters");
+        return false;
+    }
+    return true;
+}
+
+int seccomp_apply(void)
+{
+    int ret, save_errno;
+    GArray *prog;
+    struct sock_fprog fprog;
+
+    prog = seccomp_build(SECCOMP_RET_TRACE, true);
+    fprog.len = prog->len;
+    fprog.filter = (struct sock_filter *)prog->data;
+
+    ret = prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog);
+    if (0 > ret && EACCES == errno) {
+        /* Without CAP_SYS_ADMIN the filter requires no_new_privs. This is
+         * harmless, the kernel already ignores set-id bits of a process traced
+         * by an unprivileged tracer.
+         */
+        if (0 == prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0))
+            ret = prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog);
+    }
+
+    save_errno = errno;
+    g_array_free(prog, TRUE);
+    errno = save_errno;
+    return ret;
+}
+
+#if defined(SECCOMP_USER_NOTIF_FLAG_CONTINUE) && defined(__NR_seccomp)
+
+static int seccomp_new_listener(struct sock_fprog *fprog)
+{
+    return syscall(__NR_seccomp, SECCOMP_SET_MODE_FILTER, SECCOMP_FILTER_FLAG_NEW_LISTENER, fprog);
+}
+
+bool seccomp_notify_supported(void)
+{
+    int status;
+    pid_t pid;
+
+    if (!seccomp_kernel_check(SECCOMP_NOTIFY_KERNEL_MAJOR, SECCOMP_NOTIFY_KERNEL_MINOR,
+                "the seccomp-notify backend"))
+        return false;
+
+    /* Check whether we're allowed to install a listener at all */
+    if (0 > (pid = fork()))
+        return false;
+    if (0 == pid) {
+        struct sock_filter allow = BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+        struct sock_fprog fprog;
+
+        fprog.len = 1;
+        fprog.filter = &allow;
+        if (0 > prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0))
+            _exit(EXIT_FAILURE);
+        _exit((0 <= seccomp_new_listener(&fprog)) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    while (0 > waitpid(pid, &status, 0)) {
+        if (EINTR != errno)
+            return false;
+    }
+    if (!WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status)) {
+        g_info("kernel doesn't allow installing seccomp listeners");
+        return false;
+    }
+    return true;
+}
+
+pink_bitness_t seccomp_bitness(guint32 arch, int nr)
+{
+    switch (arch) {
+#if defined(SECCOMP_ARCH64)
+        case SECCOMP_ARCH64:
+#ifdef SECCOMP_X32_BIT
+            if (nr & SECCOMP_X32_BIT)
+                return PINK_BITNESS_UNKNOWN;
+#endif
+            return PINK_BITNESS_64;
+#endif
+#if defined(SECCOMP_ARCH32)
+        case SECCOMP_ARCH32:
+            return PINK_BITNESS_32;
+#endif
+        default:
+            return PINK_BITNESS_UNKNOWN;
+    }
+}
+
+int seccomp_notify_apply(void)
+{
+    int fd, save_errno;
+    GArray *prog;
+    struct sock_fprog fprog;
+
+    prog = seccomp_build(SECCOMP_RET_USER_NOTIF, false);
+    fprog.len = prog->len;
+    fprog.filter = (struct sock_filter *)prog->data;
+
+    /* There is no tracer to ignore set-id bits, so no_new_privs is required
+     * even with CAP_SYS_ADMIN.
+     */
+    fd = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+    if (0 == fd)
+        fd = seccomp_new_listener(&fprog);
+
+    save_errno = errno;
+    g_array_free(prog, TRUE);
+    errno = save_errno;
+    return fd;
+}
+
+#else
+
+bool seccomp_notify_supported(void)
+{
+    g_info("seccomp-notify backend isn't supported by the kernel headers");
+    return false;
+}
+
+int seccomp_notify_apply(void)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif // defined(SECCOMP_USER_NOTIF_FLAG_CONTINUE) && defined(__NR_seccomp)
+
+#else
+
+bool seccomp_supported(void)
+{
+    g_info("seccomp prefiltering isn't supported on this architecture");
+    return false;
+}
+
+int seccomp_apply(void)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+bool seccomp_notify_supported(void)
+{
+    g_info("seccomp-notify backend isn't supported on this architecture");
+    return false;
+}
+
+pink_bitness_t seccomp_bitness(G_GNUC_UNUSED guint32 arch, G_GNUC_UNUSED int nr)
+{
+    return PINK_BITNESS_UNKNOWN;
+}
+
+int seccomp_notify_apply(void)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif // defined(SECCOMP_ARCH32) || defined(SECCOMP_ARCH64)
+
+#else
+
+bool seccomp_supported(void)
+{
+    return false;
+}
+
+int seccomp_apply(void)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+bool seccomp_notify_supported(void)
+{
+    g_info("seccomp-notify backend needs seccomp support");
+    return false;
+}
+
+int seccomp_notify_apply(void)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif // SYDBOX_HAVE_SECCOMP
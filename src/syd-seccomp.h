@@ -0,0 +1,43 @@
+/* vim: set sw=4 sts=4 et foldmethod=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SYDBOX_GUARD_SECCOMP_H
+#define SYDBOX_GUARD_SECCOMP_H 1
+
+#include <stdbool.h>
+#include <signal.h>
+
+#include <glib.h>
+#include <pinktrace/pink.h>
+
+/* pinktrace doesn't know about seccomp, neither do older C libraries. */
+#define SYDBOX_PTRACE_O_TRACESECCOMP    0x00000080
+#define SYDBOX_PTRACE_EVENT_SECCOMP     7
+
+#define SYDBOX_STATUS_SECCOMP(status)   \
+    (((status) >> 8) == (SIGTRAP | (SYDBOX_PTRACE_EVENT_SECCOMP << 8)))
+
+bool seccomp_supported(void);
+int seccomp_apply(void);
+
+bool seccomp_notify_supported(void);
+int seccomp_notify_apply(void);
+pink_bitness_t seccomp_bitness(guint32 arch, int nr);
+
+#endif // SYDBOX_GUARD_SECCOMP_H
@@ -41,6 +41,7 @@
 #include <glib.h>
 #include <pinktrace/pink.h>
 
+#include "syd-arena.h"
 #include "syd-config.h"
 #include "syd-flags.h"
 #include "syd-dispatch.h"
@@ -70,7 +71,11 @@ enum {
     RS_ERROR = EX_SOFTWARE
 };
 
+/* Initial size of the arena of a thread checking system calls */
+#define SYSCALL_ARENA_SIZE          (16 * 1024)
+
 struct checkdata {
+    struct arena *arena;        // Arguments are allocated from here, reset by syscall_check_finalize()
     gint result;                // Check result
     gint save_errno;            // errno when the result is RS_ERROR
 
@@ -78,62 +83,101 @@ struct checkdata {
     glong open_flags;           // flags argument of open()/openat()
     glong access_flags;         // flags argument of access()/faccessat()
     gchar *sargv;               // argv[] list of execve() call stringified
-    gchar *dirfdlist[2];        // dirfd arguments (resolved)
-    gchar *pathlist[4];         // Path arguments
+    gchar *dirfdlist[2];        // dirfd arguments (resolved, in arena)
+    gchar *pathlist[4];         // Path arguments (in arena)
     gchar *rpathlist[4];        // Path arguments (canonicalized)
 
     long subcall;               // Socketcall() subcall
     struct sydbox_addr *addr;   // Destination address of socket call
+
+    long sno;                   // System call number
+    int sflags;                 // Dispatch flags of the system call
+    const char *sname;          // Name of the system call (or socket subcall)
 };
 
-static long sno;
-static int sflags;
-static const char *sname;
+/* Every thread checking system calls has an arena, the ptrace backend has one
+ * thread and every worker of the seccomp-notify backend has its own.
+ */
+static GStaticPrivate syscall_arena_key = G_STATIC_PRIVATE_INIT;
+
+static void syscall_arena_free(gpointer arena_ptr)
+{
+    struct arena *arena = (struct arena *) arena_ptr;
+
+    arena_free(arena);
+    g_free(arena);
+}
 
-/* Receive the path argument at position narg of child with given pid and
- * update data.
+static struct arena *syscall_arena(void)
+{
+    struct arena *arena;
+
+    arena = g_static_private_get(&syscall_arena_key);
+    if (G_UNLIKELY(NULL == arena)) {
+        arena = g_new(struct arena, 1);
+        arena_init(arena, SYSCALL_ARENA_SIZE);
+        g_static_private_set(&syscall_arena_key, arena, syscall_arena_free);
+    }
+    return arena;
+}
+
+/* Receive the path arguments at the n positions in narg of the given child and
+ * update data. The strings are read together, see pinkw_decode_strings().
  * Returns FALSE and sets data->result to RS_ERROR and data->save_errno to
  * errno on failure.
- * Returns TRUE and updates data->pathlist[narg] on success.
+ * Returns TRUE and updates data->pathlist[narg[i]] on success.
  */
-static bool syscall_get_path(pid_t pid, pink_bitness_t bitness, int narg, struct checkdata *data)
+static bool syscall_get_paths(struct tchild *child, const unsigned *narg, unsigned n, struct checkdata *data)
 {
+    unsigned i;
+    char *paths[PINKW_STRINGS_MAX];
+
     errno = 0;
-    data->pathlist[narg] = pink_decode_string_persistent(pid, bitness, narg);
-    if (G_UNLIKELY(NULL == data->pathlist[narg])) {
+    if (G_UNLIKELY(!pinkw_decode_strings(child, narg, n, data->arena, paths, &i))) {
         data->result = RS_ERROR;
         if (errno) {
             data->save_errno = errno;
             if (ESRCH == errno)
-                g_debug("failed to grab string from argument %d: %s", narg, g_strerror(errno));
+                g_debug("failed to grab string from argument %u: %s", narg[i], g_strerror(errno));
             else
-                g_warning("failed to grab string from argument %d: %s", narg, g_strerror(errno));
+                g_warning("failed to grab string from argument %u: %s", narg[i], g_strerror(errno));
         }
         else {
             data->save_errno = EFAULT;
-            g_debug("path argument %d is NULL", narg);
+            g_debug("path argument %u is NULL", narg[i]);
         }
         return false;
     }
-    g_debug("path argument %d is `%s'", narg, data->pathlist[narg]);
+    for (i = 0; i < n; i++) {
+        data->pathlist[narg[i]] = paths[i];
+        g_debug("path argument %u is `%s'", narg[i], paths[i]);
+    }
     return true;
 }
 
+static inline bool syscall_get_path(struct tchild *child, unsigned narg, struct checkdata *data)
+{
+    return syscall_get_paths(child, &narg, 1, data);
+}
+
 /* Receive dirfd argument at position narg of the given child and update data.
  * Returns FALSE and sets data->result to RS_ERROR and data->save_errno to
  * errno on failure.
- * If dirfd is AT_FDCWD it copies child->cwd to data->dirfdlist[narg].
+ * If dirfd is AT_FDCWD it copies the current working directory of the child
+ * to data->dirfdlist[narg].
  * Otherwise tries to determine the directory using proc_getdir().
- * If proc_getdir() fails it sets data->result to RS_DENY and child->retval to
- * -errno and returns FALSE.
+ * If this fails it sets data->result to RS_DENY and child->retval to -errno
+ * and returns FALSE.
  * On success TRUE is returned and data->dirfdlist[narg] contains the directory
- * information about dirfd. This string should be freed after use.
+ * information about dirfd. This string is allocated from data->arena.
  */
 static bool syscall_get_dirfd(struct tchild *child, int narg, struct checkdata *data)
 {
     long dfd;
+    char *dir;
+    const char *cwd;
 
-    if (G_UNLIKELY(!pink_util_get_arg(child->pid, child->bitness, narg, &dfd))) {
+    if (G_UNLIKELY(!pinkw_get_arg(child, narg, &dfd))) {
         data->result = RS_ERROR;
         data->save_errno = errno;
         if (ESRCH == errno)
@@ -144,32 +188,41 @@ static bool syscall_get_dirfd(struct tchild *child, int narg, struct checkdata *
     }
 
     if (AT_FDCWD != dfd) {
-        data->dirfdlist[narg] = proc_getdir(child->pid, dfd);
-        if (NULL == data->dirfdlist[narg]) {
+        if (NULL == (dir = proc_getdir(child->pid, dfd))) {
             data->result = RS_DENY;
             child->retval = -errno;
             g_debug("proc_getdir() failed: %s", g_strerror(errno));
-            g_debug("denying access to system call %lu(%s)", sno, sname);
+            g_debug("denying access to system call %lu(%s)", data->sno, data->sname);
             return false;
         }
+        data->dirfdlist[narg] = arena_strdup(data->arena, dir);
+        g_free(dir);
+    }
+    else {
+        if (NULL == (cwd = tchild_getcwd(child))) {
+            data->result = RS_DENY;
+            child->retval = -errno;
+            g_debug("proc_getcwd() failed: %s", g_strerror(errno));
+            g_debug("denying access to system call %lu(%s)", data->sno, data->sname);
+            return false;
+        }
+        data->dirfdlist[narg] = arena_strdup(data->arena, cwd);
     }
-    else
-        data->dirfdlist[narg] = g_strdup(child->cwd);
     return true;
 }
 
 static bool syscall_decode_net(struct tchild *child, struct checkdata *data)
 {
-    if (!pink_decode_socket_call(child->pid, child->bitness, &data->subcall)) {
+    if (!pinkw_decode_socket_call(child, &data->subcall)) {
         data->result = RS_ERROR;
         data->save_errno = errno;
         return false;
     }
 
-    sname = pink_name_socket_subcall(data->subcall);
-    g_debug("Decoded socket subcall is %ld(%s)", data->subcall, sname);
+    data->sname = pink_name_socket_subcall(data->subcall);
+    g_debug("Decoded socket subcall is %ld(%s)", data->subcall, data->sname);
     if (data->subcall == PINK_SOCKET_SUBCALL_BIND || data->subcall == PINK_SOCKET_SUBCALL_CONNECT) {
-        data->addr = pinkw_get_socket_addr(child->pid, child->bitness, 1, NULL);
+        data->addr = pinkw_get_socket_addr(child, 1, NULL);
         if (data->addr == NULL) {
             data->result = RS_ERROR;
             data->save_errno = errno;
@@ -177,7 +230,7 @@ static bool syscall_decode_net(struct tchild *child, struct checkdata *data)
         }
     }
     else if (data->subcall == PINK_SOCKET_SUBCALL_SENDTO) {
-        data->addr = pinkw_get_socket_addr(child->pid, child->bitness, 4, NULL);
+        data->addr = pinkw_get_socket_addr(child, 4, NULL);
         if (data->addr == NULL) {
             data->result = RS_ERROR;
             data->save_errno = errno;
@@ -189,12 +242,12 @@ static bool syscall_decode_net(struct tchild *child, struct checkdata *data)
 
 static bool syscall_getaddr_net(struct tchild *child, struct checkdata *data)
 {
-    if (sflags & DECODE_SOCKETCALL)
+    if (data->sflags & DECODE_SOCKETCALL)
         return syscall_decode_net(child, data);
-    else if (sflags & (BIND_CALL | CONNECT_CALL))
-        data->addr = pinkw_get_socket_addr(child->pid, child->bitness, 1, NULL);
-    else if (sflags & SENDTO_CALL)
-        data->addr = pinkw_get_socket_addr(child->pid, child->bitness, 4, NULL);
+    else if (data->sflags & (BIND_CALL | CONNECT_CALL))
+        data->addr = pinkw_get_socket_addr(child, 1, NULL);
+    else if (data->sflags & SENDTO_CALL)
+        data->addr = pinkw_get_socket_addr(child, 4, NULL);
     else
         return true;
 
@@ -211,45 +264,49 @@ static bool syscall_getaddr_net(struct tchild *child, struct checkdata *data)
  */
 static void syscall_check_start(G_GNUC_UNUSED context_t *ctx, struct tchild *child, struct checkdata *data)
 {
-    g_debug("starting check for system call %lu(%s), child %i", sno, sname, child->pid);
+    unsigned n, narg[PINKW_STRINGS_MAX];
+
+    g_debug("starting check for system call %lu(%s), child %i", data->sno, data->sname, child->pid);
+
+    if (data->sflags & CHANGES_PATHS)
+        canonicalize_cache_flush();
+
+    /* Paths of system calls like rename() and linkat() are read at once */
+    n = 0;
+    if (data->sflags & (CHECK_PATH | MAGIC_STAT))
+        narg[n++] = 0;
+    if (data->sflags & (CHECK_PATH2 | CHECK_PATH_AT))
+        narg[n++] = 1;
+    if (data->sflags & CHECK_PATH_AT1)
+        narg[n++] = 2;
+    if (data->sflags & CHECK_PATH_AT2)
+        narg[n++] = 3;
+    if (0 < n && !syscall_get_paths(child, narg, n, data))
+        return;
 
-    if (sflags & (CHECK_PATH | MAGIC_STAT)) {
-        if (!syscall_get_path(child->pid, child->bitness, 0, data))
-            return;
-    }
-    if (sflags & CHECK_PATH2) {
-        if (!syscall_get_path(child->pid, child->bitness, 1, data))
-            return;
-    }
-    if (sflags & CHECK_PATH_AT) {
-        if (!syscall_get_path(child->pid, child->bitness, 1, data))
-            return;
+    if (data->sflags & CHECK_PATH_AT) {
         if (!g_path_is_absolute(data->pathlist[1]) && !syscall_get_dirfd(child, 0, data))
             return;
     }
-    if (sflags & CHECK_PATH_AT1) {
-        if (!syscall_get_path(child->pid, child->bitness, 2, data))
-            return;
+    if (data->sflags & CHECK_PATH_AT1) {
         if (!g_path_is_absolute(data->pathlist[2]) && !syscall_get_dirfd(child, 1, data))
             return;
     }
-    if (sflags & CHECK_PATH_AT2) {
-        if (!syscall_get_path(child->pid, child->bitness, 3, data))
-            return;
+    if (data->sflags & CHECK_PATH_AT2) {
         if (!g_path_is_absolute(data->pathlist[3]) && !syscall_get_dirfd(child, 2, data))
             return;
     }
 #if 0
-    if (child->sandbox->exec && sflags & EXEC_CALL) {
+    if (child->group->sandbox->exec && data->sflags & EXEC_CALL) {
 #endif
-    if (sflags & EXEC_CALL) {
-        if (!syscall_get_path(child->pid, child->bitness, 0, data))
+    if (data->sflags & EXEC_CALL) {
+        if (!syscall_get_path(child, 0, data))
             return;
-        if ((data->sargv = pinkw_stringify_argv(child->pid, child->bitness, 1)) == NULL)
+        if ((data->sargv = pinkw_stringify_argv(child, 1)) == NULL)
             return;
-        g_string_printf(child->lastexec, "execve(\"%s\", [%s])", data->pathlist[0], data->sargv);
+        g_string_printf(tchild_lastexec(child), "execve(\"%s\", [%s])", data->pathlist[0], data->sargv);
     }
-    if (child->sandbox->network) {
+    if (child->group->sandbox->network) {
         if (!syscall_getaddr_net(child, data))
             return;
     }
@@ -273,12 +330,12 @@ static void syscall_check_flags(struct tchild *child, struct checkdata *data)
 {
     if (G_UNLIKELY(RS_ALLOW != data->result))
         return;
-    else if (!(sflags & (OPEN_MODE | OPEN_MODE_AT | ACCESS_MODE | ACCESS_MODE_AT)))
+    else if (!(data->sflags & (OPEN_MODE | OPEN_MODE_AT | ACCESS_MODE | ACCESS_MODE_AT)))
         return;
 
-    if (sflags & (OPEN_MODE | OPEN_MODE_AT)) {
-        int arg = sflags & OPEN_MODE ? 1 : 2;
-        if (G_UNLIKELY(!pink_util_get_arg(child->pid, child->bitness, arg, &data->open_flags))) {
+    if (data->sflags & (OPEN_MODE | OPEN_MODE_AT)) {
+        int arg = data->sflags & OPEN_MODE ? 1 : 2;
+        if (G_UNLIKELY(!pinkw_get_arg(child, arg, &data->open_flags))) {
             data->result = RS_ERROR;
             data->save_errno = errno;
             if (ESRCH == errno)
@@ -291,8 +348,8 @@ static void syscall_check_flags(struct tchild *child, struct checkdata *data)
             data->result = RS_NOWRITE;
     }
     else {
-        int arg = sflags & ACCESS_MODE ? 1 : 2;
-        if (G_UNLIKELY(!pink_util_get_arg(child->pid, child->bitness, arg, &data->access_flags))) {
+        int arg = data->sflags & ACCESS_MODE ? 1 : 2;
+        if (G_UNLIKELY(!pinkw_get_arg(child, arg, &data->access_flags))) {
             data->result = RS_ERROR;
             data->save_errno = errno;
             if (ESRCH == errno)
@@ -318,7 +375,6 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
     char *path = data->pathlist[0];
     const char *rpath;
     char *rpath_sanitized;
-    GSList *walk, *whitelist;
     char **expaddr;
     struct sydbox_addr *addr;
 
@@ -334,32 +390,37 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
     else if (path_magic_api_match(path)) {
         data->result = RS_MAGIC;
     }
-    else if (child->sandbox->path && path_magic_enabled(path)) {
+    else if (child->group->sandbox->path && path_magic_enabled(path)) {
         data->result = RS_MAGIC;
     }
     else if (path_magic_on(path)) {
         data->result = RS_MAGIC;
-        child->sandbox->path = true;
+        tchild_unshare(child);
+        child->group->sandbox->path = true;
         g_info("path sandboxing is now enabled for child %i", child->pid);
     }
     else if (path_magic_off(path)) {
         data->result = RS_MAGIC;
-        child->sandbox->path = false;
+        tchild_unshare(child);
+        child->group->sandbox->path = false;
         g_info("path sandboxing is now disabled for child %i", child->pid);
     }
     else if (path_magic_toggle(path)) {
         data->result = RS_MAGIC;
-        child->sandbox->path = !(child->sandbox->path);
-        g_info("path sandboxing is now %sabled for child %i", child->sandbox->path ? "en" : "dis", child->pid);
+        tchild_unshare(child);
+        child->group->sandbox->path = !(child->group->sandbox->path);
+        g_info("path sandboxing is now %sabled for child %i", child->group->sandbox->path ? "en" : "dis", child->pid);
     }
     else if (path_magic_lock(path)) {
         data->result = RS_MAGIC;
-        child->sandbox->lock = LOCK_SET;
+        tchild_unshare(child);
+        child->group->sandbox->lock = LOCK_SET;
         g_info("access to magic commands is now denied for child %i", child->pid);
     }
     else if (path_magic_exec_lock(path)) {
         data->result = RS_MAGIC;
-        child->sandbox->lock = LOCK_PENDING;
+        tchild_unshare(child);
+        child->group->sandbox->lock = LOCK_PENDING;
         g_info("access to magic commands will be denied on execve() for child %i", child->pid);
     }
     else if (path_magic_wait_all(path)) {
@@ -384,52 +445,60 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
     }
     else if (path_magic_write(path)) {
         data->result = RS_MAGIC;
+        tchild_unshare(child);
         rpath = path + sizeof(CMD_WRITE) - 1;
-        pathnode_new(&(child->sandbox->write_prefixes), rpath, true);
+        pathnode_new(&(child->group->sandbox->write_prefixes), rpath, true);
         g_info("approved addwrite(\"%s\") for child %i", rpath, child->pid);
     }
     else if (path_magic_rmwrite(path)) {
         data->result = RS_MAGIC;
+        tchild_unshare(child);
         rpath = path + sizeof(CMD_RMWRITE) - 1;
         rpath_sanitized = sydbox_compress_path(rpath);
-        if (NULL != child->sandbox->write_prefixes)
-            pathnode_delete(&(child->sandbox->write_prefixes), rpath_sanitized);
+        if (NULL != child->group->sandbox->write_prefixes.paths)
+            pathnode_delete(&(child->group->sandbox->write_prefixes), rpath_sanitized);
         g_info("approved rmwrite(\"%s\") for child %i", rpath_sanitized, child->pid);
         g_free(rpath_sanitized);
     }
     else if (path_magic_sandbox_exec(path)) {
         data->result = RS_MAGIC;
-        child->sandbox->exec = true;
+        tchild_unshare(child);
+        child->group->sandbox->exec = true;
         g_info("execve(2) sandboxing is now enabled for child %i", child->pid);
     }
     else if (path_magic_sandunbox_exec(path)) {
         data->result = RS_MAGIC;
-        child->sandbox->exec = false;
+        tchild_unshare(child);
+        child->group->sandbox->exec = false;
         g_info("execve(2) sandboxing is now disabled for child %i", child->pid);
     }
     else if (path_magic_addexec(path)) {
         data->result = RS_MAGIC;
+        tchild_unshare(child);
         rpath = path + sizeof(CMD_ADDEXEC) - 1;
-        pathnode_new(&(child->sandbox->exec_prefixes), rpath, true);
+        pathnode_new(&(child->group->sandbox->exec_prefixes), rpath, true);
         g_info("approved addexec(\"%s\") for child %i", rpath, child->pid);
     }
     else if (path_magic_rmexec(path)) {
         data->result = RS_MAGIC;
+        tchild_unshare(child);
         rpath = path + sizeof(CMD_RMEXEC) - 1;
         rpath_sanitized = sydbox_compress_path(rpath);
-        if (NULL != child->sandbox->exec_prefixes)
-            pathnode_delete(&(child->sandbox->exec_prefixes), rpath_sanitized);
+        if (NULL != child->group->sandbox->exec_prefixes.paths)
+            pathnode_delete(&(child->group->sandbox->exec_prefixes), rpath_sanitized);
         g_info("approved rmexec(\"%s\") for child %i", rpath_sanitized, child->pid);
         g_free(rpath_sanitized);
     }
     else if (path_magic_sandbox_net(path)) {
         data->result = RS_MAGIC;
-        child->sandbox->network = true;
+        tchild_unshare(child);
+        child->group->sandbox->network = true;
         g_info("network sandboxing is now enabled for child %i", child->pid);
     }
     else if (path_magic_sandunbox_net(path)) {
         data->result = RS_MAGIC;
-        child->sandbox->network = false;
+        tchild_unshare(child);
+        child->group->sandbox->network = false;
         g_info("network sandboxing is now disabled for child %i", child->pid);
     }
     else if (path_magic_addfilter(path)) {
@@ -465,7 +534,7 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
                 g_warning("malformed filter address `%s'", expaddr[i]);
             else {
                 sydbox_config_addfilter_net(addr);
-                g_free(addr);
+                address_free(addr);
                 g_info("approved addfilter_net(\"%s\") for child %i", expaddr[i], child->pid);
             }
         }
@@ -480,7 +549,7 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
                 g_warning("malformed filter address `%s'", expaddr[i]);
             else {
                 sydbox_config_rmfilter_net(addr);
-                g_free(addr);
+                address_free(addr);
                 g_info("approved rmfilter_net(\"%s\") for child %i", expaddr[i], child->pid);
             }
         }
@@ -494,9 +563,7 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
             if ((addr = address_from_string(expaddr[i], true)) == NULL)
                 g_warning("malformed whitelist address `%s'", expaddr[i]);
             else {
-                whitelist = sydbox_config_get_network_whitelist_bind();
-                whitelist = g_slist_prepend(whitelist, addr);
-                sydbox_config_set_network_whitelist_bind(whitelist);
+                sydbox_config_addwhitelist_bind(addr);
             }
         }
         g_strfreev(expaddr);
@@ -509,17 +576,9 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
             if ((addr = address_from_string(expaddr[i], false)) == NULL)
                 g_warning("malformed whitelist address `%s'", expaddr[i]);
             else {
-                whitelist = sydbox_config_get_network_whitelist_bind();
-                for (walk = whitelist; walk != NULL; walk = g_slist_next(walk)) {
-                    if (address_cmp(walk->data, addr)) {
-                        whitelist = g_slist_remove_link(whitelist, walk);
-                        sydbox_config_set_network_whitelist_bind(whitelist);
-                        g_free(walk->data);
-                        g_slist_free(walk);
-                        g_info("approved unwhitelist/bind(\"%s\") for child %i", expaddr[i], child->pid);
-                        break;
-                    }
-                }
+                if (sydbox_config_rmwhitelist_bind(addr))
+                    g_info("approved unwhitelist/bind(\"%s\") for child %i", expaddr[i], child->pid);
+                address_free(addr);
             }
         }
         g_strfreev(expaddr);
@@ -532,9 +591,7 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
             if ((addr = address_from_string(expaddr[i], true)) == NULL)
                 g_warning("malformed whitelist address `%s'", expaddr[i]);
             else {
-                whitelist = sydbox_config_get_network_whitelist_connect();
-                whitelist = g_slist_prepend(whitelist, addr);
-                sydbox_config_set_network_whitelist_connect(whitelist);
+                sydbox_config_addwhitelist_connect(addr);
             }
         }
         g_strfreev(expaddr);
@@ -547,16 +604,9 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
             if ((addr = address_from_string(expaddr[i], false)) == NULL)
                 g_warning("malformed whitelist address `%s'", rpath);
             else {
-                whitelist = sydbox_config_get_network_whitelist_connect();
-                for (walk = whitelist; walk != NULL; walk = g_slist_next(walk)) {
-                    if (address_cmp(walk->data, addr)) {
-                        whitelist = g_slist_remove_link(whitelist, walk);
-                        sydbox_config_set_network_whitelist_connect(whitelist);
-                        g_free(walk->data);
-                        g_slist_free(walk);
-                        g_info("approved unwhitelist/connect(\"%s\") for child %i", expaddr[i], child->pid);
-                    }
-                }
+                if (sydbox_config_rmwhitelist_connect(addr))
+                    g_info("approved unwhitelist/connect(\"%s\") for child %i", expaddr[i], child->pid);
+                address_free(addr);
             }
         }
         g_strfreev(expaddr);
@@ -564,7 +614,7 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
 
     if (data->result == RS_MAGIC) {
         g_debug("stat(\"%s\") is magic, encoding stat buffer", path);
-        if (G_UNLIKELY(!pinkw_encode_stat(child->pid, child->bitness))) {
+        if (G_UNLIKELY(!pinkw_encode_stat(child))) {
             data->result = RS_ERROR;
             data->save_errno = errno;
             if (ESRCH == errno)
@@ -586,7 +636,7 @@ static void syscall_magic_stat(struct tchild *child, struct checkdata *data)
  * If data->result isn't RS_ALLOW, which means an error has occured in a
  * previous callback or a decision has been made, it does nothing and simply
  * returns.
- * If child->sandbox->lock is set to LOCK_SET which means magic calls are
+ * If child->group->sandbox->lock is set to LOCK_SET which means magic calls are
  * locked, it does nothing and simply returns.
  * If the system call isn't stat(), it does nothing and simply returns.
  * Otherwise it calls systemcall_magic_stat()
@@ -596,11 +646,11 @@ static void syscall_check_magic(struct tchild *child, struct checkdata *data)
 
     if (G_UNLIKELY(RS_ALLOW != data->result))
         return;
-    else if (LOCK_SET == child->sandbox->lock) {
+    else if (LOCK_SET == child->group->sandbox->lock) {
         g_debug("Lock is set for child %i, skipping magic checks", child->pid);
         return;
     }
-    else if (!(sflags & MAGIC_STAT))
+    else if (!(data->sflags & MAGIC_STAT))
         return;
 
     syscall_magic_stat(child, data);
@@ -611,7 +661,7 @@ static void syscall_check_magic(struct tchild *child, struct checkdata *data)
  * If data->result isn't RS_ALLOW, which means an error has occured in a
  * previous callback or a decision has been made, it does nothing and simply
  * returns.
- * If child->sandbox->path is false it does nothing and simply returns.
+ * If child->group->sandbox->path is false it does nothing and simply returns.
  * If everything was successful this function sets data->resolve to a boolean
  * which gives information about whether the symlinks should be resolved.
  * On failure this function sets data->result to RS_ERROR and data->save_errno
@@ -621,24 +671,24 @@ static void syscall_check_resolve(struct tchild *child, struct checkdata *data)
 {
     if (G_UNLIKELY(RS_ALLOW != data->result))
         return;
-    else if (child->sandbox->exec && sflags & EXEC_CALL) {
+    else if (child->group->sandbox->exec && data->sflags & EXEC_CALL) {
         data->resolve = true;
         return;
     }
-    else if (child->sandbox->network && IS_NET_CALL(sflags)) {
+    else if (child->group->sandbox->network && IS_NET_CALL(data->sflags)) {
         data->resolve = true;
         return;
     }
-    else if (!child->sandbox->path)
+    else if (!child->group->sandbox->path)
         return;
 
     g_debug("deciding whether we should resolve symlinks for system call %lu(%s), child %i",
-            sno, sname, child->pid);
-    if (sflags & DONT_RESOLV)
+            data->sno, data->sname, child->pid);
+    if (data->sflags & DONT_RESOLV)
         data->resolve = false;
-    else if (sflags & IF_AT_SYMLINK_FOLLOW4) {
+    else if (data->sflags & IF_AT_SYMLINK_FOLLOW4) {
         long symflags;
-        if (G_UNLIKELY(!pink_util_get_arg(child->pid, child->bitness, 4, &symflags))) {
+        if (G_UNLIKELY(!pinkw_get_arg(child, 4, &symflags))) {
             data->result = RS_ERROR;
             data->save_errno = errno;
             if (ESRCH == errno)
@@ -649,10 +699,10 @@ static void syscall_check_resolve(struct tchild *child, struct checkdata *data)
         }
         data->resolve = symflags & AT_SYMLINK_FOLLOW ? true : false;
     }
-    else if (sflags & IF_AT_SYMLINK_NOFOLLOW3 || sflags & IF_AT_SYMLINK_NOFOLLOW4) {
+    else if (data->sflags & IF_AT_SYMLINK_NOFOLLOW3 || data->sflags & IF_AT_SYMLINK_NOFOLLOW4) {
         long symflags;
-        int arg = sflags & IF_AT_SYMLINK_NOFOLLOW3 ? 3 : 4;
-        if (G_UNLIKELY(!pink_util_get_arg(child->pid, child->bitness, arg, &symflags))) {
+        int arg = data->sflags & IF_AT_SYMLINK_NOFOLLOW3 ? 3 : 4;
+        if (G_UNLIKELY(!pinkw_get_arg(child, arg, &symflags))) {
             data->result = RS_ERROR;
             data->save_errno = errno;
             if (ESRCH == errno)
@@ -663,9 +713,9 @@ static void syscall_check_resolve(struct tchild *child, struct checkdata *data)
         }
         data->resolve = symflags & AT_SYMLINK_NOFOLLOW ? false : true;
     }
-    else if (sflags & IF_AT_REMOVEDIR2) {
+    else if (data->sflags & IF_AT_REMOVEDIR2) {
         long rmflags;
-        if (G_UNLIKELY(!pink_util_get_arg(child->pid, child->bitness, 2, &rmflags))) {
+        if (G_UNLIKELY(!pinkw_get_arg(child, 2, &rmflags))) {
             data->result = RS_ERROR;
             data->save_errno = errno;
             if (ESRCH == errno)
@@ -679,7 +729,7 @@ static void syscall_check_resolve(struct tchild *child, struct checkdata *data)
     else
         data->resolve = true;
     g_debug("decided %sto resolve symlinks for system call %lu(%s), child %i",
-            data->resolve ? "" : "not ", sno, sname, child->pid);
+            data->resolve ? "" : "not ", data->sno, data->sname, child->pid);
 }
 
 /* Resolves path for system calls
@@ -691,19 +741,21 @@ static gchar *syscall_resolvepath(struct tchild *child, struct checkdata *data,
 {
     bool maycreat;
     int mode;
-    char *path, *path_sanitized, *resolved_path;
+    pid_t pid;
+    const char *absdir, *path;
+    char *path_sanitized, *resolved_path;
 
     if (data->open_flags & O_CREAT)
         maycreat = true;
-    else if (0 == narg && sflags & (CAN_CREAT | MUST_CREAT))
+    else if (0 == narg && data->sflags & (CAN_CREAT | MUST_CREAT))
         maycreat = true;
-    else if (1 == narg && sflags & (CAN_CREAT2 | MUST_CREAT2))
+    else if (1 == narg && data->sflags & (CAN_CREAT2 | MUST_CREAT2))
         maycreat = true;
-    else if (1 == narg && isat && sflags & (CAN_CREAT_AT | MUST_CREAT_AT))
+    else if (1 == narg && isat && data->sflags & (CAN_CREAT_AT | MUST_CREAT_AT))
         maycreat = true;
-    else if (2 == narg && isat && sflags & MUST_CREAT_AT1)
+    else if (2 == narg && isat && data->sflags & MUST_CREAT_AT1)
         maycreat = true;
-    else if (3 == narg && sflags & (CAN_CREAT_AT2 | MUST_CREAT_AT2))
+    else if (3 == narg && data->sflags & (CAN_CREAT_AT2 | MUST_CREAT_AT2))
         maycreat = true;
     else if (-1 == narg) /* Non-abstract UNIX socket */
         maycreat = true;
@@ -720,38 +772,34 @@ static gchar *syscall_resolvepath(struct tchild *child, struct checkdata *data,
     else
         path = data->pathlist[narg];
 
+    absdir = NULL;
     if (!g_path_is_absolute(path)) {
-        char *absdir, *abspath;
         if (isat && NULL != data->dirfdlist[narg - 1]) {
             absdir = data->dirfdlist[narg - 1];
             g_debug("adding dirfd `%s' to `%s' to make it an absolute path", absdir, path);
         }
         else {
-            absdir = child->cwd;
+            if (NULL == (absdir = tchild_getcwd(child))) {
+                data->result = RS_DENY;
+                child->retval = -errno;
+                g_debug("proc_getcwd() failed: %s", g_strerror(errno));
+                return NULL;
+            }
             g_debug("adding current working directory `%s' to `%s' to make it an absolute path", absdir, path);
         }
-
-        abspath = g_build_path(G_DIR_SEPARATOR_S, absdir, path, NULL);
-        path_sanitized = sydbox_compress_path(abspath);
-        g_free(abspath);
     }
-    else
-        path_sanitized = sydbox_compress_path(path);
 
-#ifdef HAVE_PROC_SELF
     /* Special case for /proc/self.
      * This symbolic link resolves to /proc/PID, if we let
      * canonicalize_filename_mode() resolve this, we'll get a different result.
      */
-    if (0 == strncmp(path_sanitized, "/proc/self", 10)) {
-        g_debug("substituting /proc/self with /proc/%i", child->pid);
-        char *tmp = g_malloc(strlen(path_sanitized) + 32);
-        snprintf(tmp, strlen(path_sanitized) + 32, "/proc/%i/%s", child->pid, path_sanitized + 10);
-        g_free(path_sanitized);
-        path_sanitized = sydbox_compress_path(tmp);
-        g_free(tmp);
-    }
+#ifdef HAVE_PROC_SELF
+    pid = child->pid;
+#else
+    pid = 0;
 #endif
+    path_sanitized = arena_alloc(data->arena, sydbox_normalize_path_size(absdir, path));
+    sydbox_normalize_path(path_sanitized, absdir, path, pid);
 
     g_debug("mode is %s resolve is %s", maycreat ? "CAN_ALL_BUT_LAST" : "CAN_EXISTING",
                                         data->resolve ? "TRUE" : "FALSE");
@@ -761,7 +809,6 @@ static gchar *syscall_resolvepath(struct tchild *child, struct checkdata *data,
         child->retval = -errno;
         g_debug("canonicalize_filename_mode() failed for `%s': %s", path, g_strerror(errno));
     }
-    g_free(path_sanitized);
     return resolved_path;
 }
 
@@ -770,76 +817,80 @@ static gchar *syscall_resolvepath(struct tchild *child, struct checkdata *data,
  * If data->result isn't RS_ALLOW, which means an error has occured in a
  * previous callback or a decision has been made, it does nothing and simply
  * returns.
- * If child->sandbox->path is false it does nothing and simply returns.
+ * If child->group->sandbox->path is false it does nothing and simply returns.
  */
 static void syscall_check_canonicalize(G_GNUC_UNUSED context_t *ctx, struct tchild *child,
         struct checkdata *data)
 {
+    gchar *rpath;
+
     if (G_UNLIKELY(RS_ALLOW != data->result))
         return;
 
-    if (child->sandbox->exec && sflags & EXEC_CALL) {
+    if (child->group->sandbox->exec && data->sflags & EXEC_CALL) {
         g_debug("canonicalizing `%s' for system call %lu(%s), child %i", data->pathlist[0],
-                sno, sname, child->pid);
+                data->sno, data->sname, child->pid);
         data->rpathlist[0] = syscall_resolvepath(child, data, 0, false);
         if (NULL != data->rpathlist[0])
             g_debug("canonicalized `%s' to `%s'", data->pathlist[0], data->rpathlist[0]);
         return;
     }
-    if (child->sandbox->network &&
-            IS_NET_CALL(sflags) &&
+    if (child->group->sandbox->network &&
+            IS_NET_CALL(data->sflags) &&
             data->addr != NULL &&
             data->addr->family == AF_UNIX &&
             !data->addr->u.saun.abstract) {
         g_debug("canonicalizing `%s' for system call %lu(%s), child %i",
-                data->addr->u.saun.sun_path, sno, sname, child->pid);
-        data->addr->u.saun.rsun_path = syscall_resolvepath(child, data, -1, false);
+                data->addr->u.saun.sun_path, data->sno, data->sname, child->pid);
+        rpath = syscall_resolvepath(child, data, -1, false);
+        address_set_rpath(data->addr, rpath);
+        g_free(rpath);
         if (NULL != data->addr->u.saun.rsun_path)
             g_debug("canonicalized `%s' to `%s'", data->addr->u.saun.sun_path, data->addr->u.saun.rsun_path);
         return;
     }
 
-    if (!child->sandbox->path)
+    if (!child->group->sandbox->path)
         return;
-    if (sflags & CHECK_PATH) {
+    if (data->sflags & CHECK_PATH) {
         g_debug("canonicalizing `%s' for system call %lu(%s), child %i", data->pathlist[0],
-                sno, sname, child->pid);
+                data->sno, data->sname, child->pid);
         data->rpathlist[0] = syscall_resolvepath(child, data, 0, false);
         if (NULL == data->rpathlist[0])
             return;
         else
             g_debug("canonicalized `%s' to `%s'", data->pathlist[0], data->rpathlist[0]);
     }
-    if (sflags & CHECK_PATH2) {
+    if (data->sflags & CHECK_PATH2) {
         g_debug("canonicalizing `%s' for system call %lu(%s), child %i", data->pathlist[1],
-                sno, sname, child->pid);
+                data->sno, data->sname, child->pid);
         data->rpathlist[1] = syscall_resolvepath(child, data, 1, false);
         if (NULL == data->rpathlist[1])
             return;
         else
             g_debug("canonicalized `%s' to `%s'", data->pathlist[1], data->rpathlist[1]);
     }
-    if (sflags & CHECK_PATH_AT) {
+    if (data->sflags & CHECK_PATH_AT) {
         g_debug("canonicalizing `%s' for system call %lu(%s), child %i", data->pathlist[1],
-                sno, sname, child->pid);
+                data->sno, data->sname, child->pid);
         data->rpathlist[1] = syscall_resolvepath(child, data, 1, true);
         if (NULL == data->rpathlist[1])
             return;
         else
             g_debug("canonicalized `%s' to `%s'", data->pathlist[1], data->rpathlist[1]);
     }
-    if (sflags & CHECK_PATH_AT1) {
+    if (data->sflags & CHECK_PATH_AT1) {
         g_debug("canonicalizing `%s' for system call %lu(%s), child %i", data->pathlist[2],
-                sno, sname, child->pid);
+                data->sno, data->sname, child->pid);
         data->rpathlist[2] = syscall_resolvepath(child, data, 2, true);
         if (NULL == data->rpathlist[2])
             return;
         else
             g_debug("canonicalized `%s' to `%s'", data->pathlist[2], data->rpathlist[2]);
     }
-    if (sflags & CHECK_PATH_AT2) {
+    if (data->sflags & CHECK_PATH_AT2) {
         g_debug("canonicalizing `%s' for system call %lu(%s), child %i", data->pathlist[3],
-                sno, sname, child->pid);
+                data->sno, data->sname, child->pid);
         data->rpathlist[3] = syscall_resolvepath(child, data, 3, true);
         if (NULL == data->rpathlist[3])
             return;
@@ -854,19 +905,19 @@ static int syscall_handle_create(struct tchild *child, struct checkdata *data, i
     struct stat buf;
 
     path = data->rpathlist[narg];
-    if ((narg == 0 && sflags & MUST_CREAT) ||
-            (narg == 1 && sflags & (MUST_CREAT2 | MUST_CREAT_AT)) ||
-            (narg == 3 && sflags & MUST_CREAT_AT2)) {
+    if ((narg == 0 && data->sflags & MUST_CREAT) ||
+            (narg == 1 && data->sflags & (MUST_CREAT2 | MUST_CREAT_AT)) ||
+            (narg == 3 && data->sflags & MUST_CREAT_AT2)) {
         g_debug("system call %lu(%s) has one of MUST_CREAT* flags set, checking if `%s' exists",
-                sno, sname, path);
+                data->sno, data->sname, path);
         if (0 == stat(path, &buf)) {
             /* The system call _has_ to create the path but it exists.
              * Deny the system call and set errno to EEXIST but don't throw
              * an access violation.
              * Useful for cases like mkdir -p a/b/c.
              */
-            g_debug("`%s' exists, system call %lu(%s) will fail with EEXIST", path, sno, sname);
-            g_debug("denying system call %lu(%s) and failing with EEXIST without violation", sno, sname);
+            g_debug("`%s' exists, system call %lu(%s) will fail with EEXIST", path, data->sno, data->sname);
+            g_debug("denying system call %lu(%s) and failing with EEXIST without violation", data->sno, data->sname);
             data->result = RS_DENY;
             child->retval = -EEXIST;
             return 1;
@@ -875,13 +926,28 @@ static int syscall_handle_create(struct tchild *child, struct checkdata *data, i
     return 0;
 }
 
+/* Children may write to their own /proc/PID, which isn't part of the sandbox
+ * data they share with their parent.
+ */
+static bool syscall_check_proc_pid(struct tchild *child, const char *path)
+{
+    int len;
+    char proc_pid[32];
+
+    if (!sydbox_config_get_allow_proc_pid())
+        return false;
+    len = snprintf(proc_pid, 32, "/proc/%i", child->pid);
+    return (0 == strncmp(path, proc_pid, len) && ('\0' == path[len] || '/' == path[len]));
+}
+
 static void syscall_handle_path(struct tchild *child, struct checkdata *data, int narg)
 {
     char *path = data->rpathlist[narg];
 
     g_debug("checking `%s' for write access", path);
 
-    if (G_UNLIKELY(!pathlist_check(child->sandbox->write_prefixes, path))) {
+    if (G_UNLIKELY(!pathlist_check(&(child->group->sandbox->write_prefixes), path) &&
+                !syscall_check_proc_pid(child, path))) {
         if (syscall_handle_create(child, data, narg))
             return;
 
@@ -891,25 +957,25 @@ static void syscall_handle_path(struct tchild *child, struct checkdata *data, in
         /* Don't raise access violations for access(2) system call.
          * Silently deny it instead.
          */
-        if (sflags & ACCESS_MODE)
+        if (data->sflags & ACCESS_MODE)
             return;
 
         switch (narg) {
             case 0:
                 sydbox_access_violation_path(child, path, "%s(\"%s\", %s)",
-                        sname, path, MODE_STRING(sflags));
+                        data->sname, path, MODE_STRING(data->sflags));
                 break;
             case 1:
                 sydbox_access_violation_path(child, path, "%s(?, \"%s\", %s)",
-                        sname, path, MODE_STRING(sflags));
+                        data->sname, path, MODE_STRING(data->sflags));
                 break;
             case 2:
                 sydbox_access_violation_path(child, path, "%s(?, ?, \"%s\", %s)",
-                        sname, path, MODE_STRING(sflags));
+                        data->sname, path, MODE_STRING(data->sflags));
                 break;
             case 3:
                 sydbox_access_violation_path(child, path, "%s(?, ?, ?, \"%s\", %s)",
-                        sname, path, MODE_STRING(sflags));
+                        data->sname, path, MODE_STRING(data->sflags));
                 break;
             default:
                 g_assert_not_reached();
@@ -922,61 +988,27 @@ static void syscall_handle_net(struct tchild *child, struct checkdata *data)
 {
     bool isbind, violation;
     char ip[100] = { 0 };
-    GSList *whitelist, *walk;
-    struct sydbox_addr *addr;
-
-    isbind = ((sflags & BIND_CALL) || ((sflags & DECODE_SOCKETCALL) && data->subcall == PINK_SOCKET_SUBCALL_BIND));
-    whitelist = isbind
-        ? sydbox_config_get_network_whitelist_bind()
-        : sydbox_config_get_network_whitelist_connect();
-
-    violation = true;
-    for (walk = whitelist; walk != NULL; walk = g_slist_next(walk)) {
-        addr = (struct sydbox_addr *)walk->data;
-        if (address_has(addr, data->addr)) {
-            /* Check port range for NET_FAMILY. */
-            switch (addr->family) {
-                case AF_UNIX:
-                    violation = false;
-                    break;
-                case AF_INET:
-                    if (data->addr->u.sa.port[0] >= addr->u.sa.port[0] &&
-                            data->addr->u.sa.port[1] <= addr->u.sa.port[1])
-                        violation = false;
-                    break;
-#if SYDBOX_HAVE_IPV6
-                case AF_INET6:
-                    if (data->addr->u.sa6.port[0] >= addr->u.sa6.port[0] &&
-                            data->addr->u.sa6.port[1] <= addr->u.sa6.port[1])
-                        violation = false;
-                    break;
-#endif /* SYDBOX_HAVE_IPV6 */
-                default:
-                    g_assert_not_reached();
-            }
 
-            if (!violation)
-                break;
-        }
-    }
+    isbind = ((data->sflags & BIND_CALL) || ((data->sflags & DECODE_SOCKETCALL) && data->subcall == PINK_SOCKET_SUBCALL_BIND));
+    violation = !sydbox_config_match_network_whitelist(data->addr, isbind);
 
     if (violation) {
         switch (data->addr->family) {
             case AF_UNIX:
                 sydbox_access_violation_net(child, data->addr, "%s{family=AF_UNIX path=%s abstract=%s}",
-                        sname, data->addr->u.saun.sun_path,
+                        data->sname, data->addr->u.saun.sun_path,
                         data->addr->u.saun.abstract ? "true" : "false");
                 break;
             case AF_INET:
                 inet_ntop(AF_INET, &data->addr->u.sa.sin_addr, ip, sizeof(ip));
                 sydbox_access_violation_net(child, data->addr, "%s{family=AF_INET addr=%s port=%d}",
-                        sname, ip, data->addr->u.sa.port[0]);
+                        data->sname, ip, data->addr->u.sa.port[0]);
                 break;
 #if SYDBOX_HAVE_IPV6
             case AF_INET6:
                 inet_ntop(AF_INET6, &data->addr->u.sa6.sin6_addr, ip, sizeof(ip));
                 sydbox_access_violation_net(child, data->addr, "%s{family=AF_INET6 addr=%s port=%d}",
-                        sname, ip, data->addr->u.sa6.port[0]);
+                        data->sname, ip, data->addr->u.sa6.port[0]);
                 break;
 #endif /* SYDBOX_HAVE_IPV6 */
             default:
@@ -995,17 +1027,17 @@ static void syscall_check(G_GNUC_UNUSED context_t *ctx, struct tchild *child, st
     if (G_UNLIKELY(RS_ALLOW != data->result))
         return;
 
-    if (child->sandbox->network &&
-            IS_NET_CALL(sflags) &&
+    if (child->group->sandbox->network &&
+            IS_NET_CALL(data->sflags) &&
             data->addr != NULL &&
             IS_SUPPORTED_FAMILY(data->addr->family)) {
         syscall_handle_net(child, data);
         return;
     }
 
-    if (child->sandbox->exec && sflags & EXEC_CALL) {
+    if (child->group->sandbox->exec && data->sflags & EXEC_CALL) {
         g_debug("checking `%s' for exec access", data->rpathlist[0]);
-        if (G_UNLIKELY(!pathlist_check(child->sandbox->exec_prefixes, data->rpathlist[0]))) {
+        if (G_UNLIKELY(!pathlist_check(&(child->group->sandbox->exec_prefixes), data->rpathlist[0]))) {
             sydbox_access_violation_exec(child, data->rpathlist[0],
                     "execve(\"%s\", [%s])", data->rpathlist[0], data->sargv);
             data->result = RS_DENY;
@@ -1014,29 +1046,29 @@ static void syscall_check(G_GNUC_UNUSED context_t *ctx, struct tchild *child, st
         return;
     }
 
-    if (!child->sandbox->path)
+    if (!child->group->sandbox->path)
         return;
-    if (sflags & CHECK_PATH) {
+    if (data->sflags & CHECK_PATH) {
         syscall_handle_path(child, data, 0);
         if (RS_ERROR == data->result || RS_DENY == data->result)
             return;
     }
-    if (sflags & CHECK_PATH2) {
+    if (data->sflags & CHECK_PATH2) {
         syscall_handle_path(child, data, 1);
         if (RS_ERROR == data->result || RS_DENY == data->result)
             return;
     }
-    if (sflags & CHECK_PATH_AT) {
+    if (data->sflags & CHECK_PATH_AT) {
         syscall_handle_path(child, data, 1);
         if (RS_ERROR == data->result || RS_DENY == data->result)
             return;
     }
-    if (sflags & CHECK_PATH_AT1) {
+    if (data->sflags & CHECK_PATH_AT1) {
         syscall_handle_path(child, data, 2);
         if (RS_ERROR == data->result || RS_DENY == data->result)
             return;
     }
-    if (sflags & CHECK_PATH_AT2) {
+    if (data->sflags & CHECK_PATH_AT2) {
         syscall_handle_path(child, data, 3);
         if (RS_ERROR == data->result || RS_DENY == data->result)
             return;
@@ -1045,21 +1077,17 @@ static void syscall_check(G_GNUC_UNUSED context_t *ctx, struct tchild *child, st
 
 static void syscall_check_finalize(G_GNUC_UNUSED context_t *ctx, struct tchild *child, struct checkdata *data)
 {
-    g_debug("ending check for system call %lu(%s), child %i", sno, sname, child->pid);
+    g_debug("ending check for system call %lu(%s), child %i", data->sno, data->sname, child->pid);
 
-    for (unsigned int i = 0; i < 2; i++)
-        g_free(data->dirfdlist[i]);
-    for (unsigned int i = 0; i < 4; i++) {
-        g_free(data->pathlist[i]);
+    for (unsigned int i = 0; i < 4; i++)
         g_free(data->rpathlist[i]);
-    }
 
     g_free(data->sargv);
-    if (child->sandbox->network &&
+    if (child->group->sandbox->network &&
             sydbox_config_get_network_auto_whitelist_bind() &&
             data->result == RS_ALLOW &&
-            (sflags & BIND_CALL ||
-             (sflags & DECODE_SOCKETCALL && data->subcall == PINK_SOCKET_SUBCALL_BIND)) &&
+            (data->sflags & BIND_CALL ||
+             (data->sflags & DECODE_SOCKETCALL && data->subcall == PINK_SOCKET_SUBCALL_BIND)) &&
             data->addr != NULL &&
             IS_SUPPORTED_FAMILY(data->addr->family)) {
         /* Store the bind address.
@@ -1068,6 +1096,7 @@ static void syscall_check_finalize(G_GNUC_UNUSED context_t *ctx, struct tchild *
         child->bindlast = address_dup(data->addr);
     }
     address_free(data->addr);
+    arena_reset(data->arena);
 }
 
 /* Denied system call handler for system calls.
@@ -1077,7 +1106,8 @@ static void syscall_check_finalize(G_GNUC_UNUSED context_t *ctx, struct tchild *
  */
 static int syscall_handle_badcall(struct tchild *child)
 {
-    g_debug("restoring real call number for denied system call %lu(%s)", child->sno, sname);
+    g_debug("restoring real call number for denied system call %lu(%s)",
+            child->sno, pink_name_syscall(child->sno, child->bitness));
     // Restore real call number and return our error code
     if (!pink_util_set_syscall(child->pid, child->bitness, child->sno)) {
         if (G_UNLIKELY(ESRCH != errno)) {
@@ -1106,70 +1136,29 @@ static int syscall_handle_badcall(struct tchild *child)
     return 0;
 }
 
-/* chdir(2) handler for system calls.
- * This is only called when child is exiting chdir() or fchdir() system calls.
- * Returns nonzero if child is dead, zero otherwise.
+/* Whitelists the address the child bound the socket to for connect(), the
+ * address is owned by the thread group of the child.
  */
-static int syscall_handle_chdir(struct tchild *child)
+static void syscall_whitelist_bind(struct tchild *child, long fd, struct sydbox_addr *addr)
 {
-    long retval;
+    pid_t tgid;
 
-    if (!pink_util_get_return(child->pid, &retval)) {
-        if (G_UNLIKELY(ESRCH != errno)) {
-            /* Error getting return code using ptrace()
-             * child is still alive, hence the error is fatal.
-             */
-            g_critical("failed to get return code: %s", g_strerror(errno));
-            g_printerr("failed to get return code: %s\n", g_strerror(errno));
-            exit(-1);
-        }
-        // Child is dead.
-        return -1;
-    }
-    if (0 == retval) {
-        /* Child has successfully changed directory,
-         * update current working directory.
-         */
-        char *newcwd = proc_getcwd(child->pid);
-        if (NULL == newcwd) {
-            /* Failed to get current working directory of child.
-             * Set errno of the child.
-             * FIXME: We should probably die here as well, because the
-             * child has successfully changed directory and setting
-             * errno doesn't change that fact.
-             */
-            retval = -errno;
-            g_debug("proc_getcwd() failed: %s", g_strerror(errno));
-            if (!pink_util_set_return(child->pid, retval)) {
-                if (G_UNLIKELY(ESRCH != errno)) {
-                    /* Error setting return code using ptrace()
-                     * child is still alive, hence the error is fatal.
-                     */
-                    g_critical("failed to set return code: %s", g_strerror(errno));
-                    g_printerr("failed to set return code: %s\n", g_strerror(errno));
-                    exit(-1);
-                }
-                // Child is dead.
-                return -1;
-            }
-        }
-        else {
-            /* Successfully determined the new current working
-             * directory of child. Update context.
-             */
-            if (NULL != child->cwd)
-                g_free(child->cwd);
-            child->cwd = newcwd;
-            g_info("child %i has changed directory to '%s'", child->pid, child->cwd);
-        }
-    }
-    else {
-        /* Child failed to change current working directory,
-         * nothing to do.
-         */
-        g_debug("child %i failed to change directory: %s", child->pid, g_strerror(-retval));
-    }
-    return 0;
+    if (0 >= (tgid = proc_tgid(child->pid)))
+        tgid = child->pid;
+    sydbox_config_addwhitelist_auto(tgid, fd, proc_socket_inode(child->pid, fd), addr);
+}
+
+/* Drops the sockets bound to port zero which have been closed, or whose file
+ * descriptor now refers to another socket, since the last bind() call.
+ */
+static gboolean syscall_bindzero_stale(gpointer fd_ptr, gpointer bind_ptr, gpointer child_ptr)
+{
+    unsigned long inode;
+    struct tbind *bind = (struct tbind *)bind_ptr;
+    struct tchild *child = (struct tchild *)child_ptr;
+
+    inode = proc_socket_inode(child->pid, GPOINTER_TO_INT(fd_ptr));
+    return (0 == inode || (0 != bind->inode && inode != bind->inode));
 }
 
 /**
@@ -1179,9 +1168,8 @@ static int syscall_handle_bind(struct tchild *child, int flags)
 {
     int port;
     long fd, retval, subcall;
-    GSList *whitelist;
 
-    if (!pink_util_get_return(child->pid, &retval)) {
+    if (!pinkw_get_return(child, &retval)) {
         if (G_UNLIKELY(ESRCH != errno)) {
             /* Error getting return code using ptrace()
              * child is still alive, hence the error is fatal.
@@ -1202,7 +1190,7 @@ static int syscall_handle_bind(struct tchild *child, int flags)
     }
 
     if (flags & DECODE_SOCKETCALL) {
-        if (!pink_util_get_arg(child->pid, child->bitness, 0, &subcall)) {
+        if (!pinkw_decode_socket_call(child, &subcall)) {
             if (G_UNLIKELY(ESRCH != errno)) {
                 /* Error getting socket subcall using ptrace()
                  * child is still alive, hence the error is fatal.
@@ -1238,29 +1226,30 @@ static int syscall_handle_bind(struct tchild *child, int flags)
                 g_assert_not_reached();
         }
 
+        if (!pinkw_decode_socket_fd(child, 0, &fd)) {
+            if (G_UNLIKELY(ESRCH != errno)) {
+                /* Error getting return code using ptrace()
+                 * child is still alive, hence the error is fatal.
+                 */
+                g_critical("failed to get file descriptor: %s", g_strerror(errno));
+                g_printerr("failed to get file descriptor: %s\n", g_strerror(errno));
+                exit(-1);
+            }
+            // Child is dead.
+            return -1;
+        }
+
         if (port == 0) {
             /* Special case for binding to port zero.
              * We'll check the getsockname() call after this to get the port.
+             * close() isn't traced, closed sockets are dropped here.
              */
-            if (!pink_decode_socket_fd(child->pid, child->bitness, 0, &fd)) {
-                if (G_UNLIKELY(ESRCH != errno)) {
-                    /* Error getting return code using ptrace()
-                     * child is still alive, hence the error is fatal.
-                     */
-                    g_critical("failed to get file descriptor: %s", g_strerror(errno));
-                    g_printerr("failed to get file descriptor: %s\n", g_strerror(errno));
-                    exit(-1);
-                }
-                // Child is dead.
-                return -1;
-            }
-            g_hash_table_insert(child->bindzero, GINT_TO_POINTER(fd), address_dup(child->bindlast));
-        }
-        else {
-            whitelist = sydbox_config_get_network_whitelist_connect();
-            whitelist = g_slist_prepend(whitelist, address_dup(child->bindlast));
-            sydbox_config_set_network_whitelist_connect(whitelist);
+            g_hash_table_foreach_remove(tchild_bindzero(child), syscall_bindzero_stale, child);
+            g_hash_table_insert(child->files->bindzero, GINT_TO_POINTER(fd),
+                    tbind_new(proc_socket_inode(child->pid, fd), child->bindlast));
         }
+        else
+            syscall_whitelist_bind(child, fd, address_dup(child->bindlast));
     }
 
     address_free(child->bindlast);
@@ -1274,10 +1263,10 @@ static int syscall_handle_bind(struct tchild *child, int flags)
 static int syscall_handle_getsockname(struct tchild *child, bool decode)
 {
     long fd, retval, subcall;
-    GSList *whitelist;
+    struct tbind *bind;
     struct sydbox_addr *addr, *addr_new;
 
-    if (!pink_util_get_return(child->pid, &retval)) {
+    if (!pinkw_get_return(child, &retval)) {
         if (G_UNLIKELY(ESRCH != errno)) {
             /* Error getting return code using ptrace()
              * Silently ignore it.
@@ -1295,7 +1284,7 @@ static int syscall_handle_getsockname(struct tchild *child, bool decode)
     }
 
     if (decode) { /* socketcall() */
-        if (!pink_util_get_arg(child->pid, child->bitness, 0, &subcall)) {
+        if (!pinkw_decode_socket_call(child, &subcall)) {
             if (G_UNLIKELY(ESRCH != errno)) {
                 /* Error getting socket subcall using ptrace()
                  * Silently ignore it.
@@ -1309,10 +1298,10 @@ static int syscall_handle_getsockname(struct tchild *child, bool decode)
         if (subcall != PINK_SOCKET_SUBCALL_GETSOCKNAME)
             return 0;
 
-        addr_new = pinkw_get_socket_addr(child->pid, child->bitness, 1, &fd);
+        addr_new = pinkw_get_socket_addr(child, 1, &fd);
     }
     else /* getsockname() */
-        addr_new = pinkw_get_socket_addr(child->pid, child->bitness, 1, &fd);
+        addr_new = pinkw_get_socket_addr(child, 1, &fd);
 
     if (addr_new == NULL) {
         /* Error getting fd using ptrace()
@@ -1322,11 +1311,19 @@ static int syscall_handle_getsockname(struct tchild *child, bool decode)
         return 0;
     }
 
-    addr = g_hash_table_lookup(child->bindzero, GINT_TO_POINTER(fd));
-    if (addr == NULL) {
+    bind = g_hash_table_lookup(child->files->bindzero, GINT_TO_POINTER(fd));
+    if (bind == NULL) {
         g_debug("No bind() call received before getsockname(), ignoring");
+        address_free(addr_new);
+        return 0;
+    }
+    else if (syscall_bindzero_stale(GINT_TO_POINTER(fd), bind, child)) {
+        g_debug("Socket %ld was closed since the bind() call, ignoring", fd);
+        g_hash_table_remove(child->files->bindzero, GINT_TO_POINTER(fd));
+        address_free(addr_new);
         return 0;
     }
+    addr = bind->addr;
 
     switch (addr->family) {
         case AF_INET:
@@ -1347,12 +1344,10 @@ static int syscall_handle_getsockname(struct tchild *child, bool decode)
             g_assert_not_reached();
     }
 
-    whitelist = sydbox_config_get_network_whitelist_connect();
-    whitelist = g_slist_prepend(whitelist, address_dup(addr));
-    sydbox_config_set_network_whitelist_connect(whitelist);
+    syscall_whitelist_bind(child, fd, address_dup(addr));
 
-    g_free(addr_new);
-    g_hash_table_remove(child->bindzero, GINT_TO_POINTER(fd));
+    address_free(addr_new);
+    g_hash_table_remove(child->files->bindzero, GINT_TO_POINTER(fd));
     return 0;
 }
 
@@ -1361,9 +1356,9 @@ static int syscall_handle_getsockname(struct tchild *child, bool decode)
 static int syscall_handle_dup(struct tchild *child)
 {
     long oldfd, newfd;
-    struct sydbox_addr *addr;
+    struct tbind *bind;
 
-    if (!pink_util_get_return(child->pid, &newfd)) {
+    if (!pinkw_get_return(child, &newfd)) {
         if (G_UNLIKELY(ESRCH != errno)) {
             /* Error getting return code using ptrace()
              * Silently ignore it.
@@ -1380,7 +1375,7 @@ static int syscall_handle_dup(struct tchild *child)
         return 0;
     }
 
-    if (!pink_util_get_arg(child->pid, child->bitness, 0, &oldfd)) {
+    if (!pinkw_get_arg(child, 0, &oldfd)) {
         if (G_UNLIKELY(ESRCH != errno)) {
             /* Error getting first argument using ptrace()
              * Silently ignore it.
@@ -1392,23 +1387,60 @@ static int syscall_handle_dup(struct tchild *child)
         return -1;
     }
 
-    addr = g_hash_table_lookup(child->bindzero, GINT_TO_POINTER(oldfd));
-    if (addr == NULL) {
+    bind = g_hash_table_lookup(child->files->bindzero, GINT_TO_POINTER(oldfd));
+    if (bind == NULL) {
         g_debug("No bind() call received before dup() ignoring");
         return 0;
     }
 
     g_debug("Duplicating address information oldfd:%ld newfd:%ld", oldfd, newfd);
-    g_hash_table_insert(child->bindzero, GINT_TO_POINTER(newfd), address_dup(addr));
+    g_hash_table_insert(child->files->bindzero, GINT_TO_POINTER(newfd), tbind_new(bind->inode, bind->addr));
+    return 0;
+}
+
+static int syscall_handle_unshare(struct tchild *child)
+{
+    long ret, flags;
+
+    if (!pinkw_get_return(child, &ret)) {
+        if (G_UNLIKELY(ESRCH != errno)) {
+            /* Error getting return code using ptrace()
+             * Silently ignore it.
+             */
+            g_debug("failed to get return code: %s", g_strerror(errno));
+            return 0;
+        }
+        // Child is dead.
+        return -1;
+    }
+
+    if (0 != ret) {
+        /* Call failed, ignore it */
+        return 0;
+    }
+
+    if (!pinkw_get_arg(child, 0, &flags)) {
+        if (G_UNLIKELY(ESRCH != errno)) {
+            /* Error getting first argument using ptrace()
+             * Silently ignore it.
+             */
+            g_debug("failed to get unshare flags: %s", g_strerror(errno));
+            return 0;
+        }
+        // Child is dead.
+        return -1;
+    }
+
+    tchild_split(child, (unsigned long)flags);
     return 0;
 }
 
 static int syscall_handle_fcntl(struct tchild *child)
 {
     long oldfd, newfd, cmd;
-    struct sydbox_addr *addr;
+    struct tbind *bind;
 
-    if (!pink_util_get_return(child->pid, &newfd)) {
+    if (!pinkw_get_return(child, &newfd)) {
         if (G_UNLIKELY(ESRCH != errno)) {
             /* Error getting return code using ptrace()
              * Silently ignore it.
@@ -1425,7 +1457,7 @@ static int syscall_handle_fcntl(struct tchild *child)
         return 0;
     }
 
-    if (!pink_util_get_arg(child->pid, child->bitness, 1, &cmd)) {
+    if (!pinkw_get_arg(child, 1, &cmd)) {
         if (G_UNLIKELY(ESRCH != errno)) {
             /* Error getting first argument using ptrace()
              * Silently ignore it.
@@ -1444,7 +1476,7 @@ static int syscall_handle_fcntl(struct tchild *child)
         return 0;
     }
 
-    if (!pink_util_get_arg(child->pid, child->bitness, 0, &oldfd)) {
+    if (!pinkw_get_arg(child, 0, &oldfd)) {
         if (G_UNLIKELY(ESRCH != errno)) {
             /* Error getting first argument using ptrace()
              * Silently ignore it.
@@ -1456,14 +1488,14 @@ static int syscall_handle_fcntl(struct tchild *child)
         return -1;
     }
 
-    addr = g_hash_table_lookup(child->bindzero, GINT_TO_POINTER(oldfd));
-    if (addr == NULL) {
+    bind = g_hash_table_lookup(child->files->bindzero, GINT_TO_POINTER(oldfd));
+    if (bind == NULL) {
         g_debug("No bind() call received before fcntl() ignoring");
         return 0;
     }
 
     g_debug("Duplicating address information oldfd:%ld newfd:%ld", oldfd, newfd);
-    g_hash_table_insert(child->bindzero, GINT_TO_POINTER(newfd), address_dup(addr));
+    g_hash_table_insert(child->files->bindzero, GINT_TO_POINTER(newfd), tbind_new(bind->inode, bind->addr));
     return 0;
 }
 
@@ -1471,16 +1503,30 @@ static int syscall_handle_fcntl(struct tchild *child)
  */
 int syscall_handle(context_t *ctx, struct tchild *child)
 {
-    bool decode, entering;
+    bool entering;
+    long sno;
+    const char *sname;
+    const struct dispatch_entry *entry;
     struct checkdata data;
 
     entering = !(child->flags & TCHILD_INSYSCALL);
+
+    /* Fetch the registers once, the checks below read them from the snapshot. */
+    if (!pinkw_regs_fetch(child, entering)) {
+        if (G_UNLIKELY(ESRCH != errno)) {
+            g_critical("failed to get registers: %s", g_strerror(errno));
+            g_printerr("failed to get registers: %s\n", g_strerror(errno));
+            exit(-1);
+        }
+        return context_remove_child(ctx, child->pid);
+    }
+
     if (entering) {
         /* Child is entering the system call.
          * Get the system call number of child.
          * Save it in child->sno.
          */
-        if (!pink_util_get_syscall(child->pid, child->bitness, &sno)) {
+        if (!pinkw_get_syscall(child, &sno)) {
             if (G_UNLIKELY(ESRCH != errno)) {
                 /* Error getting system call using ptrace()
                  * child is still alive, hence the error is fatal.
@@ -1493,19 +1539,19 @@ int syscall_handle(context_t *ctx, struct tchild *child)
             return context_remove_child(ctx, child->pid);
         }
         child->sno = sno;
-        sname = pink_name_syscall(sno, child->bitness);
-        sflags = dispatch_lookup(sno, child->bitness);
+        /* Look the system call up once, the exit uses the cached flags. */
+        entry = dispatch_lookup(sno, child->bitness);
+        child->sflags = entry->flags;
+        child->sexit = entry->exit;
     }
-    else {
+    else
         sno = child->sno;
-        sname = pink_name_syscall(sno, child->bitness);
-        sflags = dispatch_lookup(sno, child->bitness);
-    }
+    sname = pink_name_syscall(sno, child->bitness);
 
     if (entering) {
         g_debug_trace("child %i is entering system call %lu(%s)", child->pid, sno, sname);
 
-        if (-1 == sflags) {
+        if (0 == child->sflags) {
             /* No flags for this system call.
              * Safe system call, allow access.
              */
@@ -1513,6 +1559,10 @@ int syscall_handle(context_t *ctx, struct tchild *child)
         }
         else {
             memset(&data, 0, sizeof(struct checkdata));
+            data.arena = syscall_arena();
+            data.sno = sno;
+            data.sflags = child->sflags;
+            data.sname = sname;
             syscall_check_start(ctx, child, &data);
             syscall_check_flags(child, &data);
             syscall_check_magic(child, &data);
@@ -1586,35 +1636,28 @@ int syscall_handle(context_t *ctx, struct tchild *child)
                 return context_remove_child(ctx, child->pid);
             child->flags &= ~TCHILD_DENYSYSCALL;
         }
-        else if (dispatch_chdir(sno, child->bitness)) {
-            /* Child is exiting a system call that may have changed its current
-             * working directory. Update current working directory.
-             */
-            if (0 > syscall_handle_chdir(child))
-                return context_remove_child(ctx, child->pid);
-        }
-        else if (child->sandbox->network && sydbox_config_get_network_auto_whitelist_bind()) {
+        else if (child->group->sandbox->network && sydbox_config_get_network_auto_whitelist_bind()) {
             if (child->bindlast != NULL &&
-                    (sflags & (DECODE_SOCKETCALL | BIND_CALL))) {
-                if (0 > syscall_handle_bind(child, sflags))
+                    (child->sflags & (DECODE_SOCKETCALL | BIND_CALL))) {
+                if (0 > syscall_handle_bind(child, child->sflags))
                     return context_remove_child(ctx, child->pid);
             }
-            if (g_hash_table_size(child->bindzero) > 0) {
-                if (dispatch_maygetsockname(sno, child->bitness, &decode)) {
-                    if (0 > syscall_handle_getsockname(child, decode))
+            if (NULL != child->files->bindzero && g_hash_table_size(child->files->bindzero) > 0) {
+                if (child->sexit & EXIT_GETSOCKNAME) {
+                    if (0 > syscall_handle_getsockname(child, child->sexit & EXIT_DECODE))
                         return context_remove_child(ctx, child->pid);
                 }
-                else if (dispatch_dup(sno, child->bitness)) {
+                else if (child->sexit & EXIT_DUP) {
                     /* Child is exiting a system call that may have duplicated a file
-                     * descriptor in child->bindzero. Update file descriptor
+                     * descriptor in child->files->bindzero. Update file descriptor
                      * information.
                      */
                     if (0 > syscall_handle_dup(child))
                         return context_remove_child(ctx, child->pid);
                 }
-                else if (dispatch_fcntl(sno, child->bitness)) {
+                else if (child->sexit & EXIT_FCNTL) {
                     /* Child is exiting a system call that may have duplicated a file
-                     * descriptor in child->bindzero. Update file descriptor
+                     * descriptor in child->files->bindzero. Update file descriptor
                      * information.
                      */
                     if (0 > syscall_handle_fcntl(child))
@@ -1622,8 +1665,225 @@ int syscall_handle(context_t *ctx, struct tchild *child)
                 }
             }
         }
+        if (child->sexit & EXIT_UNSHARE) {
+            if (0 > syscall_handle_unshare(child))
+                return context_remove_child(ctx, child->pid);
+        }
+        if (child->sexit & EXIT_CHDIR) {
+            /* Dropped once the directory has changed, a task sharing it may
+             * have looked it up while the system call was in flight.
+             * Looked up again when a relative path needs it.
+             */
+            g_free(child->fs->cwd);
+            child->fs->cwd = NULL;
+        }
+        pinkw_regs_clear(child);
     }
     child->flags ^= TCHILD_INSYSCALL;
     return 0;
 }
 
+bool syscall_need_exit(struct tchild *child)
+{
+    g_assert(child->flags & TCHILD_INSYSCALL);
+
+    if (child->flags & TCHILD_DENYSYSCALL || child->sexit & (EXIT_CHDIR | EXIT_UNSHARE))
+        return true;
+    else if (child->group->sandbox->network && sydbox_config_get_network_auto_whitelist_bind()) {
+        if (child->bindlast != NULL && (child->sflags & (DECODE_SOCKETCALL | BIND_CALL)))
+            return true;
+        if (NULL != child->files->bindzero && g_hash_table_size(child->files->bindzero) > 0 &&
+                (child->sexit & (EXIT_GETSOCKNAME | EXIT_DUP | EXIT_FCNTL)))
+            return true;
+    }
+    return false;
+}
+
+/* Serializes the system call checks of the seccomp-notify backend.
+ * Magic commands and automatic whitelisting modify the configuration and the
+ * sandbox data of the child, so they're run with the writer lock held.
+ * Everything else only reads and runs concurrently.
+ */
+static GStaticRWLock notify_lock = G_STATIC_RW_LOCK_INIT;
+
+static bool syscall_notify_isbind(struct tchild *child, struct checkdata *data)
+{
+    return child->group->sandbox->network &&
+        sydbox_config_get_network_auto_whitelist_bind() &&
+        (data->sflags & BIND_CALL ||
+         (data->sflags & DECODE_SOCKETCALL && data->subcall == PINK_SOCKET_SUBCALL_BIND));
+}
+
+static bool syscall_notify_exclusive(struct tchild *child, struct checkdata *data)
+{
+    if (data->sflags & MAGIC_STAT && NULL != data->pathlist[0] && path_magic_prefix(data->pathlist[0]))
+        return true;
+    else if (data->sflags & EXEC_CALL && LOCK_PENDING == child->group->sandbox->lock)
+        return true;
+    return syscall_notify_isbind(child, data);
+}
+
+/* Whitelists the address of an allowed bind() call for connect.
+ * There is no exit stop to peek at the address the kernel picked when the port
+ * is zero, so sydbox binds the socket itself with a copy of the child's file
+ * descriptor. The system call is replied to and never reaches the kernel then.
+ * Returns true if the system call should continue, false if it should return
+ * child->retval.
+ */
+static bool syscall_notify_bind(struct tchild *child)
+{
+    int port;
+    bool called;
+    long fd;
+    struct sydbox_addr *addr;
+
+    switch (child->bindlast->family) {
+        case AF_UNIX:
+            port = -1;
+            break;
+        case AF_INET:
+            port = child->bindlast->u.sa.port[0];
+            break;
+#if SYDBOX_HAVE_IPV6
+        case AF_INET6:
+            port = child->bindlast->u.sa6.port[0];
+            break;
+#endif /* SYDBOX_HAVE_IPV6 */
+        default:
+            g_assert_not_reached();
+    }
+
+    if (0 != port) {
+        /* Unlike the ptrace backend, the address is whitelisted whether or not
+         * the bind() call succeeds.
+         */
+        addr = child->bindlast;
+        child->bindlast = NULL;
+    }
+    else {
+        addr = pinkw_bind(child, &called);
+        if (NULL == addr) {
+            if (called) {
+                g_debug("bind() on behalf of child %i failed: %s", child->pid, g_strerror(errno));
+                child->retval = -errno;
+                return false;
+            }
+            g_info("failed to bind on behalf of child %i, not whitelisting: %s",
+                    child->pid, g_strerror(errno));
+            address_free(child->bindlast);
+            child->bindlast = NULL;
+            return true;
+        }
+        address_free(child->bindlast);
+        child->bindlast = NULL;
+        child->retval = 0;
+        g_debug("whitelisting bind address with revealed bind port for connect");
+    }
+
+    if (!pinkw_decode_socket_fd(child, 0, &fd)) {
+        g_debug("failed to get file descriptor of child %i, not whitelisting: %s",
+                child->pid, g_strerror(errno));
+        address_free(addr);
+    }
+    else
+        syscall_whitelist_bind(child, fd, addr);
+    return (0 != port);
+}
+
+/* System call handler of the seccomp-notify backend.
+ * child->sno, child->bitness and child->args describe the system call the
+ * child is blocked in, the caller replies to the notification.
+ * Returns true if the system call should continue, false if it should return
+ * child->retval.
+ */
+bool syscall_notify(context_t *ctx, struct tchild *child)
+{
+    bool exclusive, ret;
+    struct checkdata data;
+
+    memset(&data, 0, sizeof(struct checkdata));
+    data.sno = child->sno;
+    data.sflags = child->sflags = dispatch_lookup(data.sno, child->bitness)->flags;
+    data.sname = pink_name_syscall(data.sno, child->bitness);
+    g_debug_trace("child %i is entering system call %lu(%s)", child->pid, data.sno, data.sname);
+    if (0 == data.sflags)
+        return true;
+    data.arena = syscall_arena();
+
+    /* Reading the arguments only touches the child */
+    syscall_check_start(ctx, child, &data);
+
+    exclusive = syscall_notify_exclusive(child, &data);
+    if (exclusive)
+        g_static_rw_lock_writer_lock(&notify_lock);
+    else
+        g_static_rw_lock_reader_lock(&notify_lock);
+
+    syscall_check_flags(child, &data);
+    syscall_check_magic(child, &data);
+    syscall_check_resolve(child, &data);
+    syscall_check_canonicalize(ctx, child, &data);
+    syscall_check(ctx, child, &data);
+    syscall_check_finalize(ctx, child, &data);
+
+    switch (data.result) {
+        case RS_ERROR:
+            errno = data.save_errno;
+            if (EIO == errno)
+                errno = EFAULT;
+            else if (ESRCH != errno && EFAULT != errno)
+                g_warning("error while checking system call %lu(%s) for access: %s",
+                        data.sno, data.sname, g_strerror(errno));
+            child->retval = -errno;
+            /* fall through */
+        case RS_DENY:
+            g_debug("denying access to system call %lu(%s)", data.sno, data.sname);
+            ret = false;
+            break;
+        case RS_ALLOW:
+        case RS_NOWRITE:
+        case RS_MAGIC:
+            g_debug_trace("allowing access to system call %lu(%s)", data.sno, data.sname);
+            ret = true;
+            /* There is no exec event, lock as soon as execve() is allowed */
+            if (data.sflags & EXEC_CALL && LOCK_PENDING == child->group->sandbox->lock) {
+                g_info("access to magic commands is now denied for child %i", child->pid);
+                tchild_unshare(child);
+                child->group->sandbox->lock = LOCK_SET;
+            }
+            if (NULL != child->bindlast)
+                ret = syscall_notify_bind(child);
+            break;
+        default:
+            g_assert_not_reached();
+    }
+
+    if (exclusive)
+        g_static_rw_lock_writer_unlock(&notify_lock);
+    else
+        g_static_rw_lock_reader_unlock(&notify_lock);
+    return ret;
+}
+
+/* Drops the automatically whitelisted addresses of the closed sockets, a
+ * connect() may be checked concurrently.
+ */
+void syscall_notify_sweep(void)
+{
+    g_static_rw_lock_writer_lock(&notify_lock);
+    sydbox_config_sweep_whitelist_auto();
+    g_static_rw_lock_writer_unlock(&notify_lock);
+}
+
+/* Inherits the sandbox data of parent, which may be checking a magic command
+ * concurrently. Threads don't join the thread group of parent here, the
+ * workers may check two threads of a group at once. The group of an untraced
+ * child is only used by her own worker, tchild_inherit() doesn't read the
+ * current working directory of parent.
+ */
+void syscall_notify_inherit(struct tchild *child, struct tchild *parent)
+{
+    g_static_rw_lock_reader_lock(&notify_lock);
+    tchild_inherit(child, parent, 0);
+    g_static_rw_lock_reader_unlock(&notify_lock);
+}
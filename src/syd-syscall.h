@@ -20,10 +20,20 @@
 #ifndef SYDBOX_GUARD_SYSCALL_H
 #define SYDBOX_GUARD_SYSCALL_H 1
 
+#include <stdbool.h>
+
 #include "syd-children.h"
 #include "syd-context.h"
 
 int syscall_handle(context_t *ctx, struct tchild *child);
 
+bool syscall_need_exit(struct tchild *child);
+
+bool syscall_notify(context_t *ctx, struct tchild *child);
+
+void syscall_notify_inherit(struct tchild *child, struct tchild *parent);
+
+void syscall_notify_sweep(void);
+
 #endif // SYDBOX_GUARD_SYSCALL_H
 
@@ -22,8 +22,8 @@
 #endif // HAVE_CONFIG_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
-#include <fnmatch.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -37,9 +37,11 @@ static void sydbox_access_violation_va(struct tchild *child, const gchar *fmt, v
 {
     bool colour;
     time_t now;
+    const char *cwd;
 
     colour = sydbox_config_get_colourise_output();
     now = time(NULL);
+    cwd = tchild_getcwd(child);
 
     g_fprintf(stderr, PACKAGE "@%lu: %sAccess Violation!%s\n", now,
             colour ? ANSI_MAGENTA : "",
@@ -52,12 +54,12 @@ static void sydbox_access_violation_va(struct tchild *child, const gchar *fmt, v
     g_fprintf(stderr, PACKAGE "@%lu: %sChild CWD: %s%s%s\n", now,
             colour ? ANSI_MAGENTA : "",
             colour ? ANSI_DARK_MAGENTA : "",
-            child->cwd,
+            (NULL != cwd) ? cwd : "?",
             colour ? ANSI_NORMAL : "");
     g_fprintf(stderr, PACKAGE "@%lu: %sLast Exec: %s%s%s\n", now,
             colour ? ANSI_MAGENTA : "",
             colour ? ANSI_DARK_MAGENTA : "",
-            child->lastexec->str,
+            (NULL != child->group->lastexec) ? child->group->lastexec->str : "?",
             colour ? ANSI_NORMAL : "");
     g_fprintf(stderr, PACKAGE "@%lu: %sReason: %s", now,
             colour ? ANSI_MAGENTA : "",
@@ -71,16 +73,11 @@ static void sydbox_access_violation_va(struct tchild *child, const gchar *fmt, v
 void sydbox_access_violation_path(struct tchild *child, const gchar *path, const gchar *fmt, ...)
 {
     va_list args;
-    GSList *walk;
+    const gchar *pattern;
 
-    for (walk = sydbox_config_get_filters(); walk != NULL; walk = g_slist_next(walk)) {
-        gchar *pattern = (gchar *)walk->data;
-        if (0 == fnmatch(pattern, path, FNM_PATHNAME)) {
-            g_debug("pattern `%s' matches path `%s', ignoring the access violation", pattern, path);
-            return;
-        }
-        else
-            g_debug("pattern `%s' doesn't match path `%s'", pattern, path);
+    if (NULL != (pattern = sydbox_config_match_filter(path))) {
+        g_debug("pattern `%s' matches path `%s', ignoring the access violation", pattern, path);
+        return;
     }
 
     va_start(args, fmt);
@@ -91,16 +88,11 @@ void sydbox_access_violation_path(struct tchild *child, const gchar *path, const
 void sydbox_access_violation_exec(struct tchild *child, const gchar *path, const gchar *fmt, ...)
 {
     va_list args;
-    GSList *walk;
+    const gchar *pattern;
 
-    for (walk = sydbox_config_get_exec_filters(); walk != NULL; walk = g_slist_next(walk)) {
-        gchar *pattern = (gchar *)walk->data;
-        if (0 == fnmatch(pattern, path, FNM_PATHNAME)) {
-            g_debug("pattern `%s' matches path `%s', ignoring the access violation", pattern, path);
-            return;
-        }
-        else
-            g_debug("pattern `%s' doesn't match path `%s'", pattern, path);
+    if (NULL != (pattern = sydbox_config_match_exec_filter(path))) {
+        g_debug("pattern `%s' matches path `%s', ignoring the access violation", pattern, path);
+        return;
     }
 
     va_start(args, fmt);
@@ -111,13 +103,10 @@ void sydbox_access_violation_exec(struct tchild *child, const gchar *path, const
 void sydbox_access_violation_net(struct tchild *child, struct sydbox_addr *addr, const gchar *fmt, ...)
 {
     va_list args;
-    GSList *walk;
 
-    for (walk = sydbox_config_get_network_filters(); walk != NULL; walk = g_slist_next(walk)) {
-        if (address_has(walk->data, addr)) {
-            g_debug("filter matches address, ignoring the access violation");
-            return;
-        }
+    if (sydbox_config_match_network_filter(addr)) {
+        g_debug("filter matches address, ignoring the access violation");
+        return;
     }
 
     va_start(args, fmt);
@@ -129,11 +118,12 @@ gchar *sydbox_compress_path(const gchar * const path)
 {
     bool skip_slashes = false;
     GString *compressed;
-    guint i;
+    gsize i, len;
 
-    compressed = g_string_sized_new(strlen(path));
+    len = strlen(path);
+    compressed = g_string_sized_new(len);
 
-    for (i = 0; i < strlen(path); i++) {
+    for (i = 0; i < len; i++) {
         if (path[i] == '/' && skip_slashes)
             continue;
         skip_slashes = (path[i] == '/');
@@ -148,3 +138,54 @@ gchar *sydbox_compress_path(const gchar * const path)
     return g_string_free(compressed, FALSE);
 }
 
+/* Appends the components of src to the normalized path in buf ending at dest.
+ * strchrnul() finds the end of a component, which glibc does a word or vector
+ * at a time.
+ */
+static gchar *normalize_append(gchar *buf, gchar *dest, const gchar *src, pid_t pid)
+{
+    gsize len;
+    const gchar *end;
+
+    for (;;) {
+        while ('/' == *src)
+            src++;
+        if ('\0' == *src)
+            return dest;
+
+        end = strchrnul(src, '/');
+        len = end - src;
+        if (1 == len && '.' == src[0])
+            ; /* nothing */
+        else if (0 != pid && 4 == len && 0 == memcmp(src, "self", 4) &&
+                5 == dest - buf && 0 == memcmp(buf, "/proc", 5))
+            dest += sprintf(dest, "/%i", pid);
+        else {
+            *dest++ = '/';
+            memcpy(dest, src, len);
+            dest += len;
+        }
+        src = end;
+    }
+}
+
+gsize sydbox_normalize_path_size(const gchar *dir, const gchar *path)
+{
+    /* /proc/self may become /proc/PID */
+    return ((NULL != dir) ? strlen(dir) + 1 : 0) + strlen(path) + 16;
+}
+
+gsize sydbox_normalize_path(gchar *buf, const gchar *dir, const gchar *path, pid_t pid)
+{
+    gchar *dest;
+
+    dest = buf;
+    if (NULL != dir && '/' != path[0])
+        dest = normalize_append(buf, dest, dir, pid);
+    dest = normalize_append(buf, dest, path, pid);
+    if (dest == buf)
+        *dest++ = '/';
+    *dest = '\0';
+    return dest - buf;
+}
+
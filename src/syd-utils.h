@@ -20,6 +20,8 @@
 #ifndef SYDBOX_GUARD_UTILS_H
 #define SYDBOX_GUARD_UTILS_H 1
 
+#include <sys/types.h>
+
 #include <glib.h>
 
 #include "syd-children.h"
@@ -94,5 +96,24 @@ void sydbox_access_violation_net(struct tchild *child, struct sydbox_addr *addr,
  **/
 gchar *sydbox_compress_path(const gchar * const path);
 
+/**
+ * sydbox_normalize_path:
+ * @buf: the buffer to write the path to, at least
+ *   sydbox_normalize_path_size() bytes long
+ * @dir: the directory a relative @path is looked up from
+ * @path: the path to normalize
+ * @pid: the process ID to replace /proc/self with or zero
+ *
+ * Makes @path absolute with @dir, replaces runs of forward slashes with a
+ * single slash, drops `.' components and trailing slashes and replaces
+ * /proc/self with /proc/@pid in a single pass.  `..' components are kept,
+ * this does not canonicalise the path either!
+ *
+ * Returns: the length of the path written to @buf.
+ **/
+gsize sydbox_normalize_path(gchar *buf, const gchar *dir, const gchar *path, pid_t pid);
+
+gsize sydbox_normalize_path_size(const gchar *dir, const gchar *path);
+
 #endif // SYDBOX_GUARD_UTILS_H
 
@@ -19,31 +19,6 @@
  * Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
-/* The following copyright pertains to egetcwd, echdir */
-/*
- * Copyright (c) 1992-1997 Paul Falstad
- *
- * Permission is hereby granted, without written agreement and without
- * license or royalty fees, to use, copy, modify, and distribute this
- * software and to distribute modified versions of this software for any
- * purpose, provided that the above copyright notice and the following
- * two paragraphs appear in all copies of this software.
- *
- * In no event shall Paul Falstad or the Zsh Development Group be liable
- * to any party for direct, indirect, special, incidental, or consequential
- * damages arising out of the use of this software and its documentation,
- * even if Paul Falstad and the Zsh Development Group have been advised of
- * the possibility of such damage.
- *
- * Paul Falstad and the Zsh Development Group specifically disclaim any
- * warranties, including, but not limited to, the implied warranties of
- * merchantability and fitness for a particular purpose.  The software
- * provided hereunder is on an "as is" basis, and Paul Falstad and the
- * Zsh Development Group have no obligation to provide maintenance,
- * support, updates, enhancements, or modifications.
- *
- */
-
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif // HAVE_CONFIG_H
@@ -51,17 +26,24 @@
 #include <errno.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include <stddef.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#ifdef HAVE_LINUX_OPENAT2_H
+#include <linux/openat2.h>
+#endif // HAVE_LINUX_OPENAT2_H
 
 #include <glib.h>
 
 #include "syd-config.h"
+#include "syd-log.h"
 #include "syd-path.h"
 #include "syd-wrappers.h"
 
@@ -69,6 +51,10 @@
 # define MAXSYMLINKS 256
 #endif
 
+#if defined(HAVE_LINUX_OPENAT2_H) && defined(__NR_openat2)
+# define CANON_OPENAT2 1
+#endif
+
 // dirname wrapper which doesn't modify its argument
 gchar *
 edirname (const gchar *path)
@@ -83,9 +69,63 @@ ebasename (const gchar *path)
     return g_path_get_basename(path);
 }
 
-// readlink that allocates the string itself and appends a zero at the end
-gchar *
-ereadlink (const gchar *path)
+/* Opens the directory containing the last component of PATH with O_PATH.
+ * PATH is walked in pieces shorter than PATH_MAX relative to the directory
+ * opened last, so its length doesn't matter.  Symlinks in the directory part
+ * are followed like lstat() would.  On success BASE points to the last
+ * component of PATH.
+ */
+static int
+eopenparent (const gchar *path, const gchar **base)
+{
+    int fd, newfd, save_errno;
+    char *piece;
+    char const *start, *end, *last;
+
+    last = strrchr (path, '/');
+    if (NULL == last) {
+        errno = EINVAL;
+        return -1;
+    }
+    *base = last + 1;
+
+    if (0 > (fd = open ("/", O_PATH | O_DIRECTORY)))
+        return -1;
+    for (start = path; ; start = end) {
+        while (*start == '/')
+            ++start;
+        if (start >= last)
+            break;
+
+        end = last;
+        if (end - start >= PATH_MAX) {
+            /* The longest piece ending at a separator that fits */
+            for (end = start + PATH_MAX - 1; end > start && *end != '/'; --end)
+                /* Nothing.  */;
+            if (end == start) {
+                close (fd);
+                errno = ENAMETOOLONG;
+                return -1;
+            }
+        }
+
+        piece = g_strndup (start, end - start);
+        newfd = openat (fd, piece, O_PATH | O_DIRECTORY);
+        save_errno = errno;
+        g_free (piece);
+        close (fd);
+        if (0 > newfd) {
+            errno = save_errno;
+            return -1;
+        }
+        fd = newfd;
+    }
+    return fd;
+}
+
+// readlinkat that allocates the string itself and appends a zero at the end
+static gchar *
+ereadlinkat (int dirfd, const gchar *path)
 {
     char *buf;
     long nrequested, nwritten;
@@ -94,7 +134,7 @@ ereadlink (const gchar *path)
     nrequested = 32;
     for (;;) {
         buf = g_realloc (buf, nrequested);
-        nwritten = readlink(path, buf, nrequested);
+        nwritten = readlinkat(dirfd, path, buf, nrequested);
         if (G_UNLIKELY(0 > nwritten)) {
             g_free (buf);
             return NULL;
@@ -108,180 +148,133 @@ ereadlink (const gchar *path)
     return buf;
 }
 
-
-/* chdir with arbitrary long pathname.  Returns 0 on success, -1 on normal *
- * failure and -2 when chdir failed and the current directory is lost.  */
-
-int
-echdir (gchar *dir)
+// readlink that allocates the string itself and appends a zero at the end
+gchar *
+ereadlink (const gchar *path)
 {
-    char *s;
-    int currdir = -2;
+    int fd, save_errno;
+    char *buf;
+    const gchar *base;
 
-    for (;;) {
-        if (!*dir || chdir(dir) == 0) {
-#ifdef HAVE_FCHDIR
-            if (currdir >= 0)
-                close(currdir);
-#endif
-            return 0;
-        }
-        if ((errno != ENAMETOOLONG && errno != ENOMEM) ||
-                strlen(dir) < PATH_MAX)
-            break;
-        for (s = dir + PATH_MAX - 1; s > dir && *s != '/'; s--)
-            ;
-        if (s == dir)
-            break;
-#ifdef HAVE_FCHDIR
-        if (currdir == -2)
-            currdir = open(".", O_RDONLY|O_NOCTTY);
-#endif
-        *s = '\0';
-        if (chdir(dir) < 0) {
-            *s = '/';
-            break;
-        }
-#ifndef HAVE_FCHDIR
-        currdir = -1;
-#endif
-        *s = '/';
-        while (*++s == '/')
-            ;
-        dir = s;
-    }
-#ifdef HAVE_FCHDIR
-    if (currdir >= 0) {
-        if (fchdir(currdir) < 0) {
-            close(currdir);
-            return -2;
-        }
-        close(currdir);
-        return -1;
-    }
-#endif
-    return currdir == -2 ? -1 : -2;
+    buf = ereadlinkat(AT_FDCWD, path);
+    if (G_LIKELY(NULL != buf) || ENAMETOOLONG != errno)
+        return buf;
+
+    if (0 > (fd = eopenparent(path, &base)))
+        return NULL;
+    buf = ereadlinkat(fd, base);
+    save_errno = errno;
+    close(fd);
+    errno = save_errno;
+    return buf;
 }
 
+/* Returns the path of the directory DIRFD, which must have been opened with
+ * O_DIRECTORY.  Names which the kernel can't return because they're too long
+ * are found by walking up through `..' one directory at a time until the rest
+ * of the path is short enough, or ROOTFD, the root directory of the process
+ * the path belongs to, is reached.  Neither changes the current working
+ * directory.
+ */
 gchar *
-egetcwd (void)
+edirpath (int dirfd, int rootfd)
 {
-    char nbuf[PATH_MAX+3];
-    char *buf;
-    int bufsiz, pos;
-    struct stat sbuf;
-    ino_t pino;
-    dev_t pdev;
-    struct dirent *de;
+    bool found;
+    int fd, pfd, save_errno;
+    char link[64];
+    gchar *name, *prefix;
+    GSList *walk, *names;
+    GString *path;
     DIR *dir;
-    dev_t dev;
-    ino_t ino;
-    int len;
-    int save_errno;
+    struct dirent *de;
+    struct stat root, st, pst, est;
 
-#ifdef HAVE_GETCWD_NULL
-    /* First try getcwd() */
-    buf = getcwd(NULL, 0);
-    if (NULL != buf)
-        return buf;
-    else if (ENAMETOOLONG != errno)
+    if (0 > fstatat(rootfd, "", &root, AT_EMPTY_PATH))
         return NULL;
-#endif /* HAVE_GETCWD_NULL */
-
-    /* Next try stat()'ing and chdir()'ing up */
-    bufsiz = PATH_MAX;
-    buf = g_malloc0 (bufsiz);
-    pos = bufsiz - 1;
-    buf[pos] = '\0';
-    strcpy(nbuf, "../");
-    if (0 > stat(".", &sbuf)) {
-        g_free (buf);
+    if (0 > (fd = openat(dirfd, ".", O_PATH | O_DIRECTORY)))
         return NULL;
-    }
-
-    /* Record the initial inode and device */
-    pino = sbuf.st_ino;
-    pdev = sbuf.st_dev;
 
+    names = NULL;
+    prefix = NULL;
     for (;;) {
-        if (0 > stat("..", &sbuf))
+        if (0 > fstatat(fd, "", &st, AT_EMPTY_PATH))
+            goto fail;
+        if (st.st_dev == root.st_dev && st.st_ino == root.st_ino)
             break;
 
-        /* Inode and device of current directory */
-        ino = pino;
-        dev = pdev;
-        /* Inode and device of current directory's parent */
-        pino = sbuf.st_ino;
-        pdev = sbuf.st_dev;
-
-        /* If they're the same, we've reached the root directory. */
-        if (ino == pino && dev == pdev) {
-            if (!buf[pos])
-                buf[--pos] = '/';
-            char *s = g_strdup (buf + pos);
-            g_free (buf);
-            echdir(s);
-            return s;
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        prefix = ereadlinkat(AT_FDCWD, link);
+        if (NULL != prefix) {
+            if (0 == strcmp(prefix, "/")) {
+                g_free(prefix);
+                prefix = NULL;
+            }
+            break;
         }
-
-        /* Search the parent for the current directory. */
-        dir = opendir("..");
-        if (NULL == dir) {
-            save_errno = errno;
-            g_debug("opendir() failed: %s", g_strerror(errno));
-            errno = save_errno;
+        else if (ENAMETOOLONG != errno)
+            goto fail;
+
+        /* Look the directory up in its parent */
+        if (0 > (pfd = openat(fd, "..", O_RDONLY | O_DIRECTORY)))
+            goto fail;
+        if (0 > fstat(pfd, &pst) || (pst.st_dev == st.st_dev && pst.st_ino == st.st_ino)) {
+            close(pfd);
             break;
         }
-
-        while ((de = readdir(dir))) {
-            char *fn = de->d_name;
-            /* Ignore `.' and `..'. */
-            if (fn[0] == '.' &&
-                (fn[1] == '\0' ||
-                 (fn[1] == '.' && fn[2] == '\0')))
+        if (NULL == (dir = fdopendir(openat(pfd, ".", O_RDONLY | O_DIRECTORY)))) {
+            close(pfd);
+            goto fail;
+        }
+        found = false;
+        while (!found && NULL != (de = readdir(dir))) {
+            if (0 == strcmp(de->d_name, ".") || 0 == strcmp(de->d_name, ".."))
                 continue;
-            if (dev != pdev || (ino_t) de->d_ino == ino) {
-                /* Maybe found directory, need to check device & inode */
-                strncpy(nbuf + 3, fn, PATH_MAX);
-                lstat(nbuf, &sbuf);
-                if (sbuf.st_dev == dev && sbuf.st_ino == ino)
-                    break;
+            /* d_ino of a mount point is the inode of the directory underneath */
+            if (pst.st_dev == st.st_dev && de->d_ino != st.st_ino)
+                continue;
+            if (0 == fstatat(pfd, de->d_name, &est, AT_SYMLINK_NOFOLLOW) &&
+                    est.st_dev == st.st_dev && est.st_ino == st.st_ino) {
+                names = g_slist_prepend(names, g_strdup(de->d_name));
+                found = true;
             }
         }
         closedir(dir);
-        if (!de)
-            break; /* Not found */
-        len = strlen(nbuf + 2);
-        pos -= len;
-        while (pos <= 1) {
-            char *temp;
-            char *newbuf = g_malloc0 (2 * bufsiz);
-            memcpy(newbuf + bufsiz, buf, bufsiz);
-            temp = buf;
-            buf = newbuf;
-            g_free (temp);
-            pos += bufsiz;
-            bufsiz *= 2;
+        close(fd);
+        fd = pfd;
+        if (!found) {
+            errno = ENOENT;
+            goto fail;
         }
-        memcpy(buf + pos, nbuf + 2, len);
-
-        if (0 > chdir(".."))
-            break;
     }
+    close(fd);
 
-    if (*buf) {
-        g_debug("changing current working directory to `%s'", buf + pos + 1);
-        echdir(buf + pos + 1);
+    path = g_string_new(prefix ? prefix : "");
+    for (walk = names; NULL != walk; walk = g_slist_next(walk)) {
+        g_string_append_c(path, '/');
+        g_string_append(path, walk->data);
     }
-    g_free (buf);
+    if (0 == path->len)
+        g_string_append_c(path, '/');
+    g_slist_foreach(names, (GFunc) g_free, NULL);
+    g_slist_free(names);
+    g_free(prefix);
+    name = g_string_free(path, FALSE);
+    return name;
+
+fail:
+    save_errno = errno;
+    close(fd);
+    g_slist_foreach(names, (GFunc) g_free, NULL);
+    g_slist_free(names);
+    errno = save_errno;
     return NULL;
 }
 
-// lstat() wrapper that tries to take care of ENAMETOOLONG by chdir()'ing
+// lstat() wrapper that takes care of ENAMETOOLONG by walking the path in pieces
 static int elstat(const char *path, struct stat *buf)
 {
-    int ret, save_errno;
-    char *dname, *bname;
+    int fd, ret, save_errno;
+    const gchar *base;
 
     ret = lstat(path, buf);
     if (G_LIKELY(0 == ret))
@@ -291,44 +284,31 @@ static int elstat(const char *path, struct stat *buf)
     else if (!sydbox_config_get_wrap_lstat())
         return ret;
 
-    dname = edirname(path);
-    bname = ebasename(path);
-
-    // chdir() to the target directory
-    ret = echdir(dname);
-    if (G_UNLIKELY(0 != ret)) {
-        /* failed to change the directory
-         * nothing else to do.
-         */
-        g_free(dname);
-        g_free(bname);
-        errno = ENAMETOOLONG;
+    if (0 > (fd = eopenparent(path, &base)))
         return -1;
-    }
-    ret = lstat(bname, buf);
+    ret = fstatat(fd, ('\0' == *base) ? "." : base, buf, AT_SYMLINK_NOFOLLOW);
     save_errno = errno;
-    g_free(dname);
-    g_free(bname);
+    close(fd);
     errno = save_errno;
     return ret;
 }
 
-/* Return the canonical absolute name of file NAME.  A canonical name
-   does not contain any `.', `..' components nor any repeated file name
-   separators ('/') or symlinks.  Whether components must exist
-   or not depends on canonicalize mode.  The result is malloc'd.  */
+/* Canonicalizes NAME like canonicalize_filename_mode().  If BASE isn't NULL
+   it's the canonical name of an existing directory and NAME is looked up
+   relative to it.  */
 
-gchar *
-canonicalize_filename_mode (const gchar *name,
-                            canonicalize_mode_t can_mode,
-                            bool resolve)
+static gchar *
+canonicalize_walk (const gchar *name,
+                   const gchar *base,
+                   canonicalize_mode_t can_mode,
+                   bool resolve)
 {
     int readlinks = 0;
     char *rname, *dest, *extra_buf = NULL;
     char const *start;
     char const *end;
     char const *rname_limit;
-    size_t extra_len = 0;
+    size_t base_len, extra_len = 0;
 
     if (name == NULL) {
         errno = EINVAL;
@@ -355,10 +335,19 @@ canonicalize_filename_mode (const gchar *name,
     }
 #endif
     g_assert(g_path_is_absolute(name));
-    rname = g_malloc (PATH_MAX);
-    rname_limit = rname + PATH_MAX;
-    rname[0] = '/';
-    dest = rname + 1;
+    if (base != NULL) {
+        base_len = strlen(base);
+        rname = g_malloc (base_len + PATH_MAX);
+        rname_limit = rname + base_len + PATH_MAX;
+        dest = memcpy (rname, base, base_len + 1);
+        dest += base_len;
+    }
+    else {
+        rname = g_malloc (PATH_MAX);
+        rname_limit = rname + PATH_MAX;
+        rname[0] = '/';
+        dest = rname + 1;
+    }
 
     for (start = end = name; *start; start = end) {
         /* Skip sequence of multiple file name separators.  */
@@ -474,3 +463,251 @@ error:
   return NULL;
 }
 
+/* Cache of canonicalized directories.
+ * Building software looks up the same directories, like /usr/include, over and
+ * over again.  Walking them costs an lstat() for every component, the cache
+ * replaces this with one stat() of the directory whose device, inode and
+ * change time must match the cached ones.  System calls like rename() which
+ * may change how names resolve flush the cache.
+ */
+#define CANON_CACHE_MAX 4096
+
+struct canonentry
+{
+    gchar *canonical;
+    dev_t dev;
+    ino_t ino;
+    struct timespec ctime;
+};
+
+static GStaticMutex canon_mutex = G_STATIC_MUTEX_INIT;
+static GHashTable *canon_cache = NULL;
+static guint64 canon_hits = 0;
+static guint64 canon_misses = 0;
+
+static void
+canonentry_free (gpointer entry_ptr)
+{
+    struct canonentry *entry = (struct canonentry *) entry_ptr;
+
+    g_free (entry->canonical);
+    g_free (entry);
+}
+
+static inline bool
+canonentry_valid (const struct canonentry *entry, const struct stat *st)
+{
+    return entry->dev == st->st_dev &&
+        entry->ino == st->st_ino &&
+        entry->ctime.tv_sec == st->st_ctim.tv_sec &&
+        entry->ctime.tv_nsec == st->st_ctim.tv_nsec;
+}
+
+/* Returns the canonical name of the existing directory DIR, NULL if DIR can't
+   be looked up through the cache.  */
+static gchar *
+canonicalize_dir (const gchar *dir)
+{
+    gchar *canonical;
+    struct stat st;
+    struct canonentry *entry;
+
+    if (0 != stat (dir, &st) || !S_ISDIR (st.st_mode))
+        return NULL;
+
+    g_static_mutex_lock (&canon_mutex);
+    if (NULL == canon_cache)
+        canon_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, canonentry_free);
+    entry = g_hash_table_lookup (canon_cache, dir);
+    if (NULL != entry && canonentry_valid (entry, &st)) {
+        ++canon_hits;
+        canonical = g_strdup (entry->canonical);
+        g_static_mutex_unlock (&canon_mutex);
+        return canonical;
+    }
+    ++canon_misses;
+    g_static_mutex_unlock (&canon_mutex);
+
+    /* The parent directory is looked up through the cache in turn.  */
+    canonical = canonicalize_filename_mode (dir, CAN_EXISTING, true);
+    if (NULL == canonical)
+        return NULL;
+
+    entry = g_new (struct canonentry, 1);
+    entry->canonical = g_strdup (canonical);
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->ctime = st.st_ctim;
+
+    g_static_mutex_lock (&canon_mutex);
+    if (g_hash_table_size (canon_cache) >= CANON_CACHE_MAX)
+        g_hash_table_remove_all (canon_cache);
+    g_hash_table_replace (canon_cache, g_strdup (dir), entry);
+    g_static_mutex_unlock (&canon_mutex);
+    return canonical;
+}
+
+#ifdef CANON_OPENAT2
+/* Set once the kernel turns out not to know about openat2().  */
+static volatile bool openat2_missing = false;
+
+/* Returns NAME without `.', `..' and repeated file name separators, resolving
+   `..' lexically like canonicalize_walk() does.  The file system isn't looked
+   at, this is only canonical if NAME has no symlinks in it.  */
+static gchar *
+normalize_filename (const gchar *name)
+{
+    size_t len;
+    char *rname, *dest;
+    char const *start, *end;
+
+    /* Names from sydbox_normalize_path() only have to be copied.  */
+    len = strlen (name);
+    if (name[len - 1] != '/' && strstr (name, "//") == NULL &&
+        strstr (name, "/.") == NULL)
+        return g_strndup (name, len);
+
+    rname = g_malloc (len + 2);
+    rname[0] = '/';
+    dest = rname + 1;
+
+    for (start = end = name; *start; start = end) {
+        while (*start == '/')
+            ++start;
+
+        for (end = start; *end && *end != '/'; ++end)
+            /* Nothing.  */;
+
+        if (end - start == 0)
+            break;
+        else if (end - start == 1 && start[0] == '.')
+            /* nothing */;
+        else if (end - start == 2 && start[0] == '.' && start[1] == '.') {
+            if (dest > rname + 1)
+                while ((--dest)[-1] != '/');
+        }
+        else {
+            if (dest[-1] != '/')
+                *dest++ = '/';
+            memcpy (dest, start, end - start);
+            dest += end - start;
+        }
+    }
+    if (dest > rname + 1 && dest[-1] == '/')
+        --dest;
+    *dest = '\0';
+
+    return rname;
+}
+
+/* Lets the kernel look up the absolute name NAME in one go, refusing to
+   follow any symlinks on the way.  A symlink as the last component is fine
+   unless RESOLVE is true.  Returns 1 and stores the canonical name in RNAME if
+   NAME has no symlinks to resolve, -1 with errno set if NAME doesn't exist and
+   can't be canonicalized with CAN_MODE, 0 if NAME has to be walked component
+   by component.  */
+static int
+canonicalize_openat2 (const gchar *name,
+                      canonicalize_mode_t can_mode,
+                      bool resolve,
+                      gchar **rname)
+{
+    int fd;
+    struct open_how how;
+
+    if (openat2_missing)
+        return 0;
+
+    memset (&how, 0, sizeof (struct open_how));
+    how.flags = O_PATH | O_CLOEXEC;
+    if (!resolve)
+        how.flags |= O_NOFOLLOW;
+    how.resolve = RESOLVE_NO_SYMLINKS | RESOLVE_NO_MAGICLINKS;
+    fd = syscall (__NR_openat2, AT_FDCWD, name, &how, sizeof (struct open_how));
+    if (fd >= 0) {
+        close (fd);
+        *rname = normalize_filename (name);
+        return 1;
+    }
+
+    switch (errno) {
+    case ENOSYS:
+        openat2_missing = true;
+        return 0;
+    case ENOENT:
+    case ENOTDIR:
+        /* The kernel stops at the same component the walk would, unless a
+           missing component may be created.  */
+        return (can_mode == CAN_EXISTING) ? -1 : 0;
+    default:
+        /* ELOOP for symlinks, ENAMETOOLONG for long names...  */
+        return 0;
+    }
+}
+#endif // CANON_OPENAT2
+
+/* Return the canonical absolute name of file NAME.  A canonical name
+   does not contain any `.', `..' components nor any repeated file name
+   separators ('/') or symlinks.  Whether components must exist
+   or not depends on canonicalize mode.  The result is malloc'd.  */
+
+gchar *
+canonicalize_filename_mode (const gchar *name,
+                            canonicalize_mode_t can_mode,
+                            bool resolve)
+{
+    char const *last;
+    gchar *dir, *base, *rname;
+
+#ifdef CANON_OPENAT2
+    if (name != NULL && name[0] == '/') {
+        switch (canonicalize_openat2 (name, can_mode, resolve, &rname)) {
+        case 1:
+            return rname;
+        case -1:
+            return NULL;
+        default:
+            break;
+        }
+    }
+#endif // CANON_OPENAT2
+
+    /* Without resolving, symlinks in the directory part are kept as they are
+       and the cached names don't apply.  */
+    if (!resolve || name == NULL || name[0] != '/')
+        return canonicalize_walk (name, NULL, can_mode, resolve);
+
+    last = strrchr (name, '/');
+    if (last == name)
+        return canonicalize_walk (name, NULL, can_mode, resolve);
+
+    dir = g_strndup (name, last - name);
+    base = canonicalize_dir (dir);
+    g_free (dir);
+    if (base == NULL) {
+        /* Walk the whole name, this sets errno like before.  */
+        return canonicalize_walk (name, NULL, can_mode, resolve);
+    }
+
+    rname = canonicalize_walk (last, base, can_mode, resolve);
+    g_free (base);
+    return rname;
+}
+
+void
+canonicalize_cache_flush (void)
+{
+    g_static_mutex_lock (&canon_mutex);
+    if (NULL != canon_cache)
+        g_hash_table_remove_all (canon_cache);
+    g_static_mutex_unlock (&canon_mutex);
+}
+
+void
+canonicalize_cache_stats (guint64 *hits, guint64 *misses)
+{
+    g_static_mutex_lock (&canon_mutex);
+    *hits = canon_hits;
+    *misses = canon_misses;
+    g_static_mutex_unlock (&canon_mutex);
+}
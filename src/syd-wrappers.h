@@ -37,11 +37,13 @@ gchar *ebasename(const gchar *path);
 
 gchar *ereadlink(const gchar *path);
 
-gchar *egetcwd(void);
-
-int echdir(gchar *dir);
+gchar *edirpath(int dirfd, int rootfd);
 
 gchar *canonicalize_filename_mode(const gchar *name, canonicalize_mode_t can_mode, bool resolve);
 
+void canonicalize_cache_flush(void);
+
+void canonicalize_cache_stats(guint64 *hits, guint64 *misses);
+
 #endif // SYDBOX_GUARD_WRAPPERS_H
 
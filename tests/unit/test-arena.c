@@ -0,0 +1,112 @@
+/* vim: set et ts=4 sts=4 sw=4 fdm=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "syd-arena.h"
+#include "syd-utils.h"
+
+static void test1(void)
+{
+    struct arena arena;
+    gchar *first, *second;
+
+    arena_init(&arena, 1024);
+    first = arena_strdup(&arena, "/dev/null");
+    second = arena_strndup(&arena, "/dev/zero", 4);
+    g_assert_cmpstr(first, ==, "/dev/null");
+    g_assert_cmpstr(second, ==, "/dev");
+    g_assert(0 == (GPOINTER_TO_SIZE(second) % sizeof(gpointer)));
+    g_assert_cmpint(arena.blocks, ==, 1);
+
+    /* The memory is handed out again after a reset */
+    arena_reset(&arena);
+    g_assert(first == arena_alloc(&arena, 1));
+    g_assert_cmpint(arena.blocks, ==, 1);
+    arena_free(&arena);
+}
+
+static void test2(void)
+{
+    struct arena arena;
+
+    arena_init(&arena, 64);
+    for (unsigned int i = 0; i < 16; i++)
+        arena_alloc(&arena, 48);
+    g_assert_cmpint(arena.blocks, ==, 16);
+
+    /* The next check fits into one block */
+    arena_reset(&arena);
+    for (unsigned int round = 0; round < 4; round++) {
+        for (unsigned int i = 0; i < 16; i++)
+            arena_alloc(&arena, 48);
+        arena_reset(&arena);
+    }
+    g_assert_cmpint(arena.blocks, ==, 17);
+
+    /* A single allocation larger than a block gets a block of its own */
+    memset(arena_alloc(&arena, 4096), 0, 4096);
+    g_assert_cmpint(arena.blocks, ==, 18);
+    arena_free(&arena);
+}
+
+static void test3(void)
+{
+    guint64 before = 0;
+    struct arena arena;
+    gchar *cwd, *dir, *arg, *path;
+
+    /* What checks of a relative path and of a path relative to a directory
+     * descriptor allocate, see syscall_resolvepath(). The arena is too small
+     * for them at first, the heap is only used until it has grown.
+     */
+    arena_init(&arena, 32);
+    for (unsigned int i = 0; i < 1000; i++) {
+        if (1 == i)
+            before = arena.blocks;
+        cwd = arena_strdup(&arena, "/var/tmp/paludis/build/sys-apps-sydbox-0/work");
+        arg = arena_strdup(&arena, "..//src/./syd-arena.c");
+        path = arena_alloc(&arena, sydbox_normalize_path_size(cwd, arg));
+        sydbox_normalize_path(path, cwd, arg, 1);
+        g_assert_cmpstr(path, ==, "/var/tmp/paludis/build/sys-apps-sydbox-0/work/../src/syd-arena.c");
+        arena_reset(&arena);
+
+        dir = arena_strdup(&arena, "/usr/lib/python2.6/site-packages");
+        arg = arena_strndup(&arena, "sydbox/__init__.py", 6);
+        path = arena_alloc(&arena, sydbox_normalize_path_size(dir, arg));
+        sydbox_normalize_path(path, dir, arg, 1);
+        g_assert_cmpstr(path, ==, "/usr/lib/python2.6/site-packages/sydbox");
+        arena_reset(&arena);
+    }
+    g_assert_cmpint(before, >, 1);
+    g_assert_cmpint(arena.blocks, ==, before);
+    arena_free(&arena);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/arena/alloc", test1);
+    g_test_add_func("/arena/grow", test2);
+    g_test_add_func("/arena/allocations", test3);
+
+    return g_test_run();
+}
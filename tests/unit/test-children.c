@@ -18,7 +18,10 @@
  * Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <sched.h>
+#include <stdbool.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <glib.h>
 
 #include "syd-children.h"
@@ -27,7 +30,7 @@
 
 static void test1(void)
 {
-    GHashTable *children = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, tchild_free_one);
+    struct childtab *children = childtab_new();
     struct tchild *child;
 
     tchild_new(children, 666, true);
@@ -40,12 +43,18 @@ static void test1(void)
     g_assert_cmpint(child->sno, ==, 0xbadca11);
     g_assert_cmpint(child->retval, ==, -1);
 
-    g_hash_table_destroy(children);
+    /* Allocated on first use */
+    g_assert(NULL == child->group->lastexec);
+    g_assert(NULL == child->files->bindzero);
+    g_assert(NULL != tchild_bindzero(child));
+    g_assert(child->files->bindzero == tchild_bindzero(child));
+
+    childtab_free(children);
 }
 
 static void test2(void)
 {
-    GHashTable *children = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, tchild_free_one);
+    struct childtab *children = childtab_new();
 
     tchild_new(children, 666, true);
     tchild_new(children, 667, false);
@@ -55,12 +64,12 @@ static void test2(void)
 
     g_assert(NULL == tchild_find(children, 666));
 
-    g_hash_table_destroy(children);
+    childtab_free(children);
 }
 
 static void test3(void)
 {
-    GHashTable *children = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, tchild_free_one);
+    struct childtab *children = childtab_new();
     struct tchild *child, *parent;
 
     tchild_new(children, 666, true);
@@ -73,31 +82,254 @@ static void test3(void)
     g_assert(child);
 
     /* Fill the information of the parent */
-    parent->cwd = g_strdup("/var/empty");
-    parent->lastexec = g_string_assign(parent->lastexec, "./jonathan_livingston");
+    parent->fs->cwd = g_strdup("/var/empty");
+    g_string_assign(tchild_lastexec(parent), "./jonathan_livingston");
     parent->bitness = PINK_BITNESS_64;
-    parent->sandbox->path = false;
-    parent->sandbox->exec = true;
-    parent->sandbox->network = true;
-    parent->sandbox->lock = LOCK_SET;
-    pathnode_new(&(parent->sandbox->write_prefixes), "/dev", false);
-    pathnode_new(&(parent->sandbox->exec_prefixes), "/tmp", false);
+    parent->group->sandbox->path = false;
+    parent->group->sandbox->exec = true;
+    parent->group->sandbox->network = true;
+    parent->group->sandbox->lock = LOCK_SET;
+    pathnode_new(&(parent->group->sandbox->write_prefixes), "/dev", false);
+    pathnode_new(&(parent->group->sandbox->exec_prefixes), "/tmp", false);
 
     /* Inherit information to the child */
-    tchild_inherit(child, parent);
+    tchild_inherit(child, parent, 0);
 
     g_assert(!(child->flags & TCHILD_NEEDINHERIT));
-    g_assert_cmpstr(child->cwd, ==, "/var/empty");
-    g_assert_cmpstr(child->lastexec->str, ==, "./jonathan_livingston");
+    g_assert_cmpstr(child->fs->cwd, ==, "/var/empty");
+    g_assert_cmpstr(child->group->lastexec->str, ==, "./jonathan_livingston");
     g_assert_cmpint(child->bitness, ==, PINK_BITNESS_64);
-    g_assert(!child->sandbox->path);
-    g_assert(child->sandbox->exec);
-    g_assert(child->sandbox->network);
-    g_assert_cmpint(child->sandbox->lock, ==, LOCK_SET);
-    g_assert_cmpstr(child->sandbox->write_prefixes->data, ==, "/dev");
-    g_assert_cmpstr(child->sandbox->exec_prefixes->data, ==, "/tmp");
-
-    g_hash_table_destroy(children);
+    g_assert(!child->group->sandbox->path);
+    g_assert(child->group->sandbox->exec);
+    g_assert(child->group->sandbox->network);
+    g_assert_cmpint(child->group->sandbox->lock, ==, LOCK_SET);
+    g_assert_cmpstr(child->group->sandbox->write_prefixes.paths->data, ==, "/dev");
+    g_assert_cmpstr(child->group->sandbox->exec_prefixes.paths->data, ==, "/tmp");
+
+    childtab_free(children);
+}
+
+static void test4(void)
+{
+    struct childtab *children = childtab_new();
+    struct tchild *child, *parent;
+    struct tdata *sandbox;
+
+    parent = tchild_new(children, 666, true);
+    child = tchild_new(children, 667, false);
+    pathnode_new(&(parent->group->sandbox->write_prefixes), "/dev", false);
+
+    tchild_inherit(child, parent, 0);
+    g_assert(child->group->sandbox == parent->group->sandbox);
+    g_assert_cmpint(parent->group->sandbox->refcount, ==, 2);
+
+    /* The child changes its sandbox data */
+    tchild_unshare(child);
+    g_assert(child->group->sandbox != parent->group->sandbox);
+    g_assert_cmpint(parent->group->sandbox->refcount, ==, 1);
+    g_assert_cmpint(child->group->sandbox->refcount, ==, 1);
+    child->group->sandbox->path = false;
+    pathnode_new(&(child->group->sandbox->write_prefixes), "/tmp", false);
+
+    g_assert(parent->group->sandbox->path);
+    g_assert(pathlist_check(&(child->group->sandbox->write_prefixes), "/dev/null"));
+    g_assert(pathlist_check(&(child->group->sandbox->write_prefixes), "/tmp/foo"));
+    g_assert(!pathlist_check(&(parent->group->sandbox->write_prefixes), "/tmp/foo"));
+
+    /* Nothing to copy when the data isn't shared */
+    sandbox = parent->group->sandbox;
+    tchild_unshare(parent);
+    g_assert(parent->group->sandbox == sandbox);
+
+    childtab_free(children);
+}
+
+static void test5(void)
+{
+    struct childtab *children = childtab_new();
+    struct tchild *child;
+    gchar *cwd;
+
+    child = tchild_new(children, getpid(), true);
+    child->fs->cwd = g_strdup("/var/empty");
+    g_assert_cmpstr(tchild_getcwd(child), ==, "/var/empty");
+
+    /* Looked up from /proc after a chdir() */
+    g_free(child->fs->cwd);
+    child->fs->cwd = NULL;
+    cwd = g_get_current_dir();
+    g_assert_cmpstr(tchild_getcwd(child), ==, cwd);
+    g_assert_cmpstr(child->fs->cwd, ==, cwd);
+    g_free(cwd);
+
+    childtab_free(children);
+}
+
+static void test6(void)
+{
+    struct childtab *children = childtab_new();
+    struct tchild *child, *parent;
+
+    parent = tchild_new(children, 666, true);
+    child = tchild_new(children, 667, false);
+    parent->group->sandbox->path = false;
+    parent->group->sandbox->exec = false;
+    parent->group->sandbox->network = false;
+    parent->group->sandbox->lock = LOCK_UNSET;
+    g_assert(!tchild_quiescent(parent));
+
+    /* Quiescent once magic commands can't turn sandboxing back on */
+    parent->group->sandbox->lock = LOCK_SET;
+    g_assert(tchild_quiescent(parent));
+    g_assert(!tchild_quiescent(child));
+    tchild_inherit(child, parent, 0);
+    g_assert(tchild_quiescent(child));
+
+    parent->group->sandbox->exec = true;
+    g_assert(!tchild_quiescent(child));
+
+    childtab_free(children);
+}
+
+static bool pid_2mod4(struct tchild *child, G_GNUC_UNUSED void *userdata)
+{
+    return 2 == (child->pid / 7) % 4;
+}
+
+static void test7(void)
+{
+    struct childtab *children = childtab_new();
+    struct tchild *child, *first;
+
+    /* Enough to grow the table several times and shrink it back */
+    first = tchild_new(children, 7, false);
+    for (pid_t pid = 2; pid <= 5000; pid++)
+        tchild_new(children, pid * 7, false);
+    g_assert_cmpuint(childtab_size(children), ==, 5000);
+
+    /* Records don't move as the table grows */
+    g_assert(first == tchild_find(children, 7));
+
+    for (pid_t pid = 1; pid <= 5000; pid += 2)
+        tchild_delete(children, pid * 7);
+    g_assert_cmpuint(childtab_size(children), ==, 2500);
+    for (pid_t pid = 1; pid <= 5000; pid++) {
+        child = tchild_find(children, pid * 7);
+        if (pid & 1)
+            g_assert(NULL == child);
+        else {
+            g_assert(NULL != child);
+            g_assert_cmpint(child->pid, ==, pid * 7);
+        }
+    }
+
+    g_assert_cmpuint(childtab_foreach_remove(children, pid_2mod4, NULL), ==, 1250);
+    g_assert_cmpuint(childtab_size(children), ==, 1250);
+    for (pid_t pid = 2; pid <= 5000; pid += 2)
+        g_assert((NULL == tchild_find(children, pid * 7)) == (pid % 4 != 0));
+
+    for (pid_t pid = 4; pid <= 5000; pid += 4)
+        tchild_delete(children, pid * 7);
+    g_assert_cmpuint(childtab_size(children), ==, 0);
+    g_assert(NULL == tchild_find(children, 28));
+
+    childtab_free(children);
+}
+
+static void test8(void)
+{
+    struct childtab *children = childtab_new();
+    struct tchild *child, *thread, *parent;
+
+    parent = tchild_new(children, 666, true);
+    thread = tchild_new(children, 667, false);
+    child = tchild_new(children, 668, false);
+    parent->fs->cwd = g_strdup("/var/empty");
+    g_string_assign(tchild_lastexec(parent), "./jonathan_livingston");
+
+    /* Threads share the state of the thread group */
+    tchild_inherit(thread, parent, CLONE_THREAD | CLONE_FS | CLONE_FILES);
+    tchild_inherit(child, parent, 0);
+    g_assert(thread->group == parent->group);
+    g_assert(child->group != parent->group);
+    g_assert_cmpint(parent->group->refcount, ==, 2);
+    g_assert_cmpint(parent->group->sandbox->refcount, ==, 2);
+
+    /* A chdir() of the thread changes the directory of the process */
+    g_free(thread->fs->cwd);
+    thread->fs->cwd = g_strdup("/tmp");
+    g_assert_cmpstr(parent->fs->cwd, ==, "/tmp");
+    g_assert_cmpstr(child->fs->cwd, ==, "/var/empty");
+
+    /* So does a magic command */
+    tchild_unshare(thread);
+    thread->group->sandbox->path = false;
+    g_assert(!parent->group->sandbox->path);
+    g_assert(child->group->sandbox->path);
+
+    /* The group outlives its leader */
+    tchild_delete(children, 666);
+    g_assert_cmpint(thread->group->refcount, ==, 1);
+    g_assert_cmpstr(thread->fs->cwd, ==, "/tmp");
+    g_assert_cmpstr(thread->group->lastexec->str, ==, "./jonathan_livingston");
+
+    childtab_free(children);
+}
+
+static void test9(void)
+{
+    struct childtab *children = childtab_new();
+    struct tchild *child, *parent;
+    gchar *cwd;
+
+    parent = tchild_new(children, 666, true);
+    child = tchild_new(children, getpid(), false);
+    parent->fs->cwd = g_strdup("/var/empty");
+    g_string_assign(tchild_lastexec(parent), "./jonathan_livingston");
+
+    /* An untraced child looks up her own directory */
+    child->flags |= TCHILD_UNTRACED;
+    tchild_inherit(child, parent, 0);
+    g_assert(NULL == child->fs->cwd);
+    g_assert(NULL == child->group->lastexec);
+    g_assert(child->group->sandbox == parent->group->sandbox);
+
+    /* Every time */
+    cwd = g_get_current_dir();
+    child->fs->cwd = g_strdup("/var/empty");
+    g_assert_cmpstr(tchild_getcwd(child), ==, cwd);
+    g_free(cwd);
+
+    childtab_free(children);
+}
+
+static void test10(void)
+{
+    struct childtab *children = childtab_new();
+    struct tchild *thread, *parent;
+
+    parent = tchild_new(children, 666, true);
+    thread = tchild_new(children, 667, false);
+    parent->fs->cwd = g_strdup("/var/empty");
+    g_hash_table_insert(tchild_bindzero(parent), GINT_TO_POINTER(3), tbind_new(0, NULL));
+
+    /* Without CLONE_FS the thread has a directory of her own */
+    tchild_inherit(thread, parent, CLONE_THREAD | CLONE_FILES);
+    g_assert(thread->group == parent->group);
+    g_assert(thread->fs != parent->fs);
+    g_assert_cmpstr(thread->fs->cwd, ==, "/var/empty");
+    g_assert(thread->files == parent->files);
+
+    /* unshare(CLONE_FILES) gives her a copy of the table */
+    tchild_split(thread, CLONE_FILES);
+    g_assert(thread->files != parent->files);
+    g_assert_cmpint(thread->files->refcount, ==, 1);
+    g_assert_cmpint(parent->files->refcount, ==, 1);
+    g_assert(NULL != g_hash_table_lookup(thread->files->bindzero, GINT_TO_POINTER(3)));
+    g_hash_table_remove(parent->files->bindzero, GINT_TO_POINTER(3));
+    g_assert(NULL != g_hash_table_lookup(thread->files->bindzero, GINT_TO_POINTER(3)));
+
+    childtab_free(children);
 }
 
 static void no_log(const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer user_data)
@@ -116,6 +348,13 @@ int main(int argc, char **argv)
     g_test_add_func("/children/new", test1);
     g_test_add_func("/children/delete", test2);
     g_test_add_func("/children/inherit", test3);
+    g_test_add_func("/children/unshare", test4);
+    g_test_add_func("/children/getcwd", test5);
+    g_test_add_func("/children/quiescent", test6);
+    g_test_add_func("/children/table", test7);
+    g_test_add_func("/children/thread", test8);
+    g_test_add_func("/children/untraced", test9);
+    g_test_add_func("/children/clone", test10);
 
     return g_test_run();
 }
@@ -0,0 +1,196 @@
+/* vim: set et ts=4 sts=4 sw=4 fdm=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <fnmatch.h>
+#include <stdbool.h>
+#include <string.h>
+#include <glib.h>
+
+#include "syd-glob.h"
+
+#include "test-helpers.h"
+
+static const gchar *patterns[] = {
+    "/home/*/foo",
+    "/tmp/**",
+    "/a?c/[a-c]*",
+    "/x/[!a]y",
+    "/e\\*t",
+    "/br[",
+    "/[]]z",
+    "/cl[[:digit:]]x",
+    "/dev/tty*",
+    "/r/*.so",
+    "/s[a-]t",
+    NULL,
+};
+
+static const gchar *paths[] = {
+    "/home/sydbox/foo", "/home/a/b/foo", "/tmp/x", "/tmp/x/y", "/abc/bz", "/a/c/b",
+    "/x/by", "/x/ay", "/x//y", "/e*t", "/ext", "/br[", "/]z", "/cl5x", "/clax",
+    "/dev/tty1", "/dev/tty", "/r/lib.so", "/r/a/lib.so", "/s-t", "/sat", "/sbt",
+    "", "/", NULL,
+};
+
+/* Checks the set against fnmatch(), enabled[i] tells whether patterns[i] is
+ * in the set.
+ */
+static void check_fnmatch(struct globset *set, const bool *enabled)
+{
+    const gchar *expected, *got;
+
+    for (unsigned int j = 0; NULL != paths[j]; j++) {
+        expected = NULL;
+        for (unsigned int i = 0; NULL != patterns[i]; i++) {
+            if (enabled[i] && 0 == fnmatch(patterns[i], paths[j], FNM_PATHNAME)) {
+                expected = patterns[i];
+                break;
+            }
+        }
+        got = globset_match(set, paths[j]);
+        XFAIL_UNLESS(expected == got || (NULL != expected && NULL != got && 0 == strcmp(expected, got)),
+                "path `%s' expected `%s' got `%s'\n", paths[j], expected, got);
+    }
+}
+
+static void test1(void)
+{
+    struct globset *set;
+
+    set = globset_new();
+    g_assert(NULL == globset_match(set, "/dev/null"));
+    globset_add(set, "/dev/null");
+    g_assert_cmpstr(globset_match(set, "/dev/null"), ==, "/dev/null");
+    g_assert(NULL == globset_match(set, "/dev/zero"));
+    globset_free(set);
+}
+
+static void test2(void)
+{
+    bool enabled[G_N_ELEMENTS(patterns)];
+    struct globset *set;
+
+    set = globset_new();
+    for (unsigned int i = 0; NULL != patterns[i]; i++) {
+        globset_add(set, patterns[i]);
+        enabled[i] = true;
+    }
+    /* Twice, the second time from the cached states */
+    check_fnmatch(set, enabled);
+    check_fnmatch(set, enabled);
+    globset_free(set);
+}
+
+static void test3(void)
+{
+    bool enabled[G_N_ELEMENTS(patterns)];
+    struct globset *set;
+
+    set = globset_new();
+    for (unsigned int i = 0; NULL != patterns[i]; i++) {
+        globset_add(set, patterns[i]);
+        enabled[i] = true;
+    }
+    check_fnmatch(set, enabled);
+
+    g_assert(globset_remove(set, "/tmp/**"));
+    enabled[1] = false;
+    g_assert(globset_remove(set, "/cl[[:digit:]]x"));
+    enabled[7] = false;
+    g_assert(!globset_remove(set, "/tmp/**"));
+    check_fnmatch(set, enabled);
+
+    globset_clear(set);
+    g_assert(NULL == globset_match(set, "/dev/tty1"));
+    globset_free(set);
+}
+
+static void test4(void)
+{
+    struct globset *set;
+
+    /* The first pattern added wins like it did with the filter list */
+    set = globset_new();
+    globset_add(set, "/dev/*");
+    globset_add(set, "/dev/tty*");
+    g_assert_cmpstr(globset_match(set, "/dev/tty1"), ==, "/dev/*");
+    g_assert(globset_remove(set, "/dev/*"));
+    g_assert_cmpstr(globset_match(set, "/dev/tty1"), ==, "/dev/tty*");
+    globset_free(set);
+}
+
+static void bench1(void)
+{
+    gchar *pattern, *path;
+    GSList *list, *walk;
+    struct globset *set;
+    double linear, dfa;
+
+    list = NULL;
+    set = globset_new();
+    for (unsigned int i = 0; i < 1000; i++) {
+        pattern = g_strdup_printf("/var/tmp/sydbox-%u/*.lock", i);
+        list = g_slist_prepend(list, pattern);
+        globset_add(set, pattern);
+    }
+
+    path = g_strdup("/var/tmp/sydbox-1000/foo.lock");
+    g_test_timer_start();
+    for (unsigned int i = 0; i < 1000; i++) {
+        for (walk = list; NULL != walk; walk = g_slist_next(walk)) {
+            if (0 == fnmatch(walk->data, path, FNM_PATHNAME))
+                break;
+        }
+    }
+    linear = g_test_timer_elapsed();
+
+    g_test_timer_start();
+    for (unsigned int i = 0; i < 1000; i++)
+        globset_match(set, path);
+    dfa = g_test_timer_elapsed();
+
+    g_test_minimized_result(linear, "fnmatch loop, 1000 patterns: %.6f seconds", linear);
+    g_test_minimized_result(dfa, "glob set, 1000 patterns: %.6f seconds", dfa);
+
+    g_free(path);
+    g_slist_foreach(list, (GFunc) g_free, NULL);
+    g_slist_free(list);
+    globset_free(set);
+}
+
+static void no_log(const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer user_data)
+{
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_log_set_default_handler(no_log, NULL);
+
+    g_test_add_func("/glob/match", test1);
+    g_test_add_func("/glob/match/fnmatch", test2);
+    g_test_add_func("/glob/remove", test3);
+    g_test_add_func("/glob/match/order", test4);
+
+    if (g_test_perf())
+        g_test_add_func("/glob/match/benchmark", bench1);
+
+    return g_test_run();
+}
@@ -23,6 +23,8 @@
 
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
 #include <sys/un.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -31,6 +33,7 @@
 
 #include "syd-config.h"
 #include "syd-net.h"
+#include "syd-proc.h"
 
 #include "test-helpers.h"
 
@@ -254,6 +257,87 @@ void test12(void)
     g_free(haystack);
 }
 
+static void test15(void)
+{
+    struct sydbox_addr *addr, *dup, *other;
+
+    addr = address_from_string("unix:///run/sydbox.sock", false);
+    dup = address_dup(addr);
+    other = address_from_string("unix:///run/sydbox.sock", false);
+
+    /* Equal paths are shared */
+    g_assert(addr->u.saun.sun_path == dup->u.saun.sun_path);
+    g_assert(addr->u.saun.sun_path == other->u.saun.sun_path);
+    g_assert(address_cmp(addr, other));
+    address_free(addr);
+    g_assert_cmpstr(dup->u.saun.sun_path, ==, "/run/sydbox.sock");
+
+    address_set_rpath(dup, "/var/run/sydbox.sock");
+    g_assert_cmpstr(dup->u.saun.rsun_path, ==, "/var/run/sydbox.sock");
+    g_assert(address_cmp(dup, other));
+    address_free(dup);
+    address_free(other);
+
+    addr = address_from_string("unix:///run/other.sock", false);
+    other = address_from_string("unix-abstract:///run/other.sock", false);
+    g_assert(!address_cmp(addr, other));
+    address_free(addr);
+    address_free(other);
+}
+
+static void test14(void)
+{
+    int fd;
+    socklen_t len;
+    guint size;
+    guint64 added, dropped;
+    struct sockaddr_in sa;
+    struct sydbox_addr *addr;
+    gchar *str;
+
+    /* A socket bound to a port the kernel picked */
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    g_assert(0 <= fd);
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    g_assert(0 == bind(fd, (struct sockaddr *)&sa, sizeof(sa)));
+    len = sizeof(sa);
+    g_assert(0 == getsockname(fd, (struct sockaddr *)&sa, &len));
+    str = g_strdup_printf("inet://127.0.0.1@%d", ntohs(sa.sin_port));
+
+    addr = address_from_string(str, false);
+    g_assert(!sydbox_config_match_network_whitelist(addr, false));
+    g_assert(sydbox_config_addwhitelist_auto(getpid(), fd, proc_socket_inode(getpid(), fd), address_dup(addr)));
+    g_assert(sydbox_config_match_network_whitelist(addr, false));
+
+    /* Whitelisted once however many times it's bound */
+    g_assert(sydbox_config_addwhitelist_auto(getpid(), fd, proc_socket_inode(getpid(), fd), address_dup(addr)));
+    sydbox_config_whitelist_auto_stats(&size, &added, &dropped);
+    g_assert_cmpuint(size, ==, 1);
+    g_assert_cmpuint(added, ==, 1);
+
+    /* Open sockets are kept */
+    g_assert_cmpuint(sydbox_config_sweep_whitelist_auto(), ==, 0);
+    g_assert(sydbox_config_match_network_whitelist(addr, false));
+
+    close(fd);
+    g_assert_cmpuint(sydbox_config_sweep_whitelist_auto(), ==, 1);
+    g_assert(!sydbox_config_match_network_whitelist(addr, false));
+
+    /* Everything the process owns is dropped when it exits */
+    g_assert(sydbox_config_addwhitelist_auto(getpid(), 0, 0, address_dup(addr)));
+    sydbox_config_rmwhitelist_auto(getpid());
+    g_assert(!sydbox_config_match_network_whitelist(addr, false));
+    sydbox_config_whitelist_auto_stats(&size, &added, &dropped);
+    g_assert_cmpuint(size, ==, 0);
+    g_assert_cmpuint(added, ==, 2);
+    g_assert_cmpuint(dropped, ==, 2);
+
+    g_free(addr);
+    g_free(str);
+}
+
 static void no_log(const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer user_data)
 {
 }
@@ -290,6 +374,9 @@ int main(int argc, char **argv)
     g_test_add_func("/net/has_address/inet", test12);
     /* TODO: g_test_add_func("/net/has_address/inet6", test13); */
 
+    g_test_add_func("/net/address/unix/paths", test15);
+    g_test_add_func("/net/whitelist/auto", test14);
+
     return g_test_run();
 }
 
@@ -0,0 +1,257 @@
+/* vim: set et ts=4 sts=4 sw=4 fdm=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <glib.h>
+
+#include "syd-net.h"
+#include "syd-netset.h"
+
+#include "test-helpers.h"
+
+static const gchar *whitelist[] = {
+    "inet://127.0.0.0/8@1024-65535",
+    "inet://127.0.0.1@80",
+    "inet://192.168.0.0/16@0",
+    "inet://192.168.1.0/24@22",
+    "inet://10.0.0.1@3-5",
+    "inet://0.0.0.0/0@53",
+#if SYDBOX_HAVE_IPV6
+    "inet6://::1@80-90",
+    "inet6://2001:db8::/32@443",
+    "inet6://fe80::/10@0-65535",
+#endif /* SYDBOX_HAVE_IPV6 */
+    NULL,
+};
+
+static const gchar *addresses[] = {
+    "inet://127.0.0.1@80", "inet://127.0.0.1@81", "inet://127.1.2.3@8080", "inet://127.1.2.3@22",
+    "inet://192.168.5.5@0", "inet://192.168.5.5@22", "inet://192.168.1.7@22", "inet://192.169.0.1@0",
+    "inet://10.0.0.1@4", "inet://10.0.0.1@6", "inet://10.0.0.2@4", "inet://8.8.8.8@53",
+    "inet://8.8.8.8@54",
+#if SYDBOX_HAVE_IPV6
+    "inet6://::1@85", "inet6://::1@91", "inet6://::2@85", "inet6://2001:db8:1::1@443",
+    "inet6://2001:db9::1@443", "inet6://fe80::1@7", "inet6://fec0::1@7",
+#endif /* SYDBOX_HAVE_IPV6 */
+    NULL,
+};
+
+/* The linear walk the whitelist check used to do */
+static bool linear_match(GSList *list, struct sydbox_addr *addr)
+{
+    const int *port, *haystack_port;
+    GSList *walk;
+    struct sydbox_addr *haystack;
+
+    for (walk = list; walk != NULL; walk = g_slist_next(walk)) {
+        haystack = walk->data;
+        if (!address_has(haystack, addr))
+            continue;
+#if SYDBOX_HAVE_IPV6
+        if (AF_INET6 == addr->family) {
+            port = addr->u.sa6.port;
+            haystack_port = haystack->u.sa6.port;
+        }
+        else
+#endif /* SYDBOX_HAVE_IPV6 */
+        {
+            port = addr->u.sa.port;
+            haystack_port = haystack->u.sa.port;
+        }
+        if (port[0] >= haystack_port[0] && port[1] <= haystack_port[1])
+            return true;
+    }
+    return false;
+}
+
+/* Checks the set against the linear walk, enabled[i] tells whether
+ * whitelist[i] is in the set.
+ */
+static void check_linear(struct netset *set, const bool *enabled)
+{
+    bool expected, got;
+    GSList *list;
+    struct sydbox_addr *addr;
+
+    list = NULL;
+    for (unsigned int i = 0; NULL != whitelist[i]; i++) {
+        if (enabled[i])
+            list = g_slist_prepend(list, address_from_string(whitelist[i], false));
+    }
+
+    for (unsigned int j = 0; NULL != addresses[j]; j++) {
+        addr = address_from_string(addresses[j], false);
+        g_assert(NULL != addr);
+        expected = linear_match(list, addr);
+        got = netset_match(set, addr, true);
+        XFAIL_UNLESS(expected == got, "address `%s' expected %s got %s\n", addresses[j],
+                expected ? "match" : "no match", got ? "match" : "no match");
+        g_free(addr);
+    }
+
+    g_slist_foreach(list, (GFunc) g_free, NULL);
+    g_slist_free(list);
+}
+
+static void set_enable(struct netset *set, bool *enabled, unsigned int i, bool enable)
+{
+    struct sydbox_addr *addr;
+
+    addr = address_from_string(whitelist[i], false);
+    if (enable)
+        netset_add(set, addr);
+    else
+        g_assert(netset_remove(set, addr));
+    enabled[i] = enable;
+    g_free(addr);
+}
+
+static void test1(void)
+{
+    bool enabled[G_N_ELEMENTS(whitelist)];
+    struct netset *set;
+
+    set = netset_new();
+    for (unsigned int i = 0; NULL != whitelist[i]; i++)
+        set_enable(set, enabled, i, true);
+    check_linear(set, enabled);
+    netset_free(set);
+}
+
+static void test2(void)
+{
+    bool enabled[G_N_ELEMENTS(whitelist)];
+    struct netset *set;
+    struct sydbox_addr *addr;
+
+    set = netset_new();
+    for (unsigned int i = 0; NULL != whitelist[i]; i++)
+        set_enable(set, enabled, i, true);
+
+    set_enable(set, enabled, 0, false);
+    set_enable(set, enabled, 5, false);
+    check_linear(set, enabled);
+
+    addr = address_from_string(whitelist[0], false);
+    g_assert(!netset_remove(set, addr));
+    g_free(addr);
+
+    /* An address added twice is there until it's removed twice */
+    addr = address_from_string(whitelist[1], false);
+    netset_add(set, addr);
+    g_assert(netset_remove(set, addr));
+    check_linear(set, enabled);
+    g_free(addr);
+    set_enable(set, enabled, 1, false);
+    check_linear(set, enabled);
+
+    netset_clear(set);
+    memset(enabled, 0, sizeof(enabled));
+    check_linear(set, enabled);
+    netset_free(set);
+}
+
+static void test3(void)
+{
+    struct netset *set;
+    struct sydbox_addr *addr, *needle;
+
+    set = netset_new();
+
+    /* Ports are ignored for network filters */
+    addr = address_from_string("inet://127.0.0.1@80", false);
+    netset_add(set, addr);
+    g_free(addr);
+    needle = address_from_string("inet://127.0.0.1@443", false);
+    g_assert(!netset_match(set, needle, true));
+    g_assert(netset_match(set, needle, false));
+    g_free(needle);
+
+    netset_free(set);
+}
+
+static void test4(void)
+{
+    struct netset *set;
+    struct sydbox_addr *addr, *needle;
+
+    set = netset_new();
+
+    addr = address_from_string("unix:///tmp/.X11-unix/*", false);
+    netset_add(set, addr);
+    address_free(addr);
+    addr = address_from_string("unix-abstract:///run/sydbox.sock", false);
+    addr->u.saun.exact = true;
+    netset_add(set, addr);
+
+    needle = address_from_string("unix:///tmp/.X11-unix/X0", false);
+    g_assert(netset_match(set, needle, true));
+    address_free(needle);
+    needle = address_from_string("unix:///tmp/.X11-unix/a/X0", false);
+    g_assert(!netset_match(set, needle, true));
+    address_free(needle);
+    needle = address_from_string("unix-abstract:///tmp/.X11-unix/X0", false);
+    g_assert(!netset_match(set, needle, true));
+    address_free(needle);
+
+    /* Exact paths don't match on a common prefix */
+    needle = address_from_string("unix-abstract:///run/sydbox.sock", false);
+    g_assert(netset_match(set, needle, true));
+    address_free(needle);
+    needle = address_from_string("unix-abstract:///run/sydbox.socket", false);
+    g_assert(!netset_match(set, needle, true));
+    address_free(needle);
+    needle = address_from_string("unix:///run/sydbox.sock", false);
+    g_assert(!netset_match(set, needle, true));
+    address_free(needle);
+
+    g_assert(netset_remove(set, addr));
+    needle = address_from_string("unix-abstract:///run/sydbox.sock", false);
+    g_assert(!netset_match(set, needle, true));
+    address_free(needle);
+    address_free(addr);
+
+    netset_free(set);
+}
+
+static void no_log(const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer user_data)
+{
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_log_set_default_handler(no_log, NULL);
+
+    g_test_add_func("/netset/match", test1);
+    g_test_add_func("/netset/remove", test2);
+    g_test_add_func("/netset/match/ports", test3);
+    g_test_add_func("/netset/match/unix", test4);
+
+    return g_test_run();
+}
@@ -29,24 +29,24 @@
 
 static void test1(void)
 {
-    GSList *pathlist = NULL;
+    struct pathlist pathlist = PATHLIST_INIT;
 
     pathnode_new(&pathlist, "/dev/null", true);
-    g_assert_cmpstr(pathlist->data, ==, "/dev/null");
-    g_assert(pathlist->next == NULL);
+    g_assert_cmpstr(pathlist.paths->data, ==, "/dev/null");
+    g_assert(pathlist.paths->next == NULL);
 
     pathnode_free(&pathlist);
 }
 
 static void test2(void)
 {
-    GSList *pathlist = NULL;
+    struct pathlist pathlist = PATHLIST_INIT;
     gchar *old_home;
 
     old_home = g_strdup(g_getenv("HOME"));
     if (g_setenv("HOME", "/home/sydbox", TRUE)) {
         pathnode_new(&pathlist, "${HOME}/.sydbox", true);
-        g_assert_cmpstr(pathlist->data, ==, "/home/sydbox/.sydbox");
+        g_assert_cmpstr(pathlist.paths->data, ==, "/home/sydbox/.sydbox");
     }
     g_setenv("HOME", old_home, TRUE);
     g_free(old_home);
@@ -54,24 +54,42 @@ static void test2(void)
 
 static void test3(void)
 {
-    GSList *pathlist = NULL;
+    struct pathlist pathlist = PATHLIST_INIT;
 
     pathnode_new(&pathlist, "$(echo -n /home/sydbox)/.sydbox", true);
-    g_assert_cmpstr(pathlist->data, ==, "/home/sydbox/.sydbox");
+    g_assert_cmpstr(pathlist.paths->data, ==, "/home/sydbox/.sydbox");
+}
+
+static void test3a(void)
+{
+    struct pathlist pathlist = PATHLIST_INIT;
+    gchar *old_home;
+
+    old_home = g_strdup(g_getenv("HOME"));
+    if (g_setenv("HOME", "/home/sydbox", TRUE)) {
+        pathnode_new(&pathlist, "~/.ccache", true);
+        g_assert_cmpstr(pathlist.paths->data, ==, "/home/sydbox/.ccache");
+        pathnode_new(&pathlist, "$HOME/.sydbox", true);
+        g_assert_cmpstr(pathlist.paths->data, ==, "/home/sydbox/.sydbox");
+    }
+    g_setenv("HOME", old_home, TRUE);
+    g_free(old_home);
+    pathnode_free(&pathlist);
 }
 
 static void test4(void)
 {
-    GSList *pathlist = NULL;
+    struct pathlist pathlist = PATHLIST_INIT;
 
     pathnode_new(&pathlist, "/dev/null", true);
     pathnode_free(&pathlist);
-    g_assert(pathlist == NULL);
+    g_assert(pathlist.paths == NULL);
 }
 
 static void test5(void)
 {
-    GSList *pathlist = NULL, *entry;
+    struct pathlist pathlist = PATHLIST_INIT;
+    GSList *entry;
     const gchar env[] = "foo:bar:baz";
     gboolean seen_foo = FALSE, seen_bar = FALSE, seen_baz = FALSE;
     gint retval;
@@ -79,7 +97,7 @@ static void test5(void)
     retval = pathlist_init(&pathlist, env);
     g_assert_cmpint(retval, ==, 3);
 
-    for (entry = pathlist; entry != NULL; entry = g_slist_next(entry))
+    for (entry = pathlist.paths; entry != NULL; entry = g_slist_next(entry))
         if (strcmp(entry->data, "foo") == 0)
             seen_foo = TRUE;
         else if (strcmp(entry->data, "bar") == 0)
@@ -103,7 +121,7 @@ static void test6(void)
 
 static void test7(void)
 {
-    GSList *pathlist = NULL;
+    struct pathlist pathlist = PATHLIST_INIT;
     const gchar env[] = "foo::bar::baz::::::";
     gint retval;
 
@@ -114,17 +132,18 @@ static void test7(void)
 
 static void test8(void)
 {
-    GSList *pathlist = NULL;
+    struct pathlist pathlist = PATHLIST_INIT;
 
     pathnode_new(&pathlist, "/dev/null", true);
     pathnode_delete(&pathlist, "/dev/null");
 
-    g_assert(pathlist == NULL);
+    g_assert(pathlist.paths == NULL);
 }
 
 static void test9(void)
 {
-    GSList *pathlist = NULL, *entry;
+    struct pathlist pathlist = PATHLIST_INIT;
+    GSList *entry;
 
     pathnode_new(&pathlist, "/dev/null", true);
     pathnode_new(&pathlist, "/dev/zero", true);
@@ -132,7 +151,7 @@ static void test9(void)
 
     pathnode_delete(&pathlist, "/dev/null");
 
-    for (entry = pathlist; entry != NULL; entry = g_slist_next(entry))
+    for (entry = pathlist.paths; entry != NULL; entry = g_slist_next(entry))
         g_assert_cmpstr(entry->data, !=, "/dev/null");
 
     pathnode_free(&pathlist);
@@ -140,31 +159,204 @@ static void test9(void)
 
 static void test10(void)
 {
-    GSList *pathlist = NULL;
+    struct pathlist pathlist = PATHLIST_INIT;
     const gchar env[] = "/dev";
 
     pathlist_init(&pathlist, env);
-    g_assert_cmpint(pathlist_check(pathlist, "/dev/zero"), !=, 0);
-    g_assert_cmpint(pathlist_check(pathlist, "/dev/input/mice"), !=, 0);
-    g_assert_cmpint(pathlist_check(pathlist, "/dev/mapper/control"), !=, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev/zero"), !=, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev/input/mice"), !=, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev/mapper/control"), !=, 0);
 
-    g_assert_cmpint(pathlist_check(pathlist, "/"), ==, 0);
-    g_assert_cmpint(pathlist_check(pathlist, "/d"), ==, 0);
-    g_assert_cmpint(pathlist_check(pathlist, "/de"), ==, 0);
-    g_assert_cmpint(pathlist_check(pathlist, "/foo"), ==, 0);
-    g_assert_cmpint(pathlist_check(pathlist, "/devzero"), ==, 0);
-    g_assert_cmpint(pathlist_check(pathlist, "/foo/dev"), ==, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/"), ==, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/d"), ==, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/de"), ==, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/foo"), ==, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/devzero"), ==, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/foo/dev"), ==, 0);
+
+    pathnode_free(&pathlist);
+}
+
+static void test10a(void)
+{
+    struct pathlist pathlist = PATHLIST_INIT;
+    const gchar env[] = "/tmp/://var//tmp//";
+
+    pathlist_init(&pathlist, env);
+    g_assert_cmpint(pathlist_check(&pathlist, "/tmp"), !=, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/tmp/foo"), !=, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/var/tmp/foo"), !=, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/var/foo"), ==, 0);
+
+    pathnode_delete(&pathlist, "/tmp/");
+    g_assert_cmpint(pathlist_check(&pathlist, "/tmp/foo"), ==, 0);
+    pathnode_delete(&pathlist, "//var//tmp//");
+    g_assert_cmpint(pathlist_check(&pathlist, "/var/tmp/foo"), ==, 0);
+    g_assert(pathlist.paths == NULL);
 
     pathnode_free(&pathlist);
 }
 
 static void test11(void)
 {
-    GSList *pathlist = NULL;
+    struct pathlist pathlist = PATHLIST_INIT;
     const gchar env[] = "/";
 
     pathlist_init(&pathlist, env);
-    g_assert_cmpint(pathlist_check(pathlist, "/dev"), !=, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev"), !=, 0);
+    pathnode_free(&pathlist);
+}
+
+static void test12(void)
+{
+    struct pathlist pathlist = PATHLIST_INIT;
+
+    pathnode_new(&pathlist, "/dev", false);
+    pathnode_new(&pathlist, "/dev/shm/sydbox", false);
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev/shm/sydbox/foo"), !=, 0);
+
+    pathnode_delete(&pathlist, "/dev");
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev/null"), ==, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev/shm"), ==, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev/shm/sydbox"), !=, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev/shm/sydbox/foo"), !=, 0);
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev/shm/sydboxfoo"), ==, 0);
+
+    pathnode_delete(&pathlist, "/dev/shm/sydbox");
+    g_assert_cmpint(pathlist_check(&pathlist, "/dev/shm/sydbox"), ==, 0);
+    g_assert(pathlist.paths == NULL);
+
+    pathnode_free(&pathlist);
+}
+
+static void test13(void)
+{
+    struct pathlist pathlist = PATHLIST_INIT;
+
+    pathnode_new(&pathlist, "/tmp", false);
+    pathnode_new(&pathlist, "/tmp", false);
+    pathnode_new(&pathlist, "/", false);
+
+    pathnode_delete(&pathlist, "/");
+    g_assert_cmpint(pathlist_check(&pathlist, "/var/tmp"), ==, 0);
+    pathnode_delete(&pathlist, "/tmp");
+    g_assert_cmpint(pathlist_check(&pathlist, "/tmp/foo"), !=, 0);
+    pathnode_delete(&pathlist, "/tmp");
+    g_assert_cmpint(pathlist_check(&pathlist, "/tmp/foo"), ==, 0);
+
+    pathnode_free(&pathlist);
+}
+
+/* The list walk pathlist_check() did before the prefixes were kept in a trie */
+static bool pathlist_check_linear(GSList *pathlist, const char *path)
+{
+    size_t len;
+    GSList *walk;
+
+    for (walk = pathlist; walk != NULL; walk = g_slist_next(walk)) {
+        if (0 == strncmp(walk->data, "/", 2))
+            return true;
+        len = strlen(walk->data);
+        if (0 == strncmp(path, walk->data, len) && ('\0' == path[len] || '/' == path[len]))
+            return true;
+    }
+    return false;
+}
+
+static void bench_check(guint nprefixes)
+{
+    guint i, nlookups;
+    bool ret;
+    char *path;
+    double linear, trie;
+    GPtrArray *paths;
+    struct pathlist pathlist = PATHLIST_INIT;
+
+    for (i = 0; i < nprefixes; i++) {
+        path = g_strdup_printf("/var/tmp/paludis/build/cat-%u/pkg-%u/work", i % 97, i);
+        pathnode_new(&pathlist, path, false);
+        g_free(path);
+    }
+
+    nlookups = 1000;
+    paths = g_ptr_array_new();
+    for (i = 0; i < nlookups; i++) {
+        if (i % 2)
+            path = g_strdup_printf("/var/tmp/paludis/build/cat-%u/pkg-%u/work/src/main.c", i % 97, i);
+        else
+            path = g_strdup_printf("/usr/lib/pkg-%u/lib.so", i);
+        g_ptr_array_add(paths, path);
+    }
+
+    for (i = 0; i < nlookups; i++) {
+        ret = pathlist_check(&pathlist, g_ptr_array_index(paths, i));
+        g_assert(ret == pathlist_check_linear(pathlist.paths, g_ptr_array_index(paths, i)));
+    }
+
+    g_test_timer_start();
+    for (i = 0; i < nlookups; i++)
+        pathlist_check_linear(pathlist.paths, g_ptr_array_index(paths, i));
+    linear = g_test_timer_elapsed();
+
+    g_test_timer_start();
+    for (i = 0; i < nlookups; i++)
+        pathlist_check(&pathlist, g_ptr_array_index(paths, i));
+    trie = g_test_timer_elapsed();
+
+    g_test_minimized_result(linear, "list walk, %u prefixes, %u lookups: %.6f seconds", nprefixes, nlookups, linear);
+    g_test_minimized_result(trie, "trie, %u prefixes, %u lookups: %.6f seconds", nprefixes, nlookups, trie);
+
+    for (i = 0; i < nlookups; i++)
+        g_free(g_ptr_array_index(paths, i));
+    g_ptr_array_free(paths, TRUE);
+    pathnode_free(&pathlist);
+}
+
+static void bench1(void)
+{
+    bench_check(10);
+    bench_check(1000);
+    bench_check(100000);
+}
+
+/* Messages below the verbosity used to be formatted before the log handler
+ * dropped them. Raising the verbosity while the no_log handler drops
+ * everything measures that cost.
+ */
+static void bench2(void)
+{
+    guint i, nlookups;
+    gint verbosity;
+    char *path;
+    double skipped, formatted;
+    struct pathlist pathlist = PATHLIST_INIT;
+
+    for (i = 0; i < 100; i++) {
+        path = g_strdup_printf("/var/tmp/paludis/build/cat-%u/pkg-%u/work", i % 97, i);
+        pathnode_new(&pathlist, path, false);
+        g_free(path);
+    }
+
+    nlookups = 100000;
+    verbosity = sydbox_config_get_verbosity();
+
+    sydbox_config_set_verbosity(1);
+    g_test_timer_start();
+    for (i = 0; i < nlookups; i++)
+        pathlist_check(&pathlist, "/var/tmp/paludis/build/cat-3/pkg-3/work/src/main.c");
+    skipped = g_test_timer_elapsed();
+
+    sydbox_config_set_verbosity(3);
+    g_test_timer_start();
+    for (i = 0; i < nlookups; i++)
+        pathlist_check(&pathlist, "/var/tmp/paludis/build/cat-3/pkg-3/work/src/main.c");
+    formatted = g_test_timer_elapsed();
+
+    sydbox_config_set_verbosity(verbosity);
+
+    g_test_minimized_result(formatted, "debug messages formatted and dropped, %u lookups: %.6f seconds", nlookups, formatted);
+    g_test_minimized_result(skipped, "debug messages skipped, %u lookups: %.6f seconds", nlookups, skipped);
+
     pathnode_free(&pathlist);
 }
 
@@ -181,6 +373,7 @@ int main(int argc, char **argv)
     g_test_add_func("/path/path-node/new", test1);
     g_test_add_func("/path/path-node/new/expand-env", test2);
     g_test_add_func("/path/path-node/new/expand-subshell", test3);
+    g_test_add_func("/path/path-node/new/expand-tilde", test3a);
     g_test_add_func("/path/path-node/free", test4);
 
     g_test_add_func("/path/path-list/init", test5);
@@ -191,7 +384,15 @@ int main(int argc, char **argv)
     g_test_add_func("/path/path-list/delete", test9);
 
     g_test_add_func("/path/path-list/check/path", test10);
+    g_test_add_func("/path/path-list/check/trailing-slash", test10a);
     g_test_add_func("/path/path-list/check/root", test11);
+    g_test_add_func("/path/path-list/check/nested", test12);
+    g_test_add_func("/path/path-list/check/duplicate", test13);
+
+    if (g_test_perf()) {
+        g_test_add_func("/path/path-list/check/benchmark", bench1);
+        g_test_add_func("/path/path-list/check/benchmark-logging", bench2);
+    }
 
     return g_test_run();
 }
@@ -17,6 +17,7 @@
  * Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <string.h>
 #include <glib.h>
 
 #include "syd-utils.h"
@@ -69,6 +70,47 @@ test6 (void)
     g_free (path);
 }
 
+static void
+check_normalize (const gchar *dir, const gchar *path, pid_t pid, const gchar *expected)
+{
+    gchar *buf = g_malloc (sydbox_normalize_path_size (dir, path));
+
+    g_assert_cmpuint (sydbox_normalize_path (buf, dir, path, pid), ==, strlen (expected));
+    g_assert_cmpstr (buf, ==, expected);
+    g_free (buf);
+}
+
+static void
+test7 (void)
+{
+    check_normalize ("/home//user/", "//src/", 0, "/src");
+    check_normalize ("/home//user/", "src/", 0, "/home/user/src");
+    check_normalize ("/", "foo", 0, "/foo");
+    check_normalize ("/home", "", 0, "/home");
+    check_normalize (NULL, "////", 0, "/");
+    check_normalize (NULL, "/dev////null//", 0, "/dev/null");
+}
+
+static void
+test8 (void)
+{
+    check_normalize ("/usr/./lib", "./gcc/.", 0, "/usr/lib/gcc");
+    check_normalize ("/usr", "./../lib/", 0, "/usr/../lib");
+    check_normalize (NULL, "/.git/.config", 0, "/.git/.config");
+    check_normalize (NULL, "/./.", 0, "/");
+}
+
+static void
+test9 (void)
+{
+    check_normalize (NULL, "/proc/self/fd/3", 4242, "/proc/4242/fd/3");
+    check_normalize (NULL, "/proc//./self", 4242, "/proc/4242");
+    check_normalize ("/proc", "self/cwd", 4242, "/proc/4242/cwd");
+    check_normalize (NULL, "/proc/self/fd/3", 0, "/proc/self/fd/3");
+    check_normalize (NULL, "/proc/selfish", 4242, "/proc/selfish");
+    check_normalize (NULL, "/tmp/proc/self", 4242, "/tmp/proc/self");
+}
+
 int
 main (int argc, char **argv)
 {
@@ -82,6 +124,10 @@ main (int argc, char **argv)
     g_test_add_func ("/utils/compress-path/only-slashes", test5);
     g_test_add_func ("/utils/compress-path/empty-string", test6);
 
+    g_test_add_func ("/utils/normalize-path/absolute", test7);
+    g_test_add_func ("/utils/normalize-path/dot", test8);
+    g_test_add_func ("/utils/normalize-path/proc-self", test9);
+
     return g_test_run ();
 }
 
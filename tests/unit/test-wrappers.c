@@ -0,0 +1,260 @@
+/* vim: set et ts=4 sts=4 sw=4 fdm=syntax : */
+
+/*
+ * Copyright (c) 2010 Ali Polatel <alip@exherbo.org>
+ *
+ * This file is part of the sydbox sandbox tool. sydbox is free software;
+ * you can redistribute it and/or modify it under the terms of the GNU General
+ * Public License version 2, as published by the Free Software Foundation.
+ *
+ * sydbox is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59 Temple
+ * Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "syd-config.h"
+#include "syd-wrappers.h"
+
+#include "test-helpers.h"
+
+static gchar *tmpdir;
+
+static gchar *tmp_path(const gchar *name)
+{
+    return g_build_filename(tmpdir, name, NULL);
+}
+
+static void setup(void)
+{
+    gchar *path;
+
+    tmpdir = g_strdup("/tmp/sydbox-test-wrappers-XXXXXX");
+    g_assert(NULL != mkdtemp(tmpdir));
+
+    path = tmp_path("real/sub");
+    g_assert(0 == g_mkdir_with_parents(path, 0700));
+    g_free(path);
+    path = tmp_path("other/sub");
+    g_assert(0 == g_mkdir_with_parents(path, 0700));
+    g_free(path);
+    path = tmp_path("link");
+    g_assert(0 == symlink("real", path));
+    g_free(path);
+}
+
+static void teardown(void)
+{
+    gchar *path;
+
+    path = tmp_path("link");
+    g_unlink(path);
+    g_free(path);
+    path = tmp_path("real/sub");
+    g_rmdir(path);
+    g_free(path);
+    path = tmp_path("real");
+    g_rmdir(path);
+    g_free(path);
+    path = tmp_path("other/sub");
+    g_rmdir(path);
+    g_free(path);
+    path = tmp_path("other");
+    g_rmdir(path);
+    g_free(path);
+    g_rmdir(tmpdir);
+    g_free(tmpdir);
+    canonicalize_cache_flush();
+}
+
+static void test1(void)
+{
+    gchar *path, *expected, *resolved;
+    guint64 hits, misses, hits_before;
+
+    setup();
+
+    path = tmp_path("link/sub/file");
+    expected = tmp_path("real/sub/file");
+    resolved = canonicalize_filename_mode(path, CAN_ALL_BUT_LAST, true);
+    g_assert_cmpstr(resolved, ==, expected);
+    g_free(resolved);
+
+    /* The second lookup of the directory is served from the cache */
+    canonicalize_cache_stats(&hits_before, &misses);
+    resolved = canonicalize_filename_mode(path, CAN_ALL_BUT_LAST, true);
+    g_assert_cmpstr(resolved, ==, expected);
+    g_free(resolved);
+    canonicalize_cache_stats(&hits, &misses);
+    g_assert(hits > hits_before);
+
+    g_free(expected);
+    g_free(path);
+    teardown();
+}
+
+static void test2(void)
+{
+    gchar *path, *link, *expected, *resolved;
+
+    setup();
+
+    path = tmp_path("link/sub/file");
+    resolved = canonicalize_filename_mode(path, CAN_ALL_BUT_LAST, true);
+    g_free(resolved);
+
+    /* Pointing the symlink elsewhere without telling the cache */
+    link = tmp_path("link");
+    g_assert(0 == g_unlink(link));
+    g_assert(0 == symlink("other", link));
+    g_free(link);
+
+    expected = tmp_path("other/sub/file");
+    resolved = canonicalize_filename_mode(path, CAN_ALL_BUT_LAST, true);
+    g_assert_cmpstr(resolved, ==, expected);
+    g_free(resolved);
+
+    g_free(expected);
+    g_free(path);
+    teardown();
+}
+
+static void test3(void)
+{
+    gchar *path, *resolved;
+
+    setup();
+
+    path = tmp_path("link/sub/file");
+    resolved = canonicalize_filename_mode(path, CAN_EXISTING, true);
+    g_assert(NULL == resolved);
+    g_assert_cmpint(errno, ==, ENOENT);
+    g_free(path);
+
+    path = tmp_path("link/nonexistent/file");
+    resolved = canonicalize_filename_mode(path, CAN_ALL_BUT_LAST, true);
+    g_assert(NULL == resolved);
+    g_assert_cmpint(errno, ==, ENOENT);
+    g_free(path);
+
+    teardown();
+}
+
+static void test4(void)
+{
+    int fd, rootfd;
+    char name[201];
+    gchar *path, *dir;
+    GString *expected;
+
+    setup();
+
+    /* A directory whose path is longer than PATH_MAX */
+    memset(name, 'd', 200);
+    name[200] = '\0';
+    expected = g_string_new(tmpdir);
+    g_assert(0 <= (fd = open(tmpdir, O_PATH | O_DIRECTORY)));
+    for (unsigned int i = 0; i < 30; i++) {
+        g_assert(0 == mkdirat(fd, name, 0700));
+        g_string_append_printf(expected, "/%s", name);
+        g_assert(0 <= (rootfd = openat(fd, name, O_PATH | O_DIRECTORY)));
+        close(fd);
+        fd = rootfd;
+    }
+    g_assert(expected->len > PATH_MAX);
+
+    g_assert(0 <= (rootfd = open("/", O_PATH | O_DIRECTORY)));
+    dir = edirpath(fd, rootfd);
+    g_assert_cmpstr(dir, ==, expected->str);
+    g_free(dir);
+    close(rootfd);
+    close(fd);
+
+    path = canonicalize_filename_mode(expected->str, CAN_EXISTING, true);
+    g_assert_cmpstr(path, ==, expected->str);
+    g_free(path);
+
+    g_string_free(expected, TRUE);
+
+    path = g_strdup_printf("rm -rf '%s/%s'", tmpdir, name);
+    g_assert(0 == system(path));
+    g_free(path);
+
+    teardown();
+}
+
+static void test5(void)
+{
+    gchar *path, *expected, *resolved;
+
+    setup();
+
+    /* Names without symlinks are only normalized */
+    path = g_strdup_printf("%s//real/./sub/../sub/", tmpdir);
+    expected = tmp_path("real/sub");
+    resolved = canonicalize_filename_mode(path, CAN_EXISTING, true);
+    g_assert_cmpstr(resolved, ==, expected);
+    g_free(resolved);
+    g_free(expected);
+    g_free(path);
+
+    path = tmp_path("real/sub/../new");
+    expected = tmp_path("real/new");
+    resolved = canonicalize_filename_mode(path, CAN_ALL_BUT_LAST, true);
+    g_assert_cmpstr(resolved, ==, expected);
+    g_free(resolved);
+    g_free(expected);
+    g_free(path);
+
+    path = tmp_path("real/new");
+    resolved = canonicalize_filename_mode(path, CAN_EXISTING, true);
+    g_assert(NULL == resolved);
+    g_assert_cmpint(errno, ==, ENOENT);
+    g_free(path);
+
+    /* A symlink at the end is kept unless it's resolved */
+    path = tmp_path("real/../link");
+    expected = tmp_path("link");
+    resolved = canonicalize_filename_mode(path, CAN_EXISTING, false);
+    g_assert_cmpstr(resolved, ==, expected);
+    g_free(resolved);
+    g_free(expected);
+    expected = tmp_path("real");
+    resolved = canonicalize_filename_mode(path, CAN_EXISTING, true);
+    g_assert_cmpstr(resolved, ==, expected);
+    g_free(resolved);
+    g_free(expected);
+    g_free(path);
+
+    teardown();
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    sydbox_config_load(NULL, NULL);
+
+    g_test_add_func("/wrappers/canonicalize/cache", test1);
+    g_test_add_func("/wrappers/canonicalize/cache/validate", test2);
+    g_test_add_func("/wrappers/canonicalize/cache/errors", test3);
+    g_test_add_func("/wrappers/dirpath/long", test4);
+    g_test_add_func("/wrappers/canonicalize/normalize", test5);
+
+    return g_test_run();
+}